@@ -0,0 +1,107 @@
+#include "Backpressure.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+namespace Common {
+
+CreditWindow::CreditWindow(std::string_view name, std::size_t windowBytes, SocketRole role)
+    : m_name(name),
+    m_role(role),
+    m_windowBytes(windowBytes) {
+    // Whoever comes first creates zeroed object, so window is fully open until ComponentB grants anything
+    const int fileDescriptor = ::shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0666);
+    checkErrors(fileDescriptor, -1);
+    const int resultTruncate = ::ftruncate(fileDescriptor, sizeof(Counters));
+    if(resultTruncate == -1) {
+        ::close(fileDescriptor);
+    }
+    checkErrors(resultTruncate, -1);
+    void* mapping = ::mmap(nullptr, sizeof(Counters), PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    checkErrors(mapping, MAP_FAILED);
+    m_counters = static_cast<Counters*>(mapping);
+
+    m_countBytesSent = std::atomic_ref<std::uint64_t>(m_counters->countBytesSent).load(std::memory_order_acquire);
+    if(m_role == SocketRole::Listen) {
+        // Whatever was in flight before our start is gone
+        m_countBytesGranted = m_countBytesSent;
+        std::atomic_ref<std::uint64_t>(m_counters->countBytesGranted).store(m_countBytesGranted, std::memory_order_release);
+    } else {
+        m_countBytesGranted = std::atomic_ref<std::uint64_t>(m_counters->countBytesGranted).load(std::memory_order_acquire);
+        resyncSent();
+    }
+}
+
+CreditWindow::~CreditWindow() {
+    if(m_counters != nullptr) {
+        ::munmap(m_counters, sizeof(Counters));
+    }
+}
+
+CreditWindow::CreditWindow(CreditWindow&& other) noexcept {
+    *this = std::move(other);
+}
+
+CreditWindow& CreditWindow::operator=(CreditWindow&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_name, other.m_name);
+        std::swap(m_role, other.m_role);
+        std::swap(m_counters, other.m_counters);
+        std::swap(m_windowBytes, other.m_windowBytes);
+        std::swap(m_countBytesSent, other.m_countBytesSent);
+        std::swap(m_countBytesGranted, other.m_countBytesGranted);
+    }
+    return *this;
+}
+
+void CreditWindow::resyncSent() {
+    // ComponentB grants every byte it processed, also bytes which ComponentA sent without taking credits
+    // (it ran without credit policy), so sent catches up and those grants don't open window beyond its size
+    if(m_countBytesGranted > m_countBytesSent) {
+        m_countBytesSent = m_countBytesGranted;
+        std::atomic_ref<std::uint64_t>(m_counters->countBytesSent).store(m_countBytesSent, std::memory_order_relaxed);
+    }
+}
+
+bool CreditWindow::fits(std::size_t countBytes) const {
+    NET_ASSERT(m_countBytesGranted <= m_countBytesSent);
+    return m_countBytesSent - m_countBytesGranted + countBytes <= m_windowBytes;
+}
+
+bool CreditWindow::tryConsume(std::size_t countBytes) {
+    NET_ASSERT(countBytes <= m_windowBytes);
+    if(!fits(countBytes)) {
+        // Cached value of granted bytes is reloaded only when window looks closed
+        m_countBytesGranted = std::atomic_ref<std::uint64_t>(m_counters->countBytesGranted).load(std::memory_order_acquire);
+        resyncSent();
+        if(!fits(countBytes)) {
+            return false;
+        }
+    }
+    m_countBytesSent += countBytes;
+    std::atomic_ref<std::uint64_t>(m_counters->countBytesSent).store(m_countBytesSent, std::memory_order_relaxed);
+    return true;
+}
+
+void CreditWindow::grant(std::size_t countBytes) {
+    m_countBytesGranted += countBytes;
+    std::atomic_ref<std::uint64_t>(m_counters->countBytesGranted).store(m_countBytesGranted, std::memory_order_release);
+}
+
+CreditPolicy creditPolicyFromString(std::string_view name) {
+    if(name == "drop-newest") {
+        return CreditPolicy::DropNewest;
+    }
+    if(name == "drop-oldest") {
+        return CreditPolicy::DropOldest;
+    }
+    if(name == "conflate") {
+        return CreditPolicy::Conflate;
+    }
+    throw std::invalid_argument("Unknown credit policy: " + std::string(name));
+}
+
+} // namespace Common
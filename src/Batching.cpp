@@ -0,0 +1,117 @@
+#include "Batching.h"
+
+#include <algorithm>
+
+namespace Common {
+
+BatchController::BatchController(std::size_t minBatchSize, std::size_t maxBatchSize)
+    : m_minBatchSize(minBatchSize),
+    m_maxBatchSize(maxBatchSize),
+    m_batchSize(minBatchSize) {
+    NET_ASSERT(minBatchSize > 0 && minBatchSize <= maxBatchSize);
+}
+
+std::size_t BatchController::next(std::size_t queueDepth) {
+    std::size_t batchSize = m_batchSize.load(std::memory_order_relaxed);
+    if(queueDepth > batchSize) {
+        batchSize = std::min(batchSize * 2, m_maxBatchSize);
+    } else if(queueDepth < batchSize / 2) {
+        batchSize = std::max(batchSize / 2, m_minBatchSize);
+    }
+    m_batchSize.store(batchSize, std::memory_order_relaxed);
+    return batchSize;
+}
+
+BatchedUdpReader::BatchedUdpReader(std::uint16_t port, std::size_t maxBatchSize)
+    : m_readerUdp(port),
+    m_messages(maxBatchSize),
+    m_ioVectors(maxBatchSize) {
+    m_burstBuffers.reserve(maxBatchSize);
+    m_spareBuffers.reserve(maxBatchSize);
+}
+
+Buffer* BatchedUdpReader::tryAcquire(ThreadSafeQueueBuffer& threadSafeQueueBuffer, std::size_t minimumSize) {
+    const auto spare = std::find_if(m_spareBuffers.begin(), m_spareBuffers.end(), [minimumSize](const Buffer* spareBuffer) {
+        return spareBuffer->data.size() >= minimumSize;
+    });
+    if(spare != m_spareBuffers.end()) {
+        Buffer* buffer = *spare;
+        m_spareBuffers.erase(spare);
+        return buffer;
+    }
+    return threadSafeQueueBuffer.tryDequeueReadyToUse(minimumSize);
+}
+
+Buffer& BatchedUdpReader::acquire(ThreadSafeQueueBuffer& threadSafeQueueBuffer, std::size_t minimumSize) {
+    Buffer* buffer = tryAcquire(threadSafeQueueBuffer, minimumSize);
+    // Pool is exhausted, overflow policy decides
+    return buffer != nullptr ? *buffer : threadSafeQueueBuffer.dequeueReadyToUse(minimumSize);
+}
+
+std::size_t BatchedUdpReader::readSingle(ThreadSafeQueueBuffer& threadSafeQueueBuffer) {
+    // Size of datagram picks size class, so it is never truncated
+    const std::int64_t peekedSize = m_readerUdp.peekSize();
+    NET_CHECK(peekedSize, std::int64_t{-1});
+    const std::size_t datagramSize = std::clamp<std::int64_t>(peekedSize, 0, threadSafeQueueBuffer.maxBufferSize());
+    Buffer& entries = acquire(threadSafeQueueBuffer, datagramSize);
+    entries.countBytes = static_cast<std::size_t>(std::max<std::int64_t>(m_readerUdp.read(entries.data), 0));
+    NET_ASSERT(entries.countBytes <= entries.data.size());
+    threadSafeQueueBuffer.enqueueInProcess(&entries);
+    return 1;
+}
+
+std::size_t BatchedUdpReader::read(ThreadSafeQueueBuffer& threadSafeQueueBuffer, std::size_t batchSize) {
+    NET_ASSERT(batchSize > 0 && batchSize <= m_messages.size());
+    if(batchSize == 1) {
+        return readSingle(threadSafeQueueBuffer);
+    }
+
+    // Sizes of datagrams after the first one are unknown, so every buffer of burst fits the biggest datagram.
+    // Only buffers which are free right now are taken, waiting for more would delay datagrams which are already here
+    const std::size_t burstBufferSize = threadSafeQueueBuffer.maxBufferSize();
+    m_burstBuffers.clear();
+    while(m_burstBuffers.size() < batchSize) {
+        Buffer* buffer = tryAcquire(threadSafeQueueBuffer, burstBufferSize);
+        if(buffer == nullptr) {
+            break;
+        }
+        m_burstBuffers.push_back(buffer);
+    }
+    if(m_burstBuffers.empty()) {
+        // Waiting for the biggest class (or dropping under overflow policy) while smaller buffers are free would lose datagrams
+        return readSingle(threadSafeQueueBuffer);
+    }
+
+    for(std::size_t index = 0; index < m_burstBuffers.size(); ++index) {
+        m_ioVectors[index] = iovec{m_burstBuffers[index]->data.data(), m_burstBuffers[index]->data.size()};
+        m_messages[index] = mmsghdr{};
+        m_messages[index].msg_hdr.msg_iov = &m_ioVectors[index];
+        m_messages[index].msg_hdr.msg_iovlen = 1;
+    }
+    // Waits for the first datagram, then returns right away with whatever else arrived
+    const int resultReceive = ::recvmmsg(m_readerUdp.fileDescriptor(), m_messages.data(), m_burstBuffers.size(), MSG_WAITFORONE, nullptr);
+    NET_CHECK(resultReceive, -1);
+    const std::size_t countReceived = static_cast<std::size_t>(std::max(resultReceive, 0));
+
+    // Buffers with datagrams go in process, the rest stays with reader for the next read, so consumer never gets empty buffers
+    std::size_t countRead = 0;
+    for(std::size_t index = 0; index < m_burstBuffers.size(); ++index) {
+        Buffer* entries = m_burstBuffers[index];
+        const bool isTruncated = index < countReceived && (m_messages[index].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+        if(index < countReceived && !isTruncated) {
+            entries->countBytes = m_messages[index].msg_len;
+            m_burstBuffers[countRead++] = entries;
+            continue;
+        }
+        if(isTruncated) {
+            // Only datagrams bigger than the biggest size class, pool is configured for smaller datagrams than socket delivers
+            m_countTruncated.store(m_countTruncated.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+        entries->countBytes = 0;
+        m_spareBuffers.push_back(entries);
+    }
+    threadSafeQueueBuffer.enqueueInProcess(std::span<Buffer* const>(m_burstBuffers).first(countRead));
+    return countRead;
+}
+
+} // namespace Common
@@ -0,0 +1,1445 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <csignal>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Settings.h"
+#include "Common.h"
+#include "Batching.h"
+#include "EntriesProcessing.h"
+#include "FilterWorkers.h"
+#include "FlushWindow.h"
+#include "Pipeline.h"
+#include "RecordLayout.h"
+#include "PacketMmapReader.h"
+#include "Transport.h"
+#include "XdpReader.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::uint16_t BENCHMARK_PORT = 47001;
+constexpr std::uint16_t TCP_SINK_PORT = 47002;
+constexpr std::size_t ENTRIES_PER_DATAGRAM = 64;
+
+struct IngestResult {
+    std::uint64_t countDatagrams = 0;
+    std::uint64_t countPrices = 0;
+};
+
+// Builds datagram "price volume ... price volume EOF" where no price equals EOF marker
+std::vector<std::uint8_t> makeEntriesDatagram(std::size_t countEntries, std::mt19937& generator) {
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<std::uint8_t> datagram;
+    datagram.reserve(countEntries * 2 + 1);
+    for(std::size_t i = 0; i < countEntries; ++i) {
+        std::uint8_t price = static_cast<std::uint8_t>(distribution(generator));
+        if(price == Settings::EOF_MARKER) {
+            ++price;
+        }
+        datagram.push_back(price);
+        datagram.push_back(static_cast<std::uint8_t>(distribution(generator)));
+    }
+    datagram.push_back(Settings::EOF_MARKER);
+    return datagram;
+}
+
+/* Load generator: sends entries to localhost:port as fast as possible until receiver reports it is done,
+ * so a receiver blocked in read always gets woken up
+ * */
+std::uint64_t loadGenerator(std::uint16_t port, const std::vector<std::uint8_t>& datagram, const std::atomic_bool& receiverDone) {
+    const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+    Common::checkErrors(socketDescriptor, -1);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = ::htons(port);
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+
+    std::uint64_t countSent = 0;
+    while(!receiverDone.load(std::memory_order_relaxed)) {
+        const ssize_t result = ::sendto(socketDescriptor, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        if(result > 0) {
+            ++countSent;
+        }
+    }
+    ::close(socketDescriptor);
+    return countSent;
+}
+
+std::uint64_t loadGenerator(std::uint16_t port, std::size_t countEntries, const std::atomic_bool& receiverDone) {
+    std::mt19937 generator(42);
+    return loadGenerator(port, makeEntriesDatagram(countEntries, generator), receiverDone);
+}
+
+// Ingest backends share one interface, receive delivers zero or more datagram payloads to onPayload
+class SocketIngest {
+    Common::NetworkReaderWriter<Common::ProtocolType::UDP> m_readerUdp{BENCHMARK_PORT};
+    Common::Buffer m_entries{std::vector<std::uint8_t>(PIPE_BUF)};
+
+public:
+    template<typename Callback>
+    void receive(Callback&& onPayload) {
+        const std::int64_t readBytes = m_readerUdp.read(m_entries.data);
+        if(readBytes > 0) {
+            m_entries.countBytes = readBytes;
+            onPayload(m_entries.data.data(), m_entries.countBytes);
+        }
+    }
+};
+
+class PacketMmapIngest {
+    Common::PacketMmapReader m_readerRing{Settings::DEFAULT_INTERFACE, BENCHMARK_PORT, Settings::PACKET_MMAP_BLOCK_SIZE, Settings::PACKET_MMAP_COUNT_BLOCKS, Settings::PACKET_MMAP_BLOCK_TIMEOUT_MILLISECONDS};
+
+public:
+    template<typename Callback>
+    void receive(Callback&& onPayload) {
+        m_readerRing.readBatch(onPayload, 100);
+    }
+};
+
+class XdpIngest {
+    Common::XdpReader m_readerXdp{Settings::DEFAULT_INTERFACE, BENCHMARK_PORT, Settings::XDP_QUEUE_ID, Settings::XDP_COUNT_FRAMES, Settings::XDP_FRAME_SIZE};
+
+public:
+    template<typename Callback>
+    void receive(Callback&& onPayload) {
+        m_readerXdp.readBatch(onPayload, 100);
+    }
+};
+
+template<typename Ingest>
+void runIngestThroughput(std::string_view name, std::chrono::seconds duration) {
+    std::unique_ptr<Ingest> ingestPtr;
+    try {
+        ingestPtr = std::make_unique<Ingest>();
+    } catch (std::exception& e) {
+        std::cout << std::left << std::setw(16) << name << " is not available: " << e.what() << std::endl;
+        return;
+    }
+
+    std::atomic_bool receiverDone = false;
+    std::uint64_t countSent = 0;
+    std::thread generatorThread([&countSent, &receiverDone]() {
+        countSent = loadGenerator(BENCHMARK_PORT, ENTRIES_PER_DATAGRAM, receiverDone);
+    });
+
+    IngestResult result;
+    std::vector<std::uint8_t> prices;
+    prices.reserve(Settings::MAX_UDP_BUF);
+    const Clock::time_point deadline = Clock::now() + duration;
+    while(Clock::now() < deadline) {
+        ingestPtr->receive([&result, &prices](const std::uint8_t* entries, std::size_t countBytes) {
+            if(Processing::filterEntries(entries, countBytes, prices, Settings::EOF_MARKER)) {
+                ++result.countDatagrams;
+                result.countPrices += prices.size();
+            }
+        });
+    }
+    receiverDone = true;
+    generatorThread.join();
+
+    const double seconds = static_cast<double>(duration.count());
+    std::cout << std::left << std::setw(16) << name
+              << " datagrams/s: " << std::setw(12) << static_cast<std::uint64_t>(result.countDatagrams / seconds)
+              << " prices/s: " << std::setw(12) << static_cast<std::uint64_t>(result.countPrices / seconds)
+              << " received/sent: " << result.countDatagrams << "/" << countSent << std::endl;
+}
+
+void printLatencies(std::string_view name, std::vector<std::chrono::nanoseconds>& latencies) {
+    if(latencies.empty()) {
+        std::cout << std::left << std::setw(16) << name << " no samples" << std::endl;
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto microseconds = [&latencies](double percentile) {
+        const std::size_t index = std::min(latencies.size() - 1, static_cast<std::size_t>(percentile * latencies.size()));
+        return std::chrono::duration<double, std::micro>(latencies[index]).count();
+    };
+    std::cout << std::left << std::setw(16) << name << std::fixed << std::setprecision(1)
+              << " samples: " << std::setw(10) << latencies.size()
+              << " p50 us: " << std::setw(10) << microseconds(0.5)
+              << " p99 us: " << std::setw(10) << microseconds(0.99)
+              << " max us: " << microseconds(1.0) << std::endl;
+}
+
+/* Ping-pong: next datagram is sent only when previous one was filtered, so one-way latency
+ * from sendto to the end of filterEntries is measured without queueing
+ * */
+template<typename Ingest>
+void runIngestLatency(std::string_view name, std::chrono::seconds duration) {
+    std::unique_ptr<Ingest> ingestPtr;
+    try {
+        ingestPtr = std::make_unique<Ingest>();
+    } catch (std::exception& e) {
+        std::cout << std::left << std::setw(16) << name << " is not available: " << e.what() << std::endl;
+        return;
+    }
+
+    std::atomic<Clock::rep> sendTime = 0;
+    std::atomic_uint64_t countReceived = 0;
+    std::atomic_bool receiverDone = false;
+    std::thread senderThread([&sendTime, &countReceived, &receiverDone]() {
+        const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+        Common::checkErrors(socketDescriptor, -1);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = ::htons(BENCHMARK_PORT);
+        address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+        std::mt19937 generator(42);
+        const std::vector<std::uint8_t> datagram = makeEntriesDatagram(ENTRIES_PER_DATAGRAM, generator);
+        while(!receiverDone.load(std::memory_order_relaxed)) {
+            const std::uint64_t countBefore = countReceived.load(std::memory_order_acquire);
+            sendTime.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+            ::sendto(socketDescriptor, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            // Datagram might be lost, resend after a while
+            const Clock::time_point resendTime = Clock::now() + std::chrono::milliseconds(100);
+            while(countReceived.load(std::memory_order_acquire) == countBefore && Clock::now() < resendTime && !receiverDone.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+        ::close(socketDescriptor);
+    });
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    std::vector<std::uint8_t> prices;
+    prices.reserve(Settings::MAX_UDP_BUF);
+    const Clock::time_point deadline = Clock::now() + duration;
+    while(Clock::now() < deadline) {
+        ingestPtr->receive([&](const std::uint8_t* entries, std::size_t countBytes) {
+            Processing::filterEntries(entries, countBytes, prices, Settings::EOF_MARKER);
+            const Clock::time_point sent{Clock::duration(sendTime.load(std::memory_order_acquire))};
+            latencies.push_back(Clock::now() - sent);
+            countReceived.fetch_add(1, std::memory_order_release);
+        });
+    }
+    receiverDone = true;
+    senderThread.join();
+    printLatencies(name, latencies);
+}
+
+void benchmarkIngest(std::chrono::seconds duration) {
+    runIngestThroughput<SocketIngest>("socket read", duration);
+    runIngestThroughput<PacketMmapIngest>("packet mmap", duration);
+    runIngestThroughput<XdpIngest>("af_xdp", duration);
+}
+
+void benchmarkIngestLatency(std::chrono::seconds duration) {
+    runIngestLatency<SocketIngest>("socket read", duration);
+    runIngestLatency<PacketMmapIngest>("packet mmap", duration);
+    runIngestLatency<XdpIngest>("af_xdp", duration);
+}
+
+constexpr std::pair<std::string_view, Common::TransportType> TRANSPORTS[] = {
+    {"fifo", Common::TransportType::Fifo},
+    {"fifo splice", Common::TransportType::FifoSplice},
+    {"unix seqpacket", Common::TransportType::UnixSocket},
+    {"shared memory", Common::TransportType::SharedMemory},
+    {"loopback tcp", Common::TransportType::LoopbackTcp},
+};
+constexpr std::size_t TRANSPORT_MESSAGE_SIZE = 64;
+// Payload bytes are never zero, so single zero byte at the end of read data marks the end of run even for fifo
+constexpr std::uint8_t FINAL_MESSAGE_MARKER = 0;
+
+/* Runs writer and reader sides of A -> B transport in separate threads, as ComponentA and ComponentB do.
+ * Writer calls onWrite(transport) until onRead(buffer) returns false
+ * */
+template<typename OnWrite, typename OnRead>
+void runTransportPair(Common::TransportType transportType, OnWrite&& onWrite, OnRead&& onRead) {
+    using namespace Common;
+    std::atomic_bool readerDone = false;
+    std::thread writerThread([&]() {
+        Transport::withTransport(transportType, SocketRole::Connect, [&](auto& transport) {
+            while(!readerDone.load(std::memory_order_relaxed)) {
+                onWrite(transport);
+            }
+            transport.write(std::vector<std::uint8_t>(1, FINAL_MESSAGE_MARKER));
+        });
+    });
+
+    Transport::withTransport(transportType, SocketRole::Listen, [&](auto& transport) {
+        std::vector<Buffer> buffers(Settings::TRANSPORT_MAX_BATCH, Buffer{std::vector<std::uint8_t>(PIPE_BUF)});
+        std::vector<Buffer*> bufferPtrs;
+        for(Buffer& buffer : buffers) {
+            bufferPtrs.push_back(&buffer);
+        }
+        bool finalReceived = false;
+        while(!finalReceived) {
+            const std::size_t countRead = transport.read(std::span<Buffer*>(bufferPtrs));
+            for(std::size_t index = 0; index < countRead; ++index) {
+                const Buffer& buffer = *bufferPtrs[index];
+                if(buffer.countBytes == 0) {
+                    continue;
+                }
+                finalReceived = finalReceived || buffer.data[buffer.countBytes - 1] == FINAL_MESSAGE_MARKER;
+                if(!readerDone.load(std::memory_order_relaxed) && !onRead(buffer)) {
+                    readerDone = true;
+                }
+            }
+        }
+    });
+    writerThread.join();
+}
+
+void benchmarkTransport(std::chrono::seconds duration) {
+    using namespace Common;
+    const std::vector<std::uint8_t> message(TRANSPORT_MESSAGE_SIZE, 90);
+    const std::vector<std::vector<std::uint8_t>> batch(Settings::TRANSPORT_MAX_BATCH, message);
+
+    for(const auto& [name, transportType] : TRANSPORTS) {
+        // Fifo merges messages, so rate is counted in bytes
+        std::uint64_t countBytes = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        runTransportPair(transportType, [&batch](auto& transport) {
+            transport.write(std::span<const std::vector<std::uint8_t>>(batch));
+        }, [&countBytes, deadline](const Buffer& buffer) {
+            countBytes += buffer.countBytes;
+            return Clock::now() < deadline;
+        });
+        std::cout << std::left << std::setw(16) << name
+                  << " messages/s: " << static_cast<std::uint64_t>(countBytes / TRANSPORT_MESSAGE_SIZE / static_cast<double>(duration.count())) << std::endl;
+
+        std::atomic<Clock::rep> sendTime = 0;
+        std::atomic_uint64_t countReceived = 0;
+        std::vector<std::chrono::nanoseconds> latencies;
+        runTransportPair(transportType, [&message, &sendTime, &countReceived](auto& transport) {
+            const std::uint64_t countBefore = countReceived.load(std::memory_order_acquire);
+            sendTime.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+            transport.write(message);
+            const Clock::time_point timeout = Clock::now() + std::chrono::milliseconds(100);
+            while(countReceived.load(std::memory_order_acquire) == countBefore && Clock::now() < timeout) {
+                std::this_thread::yield();
+            }
+        }, [&sendTime, &countReceived, &latencies, deadline = Clock::now() + duration](const Buffer&) {
+            const Clock::time_point sent{Clock::duration(sendTime.load(std::memory_order_acquire))};
+            latencies.push_back(Clock::now() - sent);
+            countReceived.fetch_add(1, std::memory_order_release);
+            return Clock::now() < deadline;
+        });
+        printLatencies(name, latencies);
+    }
+}
+
+/* A -> B throughput of full PIPE_BUF datagrams: filtered prices are either written (copied into the pipe)
+ * or filtered straight into gifted slot of SplicePipe
+ * */
+void benchmarkSplice(std::chrono::seconds duration) {
+    using namespace Common;
+    std::mt19937 generator(42);
+    std::vector<std::uint8_t> entries = makeEntriesDatagram(PIPE_BUF / 2 - 1, generator);
+    std::replace(entries.begin(), entries.end(), FINAL_MESSAGE_MARKER, static_cast<std::uint8_t>(1));
+
+    const auto run = [&entries, duration](std::string_view name, TransportType transportType, bool filterIntoSlot) {
+        std::vector<std::uint8_t> prices;
+        prices.reserve(Settings::MAX_UDP_BUF);
+        std::uint64_t countBytes = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        runTransportPair(transportType, [&entries, &prices, filterIntoSlot](auto& transport) {
+            if constexpr (requires { transport.gift(0); }) {
+                if(filterIntoSlot) {
+                    std::span<std::uint8_t> slot = transport.acquire();
+                    std::size_t countPrices = 0;
+                    Processing::filterEntries(entries.data(), entries.size(), slot.data(), countPrices, Settings::EOF_MARKER);
+                    transport.gift(countPrices);
+                    return;
+                }
+            }
+            Processing::filterEntries(entries.data(), entries.size(), prices, Settings::EOF_MARKER);
+            transport.write(prices);
+        }, [&countBytes, deadline](const Buffer& buffer) {
+            countBytes += buffer.countBytes;
+            return Clock::now() < deadline;
+        });
+        std::cout << std::left << std::setw(20) << name << " prices MB/s: "
+                  << static_cast<std::uint64_t>(countBytes / static_cast<double>(duration.count()) / 1e6) << std::endl;
+    };
+
+    run("fifo write", TransportType::Fifo, false);
+    run("fifo-splice memcpy", TransportType::FifoSplice, false);
+    run("fifo-splice gift", TransportType::FifoSplice, true);
+}
+
+/* Receive and filter of one datagram without any transport: datagram is copied into Buffer (as recv would do)
+ * and prices are either copied into separate vector or compacted in place
+ * */
+void benchmarkFilter(std::chrono::seconds duration) {
+    using namespace Common;
+    std::mt19937 generator(42);
+    for(const std::size_t countEntries : {std::size_t{64}, std::size_t{PIPE_BUF / 2 - 1}, std::size_t{Settings::MAX_UDP_BUF / 2 - 1}}) {
+        const std::vector<std::uint8_t> datagram = makeEntriesDatagram(countEntries, generator);
+        const auto run = [&datagram, duration](std::string_view name, auto&& filter) {
+            Buffer entries{std::vector<std::uint8_t>(Settings::MAX_UDP_BUF)};
+            std::uint64_t countDatagrams = 0;
+            std::uint64_t countPrices = 0;
+            const Clock::time_point deadline = Clock::now() + duration;
+            while(Clock::now() < deadline) {
+                for(std::int32_t i = 0; i < 1024; ++i) {
+                    std::memcpy(entries.data.data(), datagram.data(), datagram.size());
+                    entries.countBytes = datagram.size();
+                    countPrices += filter(entries);
+                }
+                countDatagrams += 1024;
+            }
+            std::cout << std::left << std::setw(20) << name << std::setw(8) << datagram.size() << " bytes, datagrams/s: "
+                      << static_cast<std::uint64_t>(countDatagrams / static_cast<double>(duration.count()))
+                      << " (" << countPrices / countDatagrams << " prices)" << std::endl;
+        };
+
+        std::vector<std::uint8_t> prices;
+        prices.reserve(Settings::MAX_UDP_BUF);
+        run("copy", [&prices](const Buffer& entries) {
+            Processing::filterEntries(entries, prices, Settings::EOF_MARKER);
+            return prices.size();
+        });
+        run("in place", [](Buffer& entries) {
+            Processing::filterEntries(entries, Settings::EOF_MARKER);
+            return entries.countBytes;
+        });
+    }
+}
+
+/* Outbound messages of filtered prices: built per price as separate vectors (filterPrices) against copied from
+ * compile time table of all 256 messages into one contiguous stream
+ * */
+void benchmarkMessages(std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t COUNT_PRICES = 4096;
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    Buffer prices{std::vector<std::uint8_t>(COUNT_PRICES)};
+    for(std::uint8_t& price : prices.data) {
+        price = static_cast<std::uint8_t>(distribution(generator));
+    }
+    prices.countBytes = prices.data.size();
+    const auto isGoodPrice = [](std::uint8_t price) {
+        return price > Settings::THRESHOLD_PRICE;
+    };
+
+    const auto run = [duration](std::string_view name, auto&& filter) {
+        std::uint64_t countMessages = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            countMessages += filter();
+        }
+        const double messagesPerSecond = countMessages / static_cast<double>(duration.count());
+        std::cout << std::left << std::setw(12) << name << " messages/s: " << std::setw(12) << static_cast<std::uint64_t>(messagesPerSecond)
+                  << " ns per message: " << std::fixed << std::setprecision(2) << 1e9 / messagesPerSecond << std::endl;
+    };
+
+    std::vector<std::vector<std::uint8_t>> goodPrices;
+    goodPrices.reserve(COUNT_PRICES);
+    run("vectors", [&prices, &goodPrices, &isGoodPrice]() {
+        Processing::filterPrices(prices, goodPrices, Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE, isGoodPrice);
+        return goodPrices.size();
+    });
+    std::vector<std::uint8_t> messages(COUNT_PRICES * Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE);
+    run("table", [&prices, &messages, &isGoodPrice]() {
+        return Processing::filterPricesToMessages<Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE>(prices, messages.data(), isGoodPrice);
+    });
+}
+
+/* Datagram to messages: filterEntries writes prices to a buffer and filterPricesToMessages scans them again,
+ * fused kernel goes from entries straight to messages in one pass
+ * */
+void benchmarkFused(std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t MESSAGE_SIZE = Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE;
+    std::mt19937 generator(42);
+    for(const std::size_t countEntries : {std::size_t{64}, std::size_t{PIPE_BUF / 2 - 1}, std::size_t{Settings::MAX_UDP_BUF / 2 - 1}}) {
+        const std::vector<std::uint8_t> datagram = makeEntriesDatagram(countEntries, generator);
+        std::vector<std::uint8_t> messages(countEntries * MESSAGE_SIZE);
+        const auto run = [&datagram, duration](std::string_view name, auto&& toMessages) {
+            std::uint64_t countDatagrams = 0;
+            std::uint64_t countMessages = 0;
+            const Clock::time_point deadline = Clock::now() + duration;
+            while(Clock::now() < deadline) {
+                for(std::int32_t i = 0; i < 1024; ++i) {
+                    countMessages += toMessages();
+                }
+                countDatagrams += 1024;
+            }
+            const double seconds = static_cast<double>(duration.count());
+            std::cout << std::left << std::setw(12) << name << std::setw(8) << datagram.size() << " bytes, datagrams/s: " << std::setw(10)
+                      << static_cast<std::uint64_t>(countDatagrams / seconds) << " entries/s: " << std::setw(12)
+                      << static_cast<std::uint64_t>(countDatagrams * (datagram.size() / 2) / seconds)
+                      << " (" << countMessages / countDatagrams << " messages)" << std::endl;
+        };
+
+        Buffer prices{std::vector<std::uint8_t>(datagram.size())};
+        run("two pass", [&datagram, &prices, &messages]() {
+            Processing::filterEntries(datagram.data(), datagram.size(), prices.data.data(), prices.countBytes, Settings::EOF_MARKER);
+            return Processing::filterPricesToMessages<MESSAGE_SIZE>(prices, messages.data(), [](std::uint8_t price) {
+                return price > Settings::THRESHOLD_PRICE;
+            });
+        });
+        run("fused", [&datagram, &messages]() {
+            std::size_t countMessages = 0;
+            Processing::filterEntriesToMessages<MESSAGE_SIZE>(datagram.data(), datagram.size(), messages.data(), countMessages, Settings::THRESHOLD_PRICE, Settings::EOF_MARKER);
+            return countMessages;
+        });
+    }
+}
+
+/* Stages composed at compile time against functions run one after another and against hand written fused kernel.
+ * Extra stage of pipeline is fused into the same loop, with functions it would be one more pass
+ * */
+void benchmarkPipeline(std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t MESSAGE_SIZE = Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE;
+    constexpr auto entriesToMessages = Processing::pipeline(Processing::deinterleave<Settings::EOF_MARKER>,
+                                                            Processing::threshold<Settings::THRESHOLD_PRICE>,
+                                                            Processing::expand<MESSAGE_SIZE>);
+    // Prices in a few bands
+    const Processing::PriceBitmap bands([](std::uint8_t price) {
+        return (price > 90 && price < 110) || (price > 150 && price < 200) || price > 240;
+    });
+    const auto entriesToMessagesInBands = Processing::pipeline(Processing::deinterleave<Settings::EOF_MARKER>,
+                                                               Processing::threshold<Settings::THRESHOLD_PRICE>,
+                                                               Processing::selectPrices([&bands](std::uint8_t price) { return bands.contains(price); }),
+                                                               Processing::expand<MESSAGE_SIZE>);
+    std::mt19937 generator(42);
+    for(const std::size_t countEntries : {std::size_t{64}, std::size_t{PIPE_BUF / 2 - 1}, std::size_t{Settings::MAX_UDP_BUF / 2 - 1}}) {
+        const std::vector<std::uint8_t> datagram = makeEntriesDatagram(countEntries, generator);
+        std::vector<std::uint8_t> messages(countEntries * MESSAGE_SIZE);
+        const auto run = [&datagram, duration](std::string_view name, auto&& toMessages) {
+            std::uint64_t countDatagrams = 0;
+            std::uint64_t countBytes = 0;
+            const Clock::time_point deadline = Clock::now() + duration;
+            while(Clock::now() < deadline) {
+                for(std::int32_t i = 0; i < 1024; ++i) {
+                    countBytes += toMessages();
+                }
+                countDatagrams += 1024;
+            }
+            const double seconds = static_cast<double>(duration.count());
+            std::cout << std::left << std::setw(20) << name << std::setw(8) << datagram.size() << " bytes, datagrams/s: " << std::setw(10)
+                      << static_cast<std::uint64_t>(countDatagrams / seconds) << " entries/s: " << std::setw(12)
+                      << static_cast<std::uint64_t>(countDatagrams * (datagram.size() / 2) / seconds)
+                      << " (" << countBytes / countDatagrams / MESSAGE_SIZE << " messages)" << std::endl;
+        };
+
+        Buffer prices{std::vector<std::uint8_t>(datagram.size())};
+        Buffer pricesInBands{std::vector<std::uint8_t>(datagram.size())};
+        const auto isGoodPrice = [](std::uint8_t price) {
+            return price > Settings::THRESHOLD_PRICE;
+        };
+        run("two pass", [&datagram, &prices, &messages, &isGoodPrice]() {
+            Processing::filterEntries(datagram.data(), datagram.size(), prices.data.data(), prices.countBytes, Settings::EOF_MARKER);
+            return Processing::filterPricesToMessages<MESSAGE_SIZE>(prices, messages.data(), isGoodPrice) * MESSAGE_SIZE;
+        });
+        run("fused kernel", [&datagram, &messages]() {
+            std::size_t countMessages = 0;
+            Processing::filterEntriesToMessages<MESSAGE_SIZE>(datagram.data(), datagram.size(), messages.data(), countMessages, Settings::THRESHOLD_PRICE, Settings::EOF_MARKER);
+            return countMessages * MESSAGE_SIZE;
+        });
+        run("pipeline", [&datagram, &messages, &entriesToMessages]() {
+            Processing::MessageStream output{messages.data()};
+            entriesToMessages.run(datagram.data(), datagram.size(), output);
+            return output.countBytes;
+        });
+        run("three pass bands", [&datagram, &prices, &pricesInBands, &messages, &bands, &isGoodPrice]() {
+            Processing::filterEntries(datagram.data(), datagram.size(), prices.data.data(), prices.countBytes, Settings::EOF_MARKER);
+            pricesInBands.countBytes = 0;
+            for(std::size_t i = 0; i < prices.countBytes; ++i) {
+                pricesInBands.data[pricesInBands.countBytes] = prices.data[i];
+                pricesInBands.countBytes += isGoodPrice(prices.data[i]) ? 1 : 0;
+            }
+            return Processing::filterPricesToMessages<MESSAGE_SIZE>(pricesInBands, messages.data(), bands) * MESSAGE_SIZE;
+        });
+        run("pipeline bands", [&datagram, &messages, &entriesToMessagesInBands]() {
+            Processing::MessageStream output{messages.data()};
+            entriesToMessagesInBands.run(datagram.data(), datagram.size(), output);
+            return output.countBytes;
+        });
+    }
+}
+
+/* Table lookup of prices in bitmap against calling predicate for every price, for predicates of growing cost.
+ * Lookup costs the same for any predicate and is done 32 prices at a time with pshufb when CPU supports SSSE3 or AVX2
+ * */
+void benchmarkPriceBitmap(std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t COUNT_PRICES = 4096;
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    Buffer prices{std::vector<std::uint8_t>(COUNT_PRICES)};
+    for(std::uint8_t& price : prices.data) {
+        price = static_cast<std::uint8_t>(distribution(generator));
+    }
+    prices.countBytes = prices.data.size();
+    std::vector<std::uint8_t> messages(COUNT_PRICES * Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE);
+
+    const auto run = [duration, &prices](std::string_view name, auto&& filter) {
+        std::uint64_t countPrices = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            filter();
+            countPrices += prices.countBytes;
+        }
+        const double pricesPerSecond = countPrices / static_cast<double>(duration.count());
+        std::cout << std::left << std::setw(20) << name << " prices/s: " << std::setw(12) << static_cast<std::uint64_t>(pricesPerSecond)
+                  << " ns per price: " << std::fixed << std::setprecision(3) << 1e9 / pricesPerSecond << std::endl;
+    };
+
+    const auto runBoth = [&run, &prices, &messages](std::string_view name, auto&& isGoodPrice) {
+        run(std::string(name) + " predicate", [&prices, &messages, &isGoodPrice]() {
+            return Processing::filterPricesToMessages<Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE>(prices, messages.data(), isGoodPrice);
+        });
+        const Processing::PriceBitmap goodPrices(isGoodPrice);
+        run(std::string(name) + " bitmap", [&prices, &messages, &goodPrices]() {
+            return Processing::filterPricesToMessages<Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE>(prices, messages.data(), goodPrices);
+        });
+    };
+
+    runBoth("threshold", [](std::uint8_t price) {
+        return price > Settings::THRESHOLD_PRICE;
+    });
+    runBoth("bands", [](std::uint8_t price) {
+        return (price > 20 && price < 40) || (price > 90 && price < 110) || price > 240;
+    });
+    std::vector<std::uint8_t> setOfPrices(16);
+    for(std::uint8_t& price : setOfPrices) {
+        price = static_cast<std::uint8_t>(distribution(generator));
+    }
+    runBoth("set", [&setOfPrices](std::uint8_t price) {
+        return std::find(setOfPrices.begin(), setOfPrices.end(), price) != setOfPrices.end();
+    });
+}
+
+/* De-interleave and threshold kernels of record layouts on a datagram of max size. Prices of a block of 16 bytes are
+ * moved together with single pshufb (two blocks with AVX2) when CPU supports SSSE3, otherwise entries are read one by one
+ * */
+template<typename Layout>
+void runRecordLayout(std::string_view name, std::chrono::seconds duration, std::mt19937& generator) {
+    using Price = typename Layout::Price;
+    constexpr Price EOF_MARKER = Settings::EOF_MARKER;
+    // A third of prices is above threshold whatever the width is
+    constexpr Price THRESHOLD_PRICE = static_cast<Price>(std::numeric_limits<Price>::max() / 3 * 2);
+    std::uniform_int_distribution<std::uint64_t> distribution(0, std::numeric_limits<std::uint64_t>::max());
+    const std::size_t countEntries = (Settings::MAX_UDP_BUF - Layout::ENTRY_SIZE) / Layout::ENTRY_SIZE;
+    std::vector<std::uint8_t> datagram(countEntries * Layout::ENTRY_SIZE + Layout::ENTRY_SIZE);
+    for(std::uint8_t& byte : datagram) {
+        byte = static_cast<std::uint8_t>(distribution(generator));
+    }
+    for(std::size_t i = 0; i < countEntries; ++i) {
+        // Neither byte order nor field order matters for random bytes, only price must not be EOF marker
+        std::uint8_t* entry = datagram.data() + i * Layout::ENTRY_SIZE;
+        while(Layout::priceOf(entry) == EOF_MARKER) {
+            ++entry[Layout::PRICE_OFFSET];
+        }
+    }
+    std::memset(datagram.data() + countEntries * Layout::ENTRY_SIZE, 0, Layout::ENTRY_SIZE);
+    datagram[countEntries * Layout::ENTRY_SIZE + Layout::PRICE_OFFSET + (Layout::ENDIANNESS == Processing::ByteOrder::Little ? 0 : Layout::PRICE_SIZE - 1)] = EOF_MARKER;
+
+    std::vector<Price> prices(countEntries + 1);
+    const auto run = [&datagram, countEntries, duration, name](std::string_view kernel, auto&& filter) {
+        std::uint64_t countDatagrams = 0;
+        std::uint64_t countPrices = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            for(std::int32_t i = 0; i < 64; ++i) {
+                countPrices += filter();
+            }
+            countDatagrams += 64;
+        }
+        const double entriesPerSecond = countDatagrams * countEntries / static_cast<double>(duration.count());
+        std::cout << std::left << std::setw(26) << name << std::setw(8) << kernel << " entries/s: " << std::setw(12) << static_cast<std::uint64_t>(entriesPerSecond)
+                  << " GB/s: " << std::fixed << std::setprecision(2) << entriesPerSecond * Layout::ENTRY_SIZE / 1e9
+                  << " (" << countPrices / countDatagrams << " prices)" << std::endl;
+    };
+    run("all", [&datagram, &prices]() {
+        std::size_t countPrices = 0;
+        Processing::filterEntries<Layout>(datagram.data(), datagram.size(), prices.data(), countPrices, EOF_MARKER);
+        return countPrices;
+    });
+    run("above", [&datagram, &prices]() {
+        std::size_t countPrices = 0;
+        Processing::filterEntriesAbove<Layout>(datagram.data(), datagram.size(), prices.data(), countPrices, THRESHOLD_PRICE, EOF_MARKER);
+        return countPrices;
+    });
+}
+
+void benchmarkRecordLayouts(std::chrono::seconds duration) {
+    using namespace Processing;
+    std::mt19937 generator(42);
+    runRecordLayout<DefaultLayout>("u8 u8", duration, generator);
+    runRecordLayout<RecordLayout<std::uint16_t, std::uint16_t>>("u16 u16", duration, generator);
+    runRecordLayout<RecordLayout<std::uint16_t, std::uint16_t, FieldOrder::PriceFirst, ByteOrder::Big>>("u16 u16 big endian", duration, generator);
+    runRecordLayout<RecordLayout<std::uint32_t, std::uint32_t>>("u32 u32", duration, generator);
+    runRecordLayout<RecordLayout<std::uint32_t, std::uint32_t, FieldOrder::VolumeFirst, ByteOrder::Big>>("volume u32 price u32 big", duration, generator);
+    runRecordLayout<RecordLayout<std::uint16_t, std::uint32_t>>("u16 u32", duration, generator);
+}
+
+/* Threshold of every entry looked up by its instrument in flat table against single global threshold.
+ * Table of 100000 instruments doesn't fit into L1 or L2, so cost of lookup grows with count of instruments
+ * */
+void benchmarkInstruments(std::chrono::seconds duration) {
+    using Layout = Processing::RecordLayout<std::uint16_t, std::uint16_t, Processing::FieldOrder::PriceFirst, Processing::ByteOrder::Little, std::uint32_t>;
+    using Price = Layout::Price;
+    constexpr Price EOF_MARKER = Settings::EOF_MARKER;
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<std::uint32_t> distribution(0, std::numeric_limits<std::uint32_t>::max());
+    const std::size_t countEntries = (Settings::MAX_UDP_BUF - Layout::ENTRY_SIZE) / Layout::ENTRY_SIZE;
+    std::vector<Price> prices(countEntries + 1);
+    std::vector<Layout::Instrument> instruments(countEntries + 1);
+
+    const auto run = [countEntries, duration](std::string_view name, std::size_t countInstruments, auto&& filter) {
+        std::uint64_t countDatagrams = 0;
+        std::uint64_t countPrices = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            for(std::int32_t i = 0; i < 64; ++i) {
+                countPrices += filter();
+            }
+            countDatagrams += 64;
+        }
+        const double entriesPerSecond = countDatagrams * countEntries / static_cast<double>(duration.count());
+        std::cout << std::left << std::setw(8) << name << std::setw(8) << countInstruments << " instruments, entries/s: " << std::setw(12)
+                  << static_cast<std::uint64_t>(entriesPerSecond) << " ns per entry: " << std::fixed << std::setprecision(3) << 1e9 / entriesPerSecond
+                  << " (" << countPrices / countDatagrams << " prices)" << std::endl;
+    };
+
+    for(const std::size_t countInstruments : {std::size_t{10}, std::size_t{1'000}, std::size_t{100'000}}) {
+        std::vector<std::uint8_t> datagram;
+        datagram.reserve(Settings::MAX_UDP_BUF);
+        const auto appendEntry = [&datagram](std::uint32_t instrument, Price price, Price volume) {
+            datagram.insert(datagram.end(), reinterpret_cast<const std::uint8_t*>(&instrument), reinterpret_cast<const std::uint8_t*>(&instrument) + sizeof(instrument));
+            datagram.insert(datagram.end(), reinterpret_cast<const std::uint8_t*>(&price), reinterpret_cast<const std::uint8_t*>(&price) + sizeof(price));
+            datagram.insert(datagram.end(), reinterpret_cast<const std::uint8_t*>(&volume), reinterpret_cast<const std::uint8_t*>(&volume) + sizeof(volume));
+        };
+        for(std::size_t i = 0; i < countEntries; ++i) {
+            const Price price = static_cast<Price>(distribution(generator));
+            appendEntry(distribution(generator) % countInstruments, price == EOF_MARKER ? 0 : price, static_cast<Price>(distribution(generator)));
+        }
+        appendEntry(0, EOF_MARKER, 0);
+
+        // About a third of prices passes whatever the instrument is
+        Processing::InstrumentThresholds thresholds(countInstruments, 0);
+        for(std::size_t instrument = 0; instrument < countInstruments; ++instrument) {
+            thresholds.set(instrument, std::numeric_limits<Price>::max() / 2 + distribution(generator) % (std::numeric_limits<Price>::max() / 3));
+        }
+
+        run("global", countInstruments, [&datagram, &prices]() {
+            std::size_t countPrices = 0;
+            Processing::filterEntriesAbove<Layout>(datagram.data(), datagram.size(), prices.data(), countPrices, std::numeric_limits<Price>::max() / 3 * 2, EOF_MARKER);
+            return countPrices;
+        });
+        run("table", countInstruments, [&datagram, &prices, &instruments, &thresholds]() {
+            std::size_t countPrices = 0;
+            Processing::filterEntriesAbove<Layout>(datagram.data(), datagram.size(), prices.data(), instruments.data(), countPrices, thresholds, EOF_MARKER);
+            return countPrices;
+        });
+    }
+}
+
+/* Socket ingest of 8 entry records: one record per datagram pays per packet cost for every record,
+ * packing several records into one datagram shares it between them
+ * */
+void benchmarkRecords(std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t ENTRIES_PER_RECORD = 8;
+    std::mt19937 generator(42);
+    const std::vector<std::uint8_t> record = makeEntriesDatagram(ENTRIES_PER_RECORD, generator);
+
+    for(const std::size_t countRecords : {std::size_t{1}, std::size_t{16}, PIPE_BUF / record.size()}) {
+        std::vector<std::uint8_t> datagram;
+        for(std::size_t i = 0; i < countRecords; ++i) {
+            datagram.insert(datagram.end(), record.begin(), record.end());
+        }
+
+        SocketIngest ingest;
+        std::atomic_bool receiverDone = false;
+        std::thread generatorThread([&datagram, &receiverDone]() {
+            loadGenerator(BENCHMARK_PORT, datagram, receiverDone);
+        });
+
+        std::vector<std::uint8_t> prices(PIPE_BUF);
+        std::vector<std::size_t> recordEnds;
+        std::uint64_t countDatagrams = 0;
+        std::uint64_t countRecordsFiltered = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            ingest.receive([&](const std::uint8_t* entries, std::size_t countBytes) {
+                std::size_t countPrices = 0;
+                countRecordsFiltered += Processing::filterRecords(entries, countBytes, prices.data(), countPrices, recordEnds, Settings::EOF_MARKER);
+                ++countDatagrams;
+            });
+        }
+        receiverDone = true;
+        generatorThread.join();
+
+        const double seconds = static_cast<double>(duration.count());
+        std::cout << std::left << std::setw(4) << countRecords << " records per datagram"
+                  << " datagrams/s: " << std::setw(12) << static_cast<std::uint64_t>(countDatagrams / seconds)
+                  << " records/s: " << static_cast<std::uint64_t>(countRecordsFiltered / seconds) << std::endl;
+    }
+}
+
+/* Filtering of fat datagrams (many records up to the biggest datagram) on 1 to 8 workers against filtering on the
+ * dispatching thread. Dispatcher copies datagram into buffer (as recv would do), submits it and takes filtered ones in order,
+ * so it stays the only serial part besides the copy
+ * */
+void benchmarkFilterWorkers(std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t ENTRIES_PER_RECORD = 8;
+    constexpr std::size_t COUNT_BUFFERS = 64;
+    std::mt19937 generator(42);
+    const std::vector<std::uint8_t> record = makeEntriesDatagram(ENTRIES_PER_RECORD, generator);
+    std::vector<std::uint8_t> datagram;
+    while(datagram.size() + record.size() <= static_cast<std::size_t>(Settings::MAX_UDP_BUF)) {
+        datagram.insert(datagram.end(), record.begin(), record.end());
+    }
+    std::vector<Buffer> buffers(COUNT_BUFFERS, Buffer{std::vector<std::uint8_t>(Settings::MAX_UDP_BUF)});
+
+    const auto print = [&datagram, duration](std::string_view name, std::uint64_t countDatagrams, std::uint64_t countBytes) {
+        const double seconds = static_cast<double>(duration.count());
+        std::cout << std::left << std::setw(12) << name << datagram.size() << " bytes, datagrams/s: " << std::setw(10)
+                  << static_cast<std::uint64_t>(countDatagrams / seconds) << " MB/s: "
+                  << static_cast<std::uint64_t>(countBytes / seconds / 1e6) << std::endl;
+    };
+
+    {
+        std::vector<std::size_t> recordEnds;
+        std::uint64_t countDatagrams = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            Buffer& entries = buffers[countDatagrams % COUNT_BUFFERS];
+            std::memcpy(entries.data.data(), datagram.data(), datagram.size());
+            entries.countBytes = datagram.size();
+            Processing::filterRecords(entries, recordEnds, Settings::EOF_MARKER);
+            ++countDatagrams;
+        }
+        print("inline", countDatagrams, countDatagrams * datagram.size());
+    }
+
+    for(std::size_t countWorkers = 1; countWorkers <= 8; ++countWorkers) {
+        Processing::FilterWorkers filterWorkers(countWorkers, COUNT_BUFFERS, Settings::EOF_MARKER);
+        std::uint64_t countSubmitted = 0;
+        std::uint64_t countTaken = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        while(Clock::now() < deadline) {
+            if(countSubmitted - countTaken < COUNT_BUFFERS) {
+                Buffer& entries = buffers[countSubmitted % COUNT_BUFFERS];
+                std::memcpy(entries.data.data(), datagram.data(), datagram.size());
+                entries.countBytes = datagram.size();
+                filterWorkers.submit(&entries);
+                ++countSubmitted;
+            }
+            while(Buffer* entries = filterWorkers.tryTake()) {
+                if(entries->sequenceNumber != countTaken) {
+                    throw std::runtime_error("Filter workers reordered datagrams");
+                }
+                ++countTaken;
+            }
+            if(countSubmitted - countTaken == COUNT_BUFFERS) {
+                std::this_thread::yield();
+            }
+        }
+        // Buffers must not be reused by the next round while workers still filter them
+        while(countTaken < countSubmitted) {
+            if(filterWorkers.tryTake() != nullptr) {
+                ++countTaken;
+            }
+        }
+        std::string name = std::to_string(countWorkers);
+        name.append(" workers");
+        print(name, countTaken, countTaken * datagram.size());
+    }
+}
+
+/* Round trip of empty buffers through ThreadSafeQueueBuffer between two threads: producer takes ready to use buffers
+ * and puts them in process, consumer takes them one by one (polling count in between) or in bursts and returns them.
+ * Pool of single buffer makes it ping-pong, so time per buffer is latency of two handoffs
+ * */
+template<typename Queue>
+void runQueue(std::string_view name, std::chrono::seconds duration) {
+    using namespace Common;
+    using QueueBuffer = BasicThreadSafeQueueBuffer<Queue>;
+    const auto run = [duration, name](std::string_view mode, std::size_t countBuffers, auto&& consume) {
+        QueueBuffer threadSafeQueueBuffer(64, countBuffers);
+        std::atomic_bool stop = false;
+        std::thread producerThread([&threadSafeQueueBuffer, &stop]() {
+            while(!stop.load(std::memory_order_relaxed)) {
+                if(threadSafeQueueBuffer.countToUse() > 0) {
+                    threadSafeQueueBuffer.enqueueInProcess(&threadSafeQueueBuffer.dequeueReadyToUse());
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        std::uint64_t countBuffersTaken = 0;
+        const Clock::time_point start = Clock::now();
+        const Clock::time_point deadline = start + duration;
+        while(Clock::now() < deadline) {
+            countBuffersTaken += consume(threadSafeQueueBuffer);
+        }
+        const std::chrono::nanoseconds elapsed = Clock::now() - start;
+        stop = true;
+        producerThread.join();
+        std::cout << std::left << std::setw(16) << name << std::setw(10) << mode << " buffers/s: " << std::setw(10)
+                  << static_cast<std::uint64_t>(countBuffersTaken / static_cast<double>(duration.count()))
+                  << " ns per buffer: " << elapsed.count() / std::max<std::uint64_t>(countBuffersTaken, 1) << std::endl;
+    };
+
+    const auto consumeSingle = [](QueueBuffer& threadSafeQueueBuffer) {
+        std::size_t countTaken = 0;
+        do {
+            threadSafeQueueBuffer.enqueueUsed(&threadSafeQueueBuffer.dequeueInProcess());
+            ++countTaken;
+        } while(countTaken < Settings::TRANSPORT_MAX_BATCH && threadSafeQueueBuffer.countInProcess() > 0);
+        return countTaken;
+    };
+    std::vector<Buffer*> burst(Settings::TRANSPORT_MAX_BATCH);
+    const auto consumeBulk = [&burst](QueueBuffer& threadSafeQueueBuffer) {
+        const std::size_t countTaken = threadSafeQueueBuffer.dequeueInProcess(burst);
+        threadSafeQueueBuffer.enqueueUsed(std::span<Buffer* const>(burst).first(countTaken));
+        return countTaken;
+    };
+
+    run("ping-pong", 1, consumeSingle);
+    run("single", Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS, consumeSingle);
+    run("bulk", Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS, consumeBulk);
+}
+
+void benchmarkQueue(std::chrono::seconds duration) {
+    runQueue<Common::MoodycamelQueueT>("moodycamel", duration);
+    runQueue<Common::CircularBufferQueueT>("circular buffer", duration);
+    runQueue<Common::RingQueueT>("spsc ring", duration);
+}
+
+/* Contention of buffer pool shared by several ingest and processing threads: half of threads take ready to use buffers
+ * and put them in process, the other half takes them and returns them. Two threads on SPSC pool are the baseline
+ * */
+template<typename QueueBuffer>
+void runPool(std::string_view name, std::size_t countThreads, std::chrono::seconds duration) {
+    using namespace Common;
+    QueueBuffer threadSafeQueueBuffer(64, Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS);
+    std::atomic_bool stopProducers = false;
+    std::atomic_bool stopConsumers = false;
+    std::atomic_uint64_t countBuffersTotal = 0;
+
+    std::vector<std::thread> producerThreads;
+    std::vector<std::thread> consumerThreads;
+    for(std::size_t i = 0; i < countThreads / 2; ++i) {
+        producerThreads.emplace_back([&threadSafeQueueBuffer, &stopProducers]() {
+            while(!stopProducers.load(std::memory_order_relaxed)) {
+                threadSafeQueueBuffer.enqueueInProcess(&threadSafeQueueBuffer.dequeueReadyToUse());
+            }
+        });
+        consumerThreads.emplace_back([&threadSafeQueueBuffer, &stopConsumers, &countBuffersTotal]() {
+            std::uint64_t countBuffers = 0;
+            while(true) {
+                if(Buffer* buffer = threadSafeQueueBuffer.tryDequeueInProcess()) {
+                    threadSafeQueueBuffer.enqueueUsed(buffer);
+                    ++countBuffers;
+                } else if(stopConsumers.load(std::memory_order_relaxed)) {
+                    break;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+            countBuffersTotal += countBuffers;
+        });
+    }
+
+    std::this_thread::sleep_for(duration);
+    // Producers might wait for buffers, so consumers keep returning them until producers are gone
+    stopProducers = true;
+    for(std::thread& thread : producerThreads) {
+        thread.join();
+    }
+    stopConsumers = true;
+    for(std::thread& thread : consumerThreads) {
+        thread.join();
+    }
+
+    const double buffersPerSecond = countBuffersTotal / static_cast<double>(duration.count());
+    std::cout << std::left << std::setw(12) << name << countThreads << " threads, buffers/s: " << std::setw(10)
+              << static_cast<std::uint64_t>(buffersPerSecond) << " ns per buffer: " << static_cast<std::uint64_t>(1e9 / buffersPerSecond) << std::endl;
+}
+
+void benchmarkPool(std::chrono::seconds duration) {
+    runPool<Common::ThreadSafeQueueBuffer>("spsc", 2, duration);
+    for(const std::size_t countThreads : {std::size_t{2}, std::size_t{4}, std::size_t{8}}) {
+        runPool<Common::SharedThreadSafeQueueBuffer>("mpmc", countThreads, duration);
+    }
+}
+
+// ComponentA layouts: step() handles at least one datagram and writes its prices to A -> B transport
+class RunToCompletionLayout {
+    Common::NetworkReaderWriter<Common::ProtocolType::UDP> m_readerUdp{BENCHMARK_PORT};
+    Common::Buffer m_entries{std::vector<std::uint8_t>(Settings::MAX_UDP_BUF)};
+    std::vector<std::size_t> m_recordEnds;
+
+public:
+    template<typename Transport>
+    void step(Transport& transport) {
+        const std::int64_t readBytes = m_readerUdp.read(m_entries.data);
+        if(readBytes <= 0) {
+            return;
+        }
+        m_entries.countBytes = static_cast<std::size_t>(readBytes);
+        if(Processing::filterRecords(m_entries, m_recordEnds, Settings::EOF_MARKER) > 0) {
+            Common::Buffer* const entriesPtr = &m_entries;
+            transport.write(std::span<Common::Buffer* const>(&entriesPtr, 1));
+        }
+    }
+
+    // Nothing runs in background
+    void stop() {}
+};
+
+class TwoThreadLayout {
+    std::shared_ptr<Common::ThreadSafeQueueBuffer> m_threadSafeQueueBufferPtr = std::make_shared<Common::ThreadSafeQueueBuffer>(PIPE_BUF, Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS);
+    std::atomic_bool m_stop = false;
+    std::thread m_readerThread;
+    std::vector<Common::Buffer*> m_entriesBatch = std::vector<Common::Buffer*>(Settings::TRANSPORT_MAX_BATCH);
+    std::vector<Common::Buffer*> m_pricesToSend;
+    std::vector<std::size_t> m_recordEnds;
+
+public:
+    TwoThreadLayout() {
+        // Socket is bound before the constructor returns, so no datagram of generator is refused
+        auto readerUdpPtr = std::make_shared<Common::NetworkReaderWriter<Common::ProtocolType::UDP>>(BENCHMARK_PORT);
+        m_readerThread = std::thread([this, readerUdpPtr]() {
+            while(!m_stop.load(std::memory_order_relaxed)) {
+                Common::Buffer& entries = m_threadSafeQueueBufferPtr->dequeueReadyToUse();
+                const std::int64_t readBytes = readerUdpPtr->read(entries.data);
+                entries.countBytes = static_cast<std::size_t>(std::max<std::int64_t>(readBytes, 0));
+                m_threadSafeQueueBufferPtr->enqueueInProcess(&entries);
+            }
+        });
+    }
+
+    template<typename Transport>
+    void step(Transport& transport) {
+        const std::span<Common::Buffer*> entriesReceived = std::span<Common::Buffer*>(m_entriesBatch).first(m_threadSafeQueueBufferPtr->dequeueInProcess(m_entriesBatch));
+        m_pricesToSend.clear();
+        for(Common::Buffer* entries : entriesReceived) {
+            if(Processing::filterRecords(*entries, m_recordEnds, Settings::EOF_MARKER) > 0) {
+                m_pricesToSend.push_back(entries);
+            }
+        }
+        if(!m_pricesToSend.empty()) {
+            transport.write(std::span<Common::Buffer* const>(m_pricesToSend));
+        }
+        m_threadSafeQueueBufferPtr->enqueueUsed(entriesReceived);
+    }
+
+    // Reader wakes up only with the next datagram, so generator has to run until stop returns
+    void stop() {
+        m_stop = true;
+        m_readerThread.join();
+    }
+};
+
+/* Throughput and latency from datagram to ComponentB side of shared memory transport, for both layouts of ComponentA.
+ * Latency is measured with one datagram in flight, throughput with generator sending as fast as possible
+ * */
+template<typename Layout>
+void runLayout(std::string_view name, std::chrono::seconds duration) {
+    using namespace Common;
+    std::mt19937 generator(42);
+    // Message ending with final marker would stop transport pair
+    std::vector<std::uint8_t> datagram = makeEntriesDatagram(ENTRIES_PER_DATAGRAM, generator);
+    std::replace(datagram.begin(), datagram.end(), FINAL_MESSAGE_MARKER, static_cast<std::uint8_t>(1));
+    {
+        Layout layout;
+        std::atomic_bool generatorDone = false;
+        std::thread generatorThread([&datagram, &generatorDone]() {
+            loadGenerator(BENCHMARK_PORT, datagram, generatorDone);
+        });
+        std::uint64_t countMessages = 0;
+        const Clock::time_point deadline = Clock::now() + duration;
+        runTransportPair(TransportType::SharedMemory, [&layout](auto& transport) {
+            layout.step(transport);
+        }, [&countMessages, deadline](const Buffer&) {
+            ++countMessages;
+            return Clock::now() < deadline;
+        });
+        layout.stop();
+        generatorDone = true;
+        generatorThread.join();
+        std::cout << std::left << std::setw(20) << name << " messages/s: " << static_cast<std::uint64_t>(countMessages / static_cast<double>(duration.count())) << std::endl;
+    }
+
+    Layout layout;
+    std::atomic<Clock::rep> sendTime = 0;
+    std::atomic_uint64_t countReceived = 0;
+    std::atomic_bool senderDone = false;
+    std::thread senderThread([&datagram, &sendTime, &countReceived, &senderDone]() {
+        const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+        checkErrors(socketDescriptor, -1);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = ::htons(BENCHMARK_PORT);
+        address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+        while(!senderDone.load(std::memory_order_relaxed)) {
+            const std::uint64_t countBefore = countReceived.load(std::memory_order_acquire);
+            sendTime.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+            ::sendto(socketDescriptor, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+            const Clock::time_point resendTime = Clock::now() + std::chrono::milliseconds(100);
+            while(countReceived.load(std::memory_order_acquire) == countBefore && Clock::now() < resendTime && !senderDone.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+        ::close(socketDescriptor);
+    });
+    std::vector<std::chrono::nanoseconds> latencies;
+    runTransportPair(TransportType::SharedMemory, [&layout](auto& transport) {
+        layout.step(transport);
+    }, [&sendTime, &countReceived, &latencies, deadline = Clock::now() + duration](const Buffer&) {
+        const Clock::time_point sent{Clock::duration(sendTime.load(std::memory_order_acquire))};
+        latencies.push_back(Clock::now() - sent);
+        countReceived.fetch_add(1, std::memory_order_release);
+        return Clock::now() < deadline;
+    });
+    layout.stop();
+    senderDone = true;
+    senderThread.join();
+    printLatencies(name, latencies);
+}
+
+void benchmarkLayout(std::chrono::seconds duration) {
+    runLayout<TwoThreadLayout>("two threads", duration);
+    runLayout<RunToCompletionLayout>("run to completion", duration);
+}
+
+/* Two thread layout of ComponentA with ingest and egress batches picked by controllers,
+ * counts datagrams and batches of both stages so average batch size is reported next to latency
+ * */
+class BatchingLayout {
+    std::shared_ptr<Common::ThreadSafeQueueBuffer> m_threadSafeQueueBufferPtr = std::make_shared<Common::ThreadSafeQueueBuffer>(std::vector<Common::SizeClass>{
+        {Settings::INGEST_SMALL_BUFFER_SIZE, Settings::INGEST_SMALL_COUNT_BUFFERS},
+        {Settings::INGEST_MEDIUM_BUFFER_SIZE, Settings::INGEST_MEDIUM_COUNT_BUFFERS},
+        {Settings::INGEST_LARGE_BUFFER_SIZE, Settings::INGEST_LARGE_COUNT_BUFFERS}
+    });
+    Common::BatchController m_ingestController;
+    Common::BatchController m_egressController;
+    // Socket is bound before the constructor returns, so no datagram of generator is refused
+    Common::BatchedUdpReader m_readerUdp;
+    std::atomic_bool m_stop = false;
+    std::atomic_bool m_readerDone = false;
+    std::atomic_uint64_t m_countIngestDatagrams = 0;
+    std::atomic_uint64_t m_countIngestBatches = 0;
+    std::uint64_t m_countEgressDatagrams = 0;
+    std::uint64_t m_countEgressBatches = 0;
+    std::thread m_readerThread;
+    std::vector<Common::Buffer*> m_entriesBatch;
+    std::vector<Common::Buffer*> m_pricesToSend;
+    std::vector<std::size_t> m_recordEnds;
+
+public:
+    explicit BatchingLayout(bool isAdaptive)
+        : m_ingestController(1, isAdaptive ? Settings::ADAPTIVE_MAX_BATCH_SIZE : 1),
+        m_egressController(isAdaptive ? 1 : Settings::TRANSPORT_MAX_BATCH, isAdaptive ? Settings::ADAPTIVE_MAX_BATCH_SIZE : Settings::TRANSPORT_MAX_BATCH),
+        m_readerUdp(BENCHMARK_PORT, m_ingestController.maxBatchSize()),
+        m_entriesBatch(m_egressController.maxBatchSize()) {
+        m_readerThread = std::thread([this]() {
+            while(!m_stop.load(std::memory_order_relaxed)) {
+                const std::size_t countRead = m_readerUdp.read(*m_threadSafeQueueBufferPtr, m_ingestController.next(m_threadSafeQueueBufferPtr->countInProcess()));
+                m_countIngestDatagrams.fetch_add(countRead, std::memory_order_relaxed);
+                m_countIngestBatches.fetch_add(1, std::memory_order_relaxed);
+            }
+            m_readerDone = true;
+        });
+    }
+
+    template<typename Transport>
+    void step(Transport& transport) {
+        const std::span<Common::Buffer*> entriesAllowed = std::span<Common::Buffer*>(m_entriesBatch).first(m_egressController.next(m_threadSafeQueueBufferPtr->countInProcess()));
+        const std::span<Common::Buffer*> entriesReceived = entriesAllowed.first(m_threadSafeQueueBufferPtr->dequeueInProcess(entriesAllowed));
+        m_pricesToSend.clear();
+        for(Common::Buffer* entries : entriesReceived) {
+            if(Processing::filterRecords(*entries, m_recordEnds, Settings::EOF_MARKER) > 0 && entries->countBytes > 0) {
+                m_pricesToSend.push_back(entries);
+            }
+        }
+        if(!m_pricesToSend.empty()) {
+            transport.write(std::span<Common::Buffer* const>(m_pricesToSend));
+        }
+        m_threadSafeQueueBufferPtr->enqueueUsed(entriesReceived);
+        m_countEgressDatagrams += entriesReceived.size();
+        ++m_countEgressBatches;
+    }
+
+    // Reader might wait for buffers which nobody writes anymore, so they are returned here until it is gone
+    void stop() {
+        m_stop = true;
+        while(!m_readerDone.load(std::memory_order_relaxed)) {
+            if(Common::Buffer* entries = m_threadSafeQueueBufferPtr->tryDequeueInProcess()) {
+                m_threadSafeQueueBufferPtr->enqueueUsed(entries);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        m_readerThread.join();
+    }
+
+    double averageIngestBatch() const {
+        return m_countIngestDatagrams.load() / std::max<double>(m_countIngestBatches.load(), 1);
+    }
+    double averageEgressBatch() const { return m_countEgressDatagrams / std::max<double>(m_countEgressBatches, 1); }
+};
+
+/* Latency and throughput curve of fixed and adaptive batching: generator sends at given rate (0 is as fast as possible),
+ * sequence number of a datagram travels in its first three prices, so every message is matched with its send time
+ * */
+void runBatching(std::string_view name, bool isAdaptive, std::uint64_t datagramsPerSecond, std::chrono::seconds duration) {
+    using namespace Common;
+    // Digits of sequence number are prices 20..219, so none of them is EOF or final marker
+    constexpr std::uint64_t DIGIT_BASE = 200;
+    constexpr std::uint8_t DIGIT_OFFSET = 20;
+    constexpr std::uint64_t COUNT_SEQUENCE_NUMBERS = DIGIT_BASE * DIGIT_BASE * DIGIT_BASE;
+    // Divides count of sequence numbers, so slot of a send time follows wrap around of sequence number
+    constexpr std::size_t COUNT_SEND_TIMES = 1'000'000;
+    std::mt19937 generator(42);
+    std::vector<std::uint8_t> datagram = makeEntriesDatagram(ENTRIES_PER_DATAGRAM, generator);
+    std::replace(datagram.begin(), datagram.end(), FINAL_MESSAGE_MARKER, static_cast<std::uint8_t>(1));
+    std::vector<std::atomic<Clock::rep>> sendTimes(COUNT_SEND_TIMES);
+
+    BatchingLayout layout(isAdaptive);
+    std::atomic_bool generatorDone = false;
+    std::thread generatorThread([&datagram, &sendTimes, &generatorDone, datagramsPerSecond]() {
+        const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+        checkErrors(socketDescriptor, -1);
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = ::htons(BENCHMARK_PORT);
+        address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+        std::vector<std::uint8_t> datagramToSend = datagram;
+        const Clock::time_point start = Clock::now();
+        for(std::uint64_t sequenceNumber = 0; !generatorDone.load(std::memory_order_relaxed); ++sequenceNumber) {
+            if(datagramsPerSecond > 0) {
+                const Clock::time_point sendTime = start + std::chrono::nanoseconds(sequenceNumber * 1'000'000'000 / datagramsPerSecond);
+                while(Clock::now() < sendTime && !generatorDone.load(std::memory_order_relaxed)) {
+                    std::this_thread::yield();
+                }
+            }
+            std::uint64_t digits = sequenceNumber % COUNT_SEQUENCE_NUMBERS;
+            for(std::size_t digit = 0; digit < 3; ++digit) {
+                datagramToSend[digit * 2] = static_cast<std::uint8_t>(DIGIT_OFFSET + digits % DIGIT_BASE);
+                digits /= DIGIT_BASE;
+            }
+            sendTimes[sequenceNumber % COUNT_SEND_TIMES].store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            ::sendto(socketDescriptor, datagramToSend.data(), datagramToSend.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        }
+        ::close(socketDescriptor);
+    });
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    const Clock::time_point deadline = Clock::now() + duration;
+    runTransportPair(TransportType::SharedMemory, [&layout](auto& transport) {
+        layout.step(transport);
+    }, [&sendTimes, &latencies, deadline](const Buffer& prices) {
+        const Clock::time_point now = Clock::now();
+        std::uint64_t sequenceNumber = 0;
+        for(std::size_t digit = 3; digit > 0; --digit) {
+            sequenceNumber = sequenceNumber * DIGIT_BASE + (prices.data[digit - 1] - DIGIT_OFFSET);
+        }
+        const Clock::time_point sent{Clock::duration(sendTimes[sequenceNumber % COUNT_SEND_TIMES].load(std::memory_order_relaxed))};
+        latencies.push_back(now - sent);
+        return now < deadline;
+    });
+    layout.stop();
+    generatorDone = true;
+    generatorThread.join();
+
+    std::string rate = datagramsPerSecond > 0 ? std::to_string(datagramsPerSecond) : std::string("max");
+    rate.append("/s");
+    std::cout << std::left << std::setw(10) << name << std::setw(10) << rate << std::fixed << std::setprecision(1)
+              << " messages/s: " << std::setw(10) << static_cast<std::uint64_t>(latencies.size() / static_cast<double>(duration.count()))
+              << " ingest batch: " << std::setw(6) << layout.averageIngestBatch()
+              << " egress batch: " << std::setw(6) << layout.averageEgressBatch() << std::endl;
+    printLatencies("", latencies);
+}
+
+void benchmarkBatching(std::chrono::seconds duration) {
+    for(const std::uint64_t datagramsPerSecond : {std::uint64_t{10'000}, std::uint64_t{100'000}, std::uint64_t{0}}) {
+        runBatching("fixed", false, datagramsPerSecond, duration);
+        runBatching("adaptive", true, datagramsPerSecond, duration);
+    }
+}
+
+/* TCP sink stands in for external server: accepts single connection and reads messages until writer closes it.
+ * Message is 5 bytes as ComponentB sends them, first four carry sequence number, so every message is matched with its send time
+ * */
+std::vector<std::chrono::nanoseconds> runTcpSink(int listenFileDescriptor, const std::vector<std::atomic<Clock::rep>>& sendTimes) {
+    const int connectionFileDescriptor = ::accept(listenFileDescriptor, nullptr, nullptr);
+    Common::checkErrors(connectionFileDescriptor, -1);
+    std::vector<std::chrono::nanoseconds> latencies;
+    std::vector<std::uint8_t> buffer(1 << 16);
+    std::size_t countBuffered = 0;
+    while(true) {
+        const ssize_t readBytes = ::read(connectionFileDescriptor, buffer.data() + countBuffered, buffer.size() - countBuffered);
+        if(readBytes <= 0) {
+            break;
+        }
+        const Clock::time_point now = Clock::now();
+        countBuffered += static_cast<std::size_t>(readBytes);
+        std::size_t offset = 0;
+        for(; offset + Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE <= countBuffered; offset += Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE) {
+            std::uint32_t sequenceNumber = 0;
+            std::memcpy(&sequenceNumber, buffer.data() + offset, sizeof(sequenceNumber));
+            const Clock::time_point sent{Clock::duration(sendTimes[sequenceNumber % sendTimes.size()].load(std::memory_order_relaxed))};
+            latencies.push_back(now - sent);
+        }
+        // Message split between reads waits for its tail
+        std::memmove(buffer.data(), buffer.data() + offset, countBuffered - offset);
+        countBuffered -= offset;
+    }
+    ::close(connectionFileDescriptor);
+    return latencies;
+}
+
+/* Writes 5 byte messages through flush window to TCP sink with socket tuned by profile. Paced run (messages per second > 0)
+ * flushes every message at once, as ComponentB does at idle, run at max rate flushes once per batch of messages
+ * */
+void runTcpProfile(std::string_view name, const Common::TcpTuning& tcpTuning, std::uint64_t messagesPerSecond, std::chrono::seconds duration) {
+    using namespace Common;
+    constexpr std::size_t MESSAGES_PER_BATCH = 64;
+    // Power of two, so slot of a send time follows wrap around of 32 bit sequence number
+    constexpr std::size_t COUNT_SEND_TIMES = 1 << 20;
+    std::vector<std::atomic<Clock::rep>> sendTimes(COUNT_SEND_TIMES);
+
+    const int listenFileDescriptor = ::socket(AF_INET, SOCK_STREAM, 0);
+    checkErrors(listenFileDescriptor, -1);
+    const int reuseAddress = 1;
+    ::setsockopt(listenFileDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = ::htons(TCP_SINK_PORT);
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    checkErrors(::bind(listenFileDescriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)), -1);
+    checkErrors(::listen(listenFileDescriptor, 1), -1);
+
+    std::vector<std::chrono::nanoseconds> latencies;
+    std::thread sinkThread([listenFileDescriptor, &sendTimes, &latencies]() {
+        latencies = runTcpSink(listenFileDescriptor, sendTimes);
+    });
+
+    FlushCounters counters;
+    {
+        NetworkReaderWriter<ProtocolType::TCP> writerTcp(TCP_SINK_PORT, "127.0.0.1");
+        writerTcp.setTcpTuning(tcpTuning);
+        FlushWindow flushWindow(Settings::EGRESS_FLUSH_BYTES, std::chrono::microseconds(0), counters);
+        const auto flush = [&writerTcp, &flushWindow](FlushReason reason) {
+            if(flushWindow.isEmpty()) {
+                return;
+            }
+            writerTcp.write(flushWindow.pending());
+            if(reason == FlushReason::Deadline) {
+                writerTcp.push();
+            }
+            flushWindow.flushed(reason);
+        };
+
+        std::array<std::uint8_t, Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE> message{};
+        message.fill(88);
+        const Clock::time_point start = Clock::now();
+        const Clock::time_point deadline = start + duration;
+        for(std::uint32_t sequenceNumber = 0; Clock::now() < deadline; ++sequenceNumber) {
+            if(messagesPerSecond > 0) {
+                const Clock::time_point sendTime = start + std::chrono::nanoseconds(sequenceNumber * 1'000'000'000ULL / messagesPerSecond);
+                while(Clock::now() < sendTime) {
+                    std::this_thread::yield();
+                }
+            }
+            std::memcpy(message.data(), &sequenceNumber, sizeof(sequenceNumber));
+            sendTimes[sequenceNumber % COUNT_SEND_TIMES].store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            flushWindow.append(message);
+            if(flushWindow.isFull()) {
+                flush(FlushReason::Size);
+            }
+            if(messagesPerSecond > 0 || (sequenceNumber + 1) % MESSAGES_PER_BATCH == 0) {
+                flush(FlushReason::Deadline);
+            }
+        }
+        flush(FlushReason::Deadline);
+    }
+    sinkThread.join();
+    ::close(listenFileDescriptor);
+
+    std::string rate = messagesPerSecond > 0 ? std::to_string(messagesPerSecond) : std::string("max");
+    rate.append("/s");
+    std::cout << std::left << std::setw(12) << name << std::setw(10) << rate
+              << " messages/s: " << std::setw(10) << static_cast<std::uint64_t>(latencies.size() / static_cast<double>(duration.count()))
+              << " flushes by size: " << std::setw(8) << counters.countFlushedBySize.load()
+              << " by deadline: " << counters.countFlushedByDeadline.load() << std::endl;
+    printLatencies("", latencies);
+}
+
+void benchmarkTcpProfile(std::chrono::seconds duration) {
+    const std::vector<std::pair<std::string_view, Common::TcpTuning>> profiles = {
+        {"kernel", Common::TcpTuning{Common::TcpProfile::Kernel}},
+        {"nodelay", Common::TcpTuning{Common::TcpProfile::NoDelay}},
+        {"latency", Common::TcpTuning{Common::TcpProfile::Latency, Settings::TCP_LATENCY_SEND_BUFFER_SIZE, Settings::TCP_LATENCY_NOT_SENT_LOW_WATERMARK}},
+        {"throughput", Common::TcpTuning{Common::TcpProfile::Throughput}},
+    };
+    for(const std::uint64_t messagesPerSecond : {std::uint64_t{10'000}, std::uint64_t{0}}) {
+        for(const auto& [name, tcpTuning] : profiles) {
+            runTcpProfile(name, tcpTuning, messagesPerSecond, duration);
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const std::map<std::string_view, std::function<void(std::chrono::seconds)>> benchmarks = {
+        {"batching", benchmarkBatching},
+        {"ingest", benchmarkIngest},
+        {"ingest-latency", benchmarkIngestLatency},
+        {"filter", benchmarkFilter},
+        {"filter-workers", benchmarkFilterWorkers},
+        {"fused", benchmarkFused},
+        {"instruments", benchmarkInstruments},
+        {"layout", benchmarkLayout},
+        {"messages", benchmarkMessages},
+        {"pipeline", benchmarkPipeline},
+        {"pool", benchmarkPool},
+        {"price-bitmap", benchmarkPriceBitmap},
+        {"queue", benchmarkQueue},
+        {"record-layouts", benchmarkRecordLayouts},
+        {"records", benchmarkRecords},
+        {"splice", benchmarkSplice},
+        {"tcp-profile", benchmarkTcpProfile},
+        {"transport", benchmarkTransport},
+    };
+
+    if(argc < 2 || argc > 3 || !benchmarks.contains(argv[1])) {
+        std::cerr << "Wrong arguments, usage: ./Benchmarks [";
+        for(const auto& [name, benchmark] : benchmarks) {
+            std::cerr << name << (name == benchmarks.rbegin()->first ? "" : "|");
+        }
+        std::cerr << "] [duration in seconds, or empty for 3]" << std::endl;
+        return -1;
+    }
+
+    // Transports report broken pipe by errno
+    std::signal(SIGPIPE, SIG_IGN);
+
+    try {
+        const std::chrono::seconds duration(argc == 3 ? std::stoi(argv[2]) : 3);
+        benchmarks.at(argv[1])(duration);
+    } catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
@@ -1,8 +1,45 @@
 #include "Common.h"
 
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <stdexcept>
+
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+
 namespace Common {
 
-Buffer& ThreadSafeQueueBuffer::dequeue(LockFreeSPSCQueueT& queue) {
+namespace {
+
+constexpr std::chrono::milliseconds RECONNECT_INTERVAL(100);
+
+bool isPeerGone(int error) {
+    return error == EPIPE || error == ECONNRESET || error == ENOTCONN;
+}
+
+sockaddr_storage getUnixAddressStructHelper(std::string_view socketPath) {
+    sockaddr_storage storage{};
+    sockaddr_un& address = reinterpret_cast<sockaddr_un&>(storage);
+    address.sun_family = AF_UNIX;
+    NET_ASSERT(socketPath.size() < sizeof(address.sun_path));
+    std::memcpy(address.sun_path, socketPath.data(), std::min(socketPath.size(), sizeof(address.sun_path) - 1));
+    return storage;
+}
+
+sockaddr_storage getLoopbackAddressStructHelper(std::uint16_t port) {
+    sockaddr_storage storage{};
+    sockaddr_in& address = reinterpret_cast<sockaddr_in&>(storage);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    address.sin_port = ::htons(port);
+    return storage;
+}
+
+} // namespace
+
+template<typename Queue>
+Buffer& BasicThreadSafeQueueBuffer<Queue>::dequeue(Queue& queue) {
     Buffer* nextBuffer = nullptr;
     while(!queue.try_dequeue(nextBuffer)) {
         std::this_thread::yield();
@@ -10,28 +47,366 @@ Buffer& ThreadSafeQueueBuffer::dequeue(LockFreeSPSCQueueT& queue) {
     return *nextBuffer;
 }
 
-void ThreadSafeQueueBuffer::enqueue(LockFreeSPSCQueueT& queue, Buffer* buffer) {
+template<typename Queue>
+void BasicThreadSafeQueueBuffer<Queue>::enqueue(Queue& queue, Buffer* buffer) {
     // We don't want to allocate
     while(!queue.try_enqueue(buffer)) {
         std::this_thread::yield();
     }
 }
 
-ThreadSafeQueueBuffer::ThreadSafeQueueBuffer(std::size_t defaultBufferSize, std::size_t countBuffers)
-    : buffers(countBuffers),
-    queueUsed(countBuffers),
-    queueInProcess(countBuffers) {
+template<typename Queue>
+void BasicThreadSafeQueueBuffer<Queue>::enqueueBulk(Queue& queue, std::span<Buffer* const> buffers) {
+    if constexpr(requires { queue.try_enqueue_bulk(buffers.data(), buffers.size()); }) {
+        // Queue has room for every buffer of the pool, so it is never full in practice
+        NET_ASSERT(buffers.size() <= queue.max_capacity());
+        while(!queue.try_enqueue_bulk(buffers.data(), buffers.size())) {
+            std::this_thread::yield();
+        }
+        return;
+    }
+    for(Buffer* buffer : buffers) {
+        enqueue(queue, buffer);
+    }
+}
+
+template<typename Queue>
+BasicThreadSafeQueueBuffer<Queue>::BasicThreadSafeQueueBuffer(std::size_t defaultBufferSize, std::size_t countBuffers, OverflowPolicy overflowPolicy)
+    : BasicThreadSafeQueueBuffer(std::vector<SizeClass>{{defaultBufferSize, countBuffers}}, overflowPolicy) {
+}
+
+template<typename Queue>
+BasicThreadSafeQueueBuffer<Queue>::BasicThreadSafeQueueBuffer(std::vector<SizeClass> sizeClasses, OverflowPolicy overflowPolicy)
+    : sizeClasses(std::move(sizeClasses)),
+    queueInProcess(countBuffersOf(this->sizeClasses)),
+    overflowPolicy(overflowPolicy) {
+    if(isShared && overflowPolicy != OverflowPolicy::Block) {
+        throw std::invalid_argument("Shared buffer pool supports only block overflow policy");
+    }
+    NET_ASSERT(std::is_sorted(this->sizeClasses.begin(), this->sizeClasses.end(), [](const SizeClass& left, const SizeClass& right) {
+        return left.bufferSize < right.bufferSize;
+    }));
+    std::size_t countBuffers = 0;
+    queuesUsed.reserve(this->sizeClasses.size());
+    for(const SizeClass& sizeClass : this->sizeClasses) {
+        countBuffers += sizeClass.countBuffers;
+        sizeClassEnds.push_back(countBuffers);
+        queuesUsed.emplace_back(sizeClass.countBuffers);
+    }
+
     // This number could be increased to make process ([msg with Entries] -> [A] -> [B] <-> [Server])
     // more efficient if we have small non-interleaving delays from 1st or 4th component, assuming A and B runs on same machine
-    for(Buffer& buffer : buffers) {
-        buffer.data.resize(defaultBufferSize);
-        const bool result = queueUsed.try_enqueue(&buffer);
+    buffers.resize(countBuffers);
+    for(std::size_t index = 0, sizeClass = 0; index < countBuffers; ++index) {
+        while(index >= sizeClassEnds[sizeClass]) {
+            ++sizeClass;
+        }
+        buffers[index].data.resize(this->sizeClasses[sizeClass].bufferSize);
+        [[maybe_unused]] const bool result = queuesUsed[sizeClass].try_enqueue(&buffers[index]);
         NET_ASSERT(result);
     }
+    if(overflowPolicy == OverflowPolicy::DropOldest) {
+        reclaimedBuffers.reserve(countBuffers);
+    }
+    if(overflowPolicy == OverflowPolicy::DropNewest) {
+        scratchBuffer.data.resize(maxBufferSize());
+    }
+}
+
+template<typename Queue>
+std::size_t BasicThreadSafeQueueBuffer<Queue>::countBuffersOf(const std::vector<SizeClass>& sizeClasses) {
+    std::size_t countBuffers = 0;
+    for(const SizeClass& sizeClass : sizeClasses) {
+        countBuffers += sizeClass.countBuffers;
+    }
+    return countBuffers;
+}
+
+template<typename Queue>
+void BasicThreadSafeQueueBuffer<Queue>::increment(std::atomic_uint64_t& counter) {
+    if constexpr(isShared) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        // Every counter has single writer, others only read it
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+template<typename Queue>
+std::size_t BasicThreadSafeQueueBuffer<Queue>::sizeClassOf(const Buffer* buffer) const {
+    const std::size_t index = static_cast<std::size_t>(buffer - buffers.data());
+    NET_ASSERT(index < buffers.size());
+    return static_cast<std::size_t>(std::upper_bound(sizeClassEnds.begin(), sizeClassEnds.end(), index) - sizeClassEnds.begin());
+}
+
+template<typename Queue>
+bool BasicThreadSafeQueueBuffer<Queue>::tryDequeueReadyToUse(std::size_t minimumSize, Buffer*& buffer) {
+    for(std::size_t sizeClass = 0; sizeClass < sizeClasses.size(); ++sizeClass) {
+        if(sizeClasses[sizeClass].bufferSize >= minimumSize && queuesUsed[sizeClass].try_dequeue(buffer)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Queue>
+std::size_t BasicThreadSafeQueueBuffer<Queue>::countToUse() const {
+    std::size_t count = 0;
+    for(const Queue& queueUsed : queuesUsed) {
+        count += queueUsed.size_approx();
+    }
+    return count;
+}
+
+template<typename Queue>
+std::size_t BasicThreadSafeQueueBuffer<Queue>::capacityToUse() const {
+    std::size_t capacity = 0;
+    for(const Queue& queueUsed : queuesUsed) {
+        capacity += queueUsed.max_capacity();
+    }
+    return capacity;
 }
 
+template<typename Queue>
+bool BasicThreadSafeQueueBuffer<Queue>::tryTakeReclaimed(std::size_t minimumSize, Buffer*& buffer) {
+    const auto reclaimed = std::find_if(reclaimedBuffers.begin(), reclaimedBuffers.end(), [minimumSize](const Buffer* reclaimedBuffer) {
+        return reclaimedBuffer->data.size() >= minimumSize;
+    });
+    if(reclaimed == reclaimedBuffers.end()) {
+        return false;
+    }
+    buffer = *reclaimed;
+    reclaimedBuffers.erase(reclaimed);
+    return true;
+}
+
+template<typename Queue>
+bool BasicThreadSafeQueueBuffer<Queue>::tryDequeueInProcessLocked(Buffer*& buffer) {
+    while(inProcessLock.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    const bool result = queueInProcess.try_dequeue(buffer);
+    inProcessLock.clear(std::memory_order_release);
+    return result;
+}
+
+template<typename Queue>
+Buffer& BasicThreadSafeQueueBuffer<Queue>::dequeueReadyToUse(std::size_t minimumSize) {
+    NET_ASSERT(minimumSize <= maxBufferSize());
+    Buffer* nextBuffer = nullptr;
+    if(!reclaimedBuffers.empty() && tryTakeReclaimed(minimumSize, nextBuffer)) {
+        return *nextBuffer;
+    }
+    if(tryDequeueReadyToUse(minimumSize, nextBuffer)) {
+        return *nextBuffer;
+    }
+    return dequeueReadyToUseOnOverflow(minimumSize);
+}
 
+template<typename Queue>
+Buffer* BasicThreadSafeQueueBuffer<Queue>::tryDequeueReadyToUse(std::size_t minimumSize) {
+    NET_ASSERT(minimumSize <= maxBufferSize());
+    Buffer* nextBuffer = nullptr;
+    if(!reclaimedBuffers.empty() && tryTakeReclaimed(minimumSize, nextBuffer)) {
+        return nextBuffer;
+    }
+    return tryDequeueReadyToUse(minimumSize, nextBuffer) ? nextBuffer : nullptr;
+}
 
+template<typename Queue>
+Buffer& BasicThreadSafeQueueBuffer<Queue>::dequeueReadyToUseOnOverflow(std::size_t minimumSize) {
+    Buffer* nextBuffer = nullptr;
+    switch(overflowPolicy) {
+        case OverflowPolicy::Block:
+            increment(overflowCounters.countBlocked);
+            while(!tryDequeueReadyToUse(minimumSize, nextBuffer)) {
+                std::this_thread::yield();
+            }
+            return *nextBuffer;
+        case OverflowPolicy::DropNewest:
+            // Data is still read, so kernel buffer is drained, it is just never seen by consumer
+            increment(overflowCounters.countDroppedNewest);
+            return scratchBuffer;
+        case OverflowPolicy::DropOldest: {
+            // Consumer might hold every buffer, then we wait for the first one to come back
+            while(!tryDequeueReadyToUse(minimumSize, nextBuffer)) {
+                if(tryDequeueInProcessLocked(nextBuffer)) {
+                    increment(overflowCounters.countDroppedOldest);
+                    if(nextBuffer->data.size() >= minimumSize) {
+                        break;
+                    }
+                    // Queues of used buffers are filled only by consumer, so too small buffer stays with producer
+                    reclaimedBuffers.push_back(nextBuffer);
+                    continue;
+                }
+                std::this_thread::yield();
+            }
+            return *nextBuffer;
+        }
+    }
+    return dequeue(queuesUsed.front());
+}
+
+template<typename Queue>
+Buffer& BasicThreadSafeQueueBuffer<Queue>::dequeueInProcess() {
+    if(overflowPolicy != OverflowPolicy::DropOldest) {
+        return dequeue(queueInProcess);
+    }
+    Buffer* nextBuffer = nullptr;
+    while(!tryDequeueInProcessLocked(nextBuffer)) {
+        std::this_thread::yield();
+    }
+    return *nextBuffer;
+}
+
+template<typename Queue>
+Buffer* BasicThreadSafeQueueBuffer<Queue>::tryDequeueInProcess() {
+    Buffer* nextBuffer = nullptr;
+    if(overflowPolicy == OverflowPolicy::DropOldest) {
+        return tryDequeueInProcessLocked(nextBuffer) ? nextBuffer : nullptr;
+    }
+    return queueInProcess.try_dequeue(nextBuffer) ? nextBuffer : nullptr;
+}
+
+template<typename Queue>
+void BasicThreadSafeQueueBuffer<Queue>::enqueueInProcess(Buffer* buffer) {
+    if(buffer == &scratchBuffer) {
+        return;
+    }
+    enqueue(queueInProcess, buffer);
+}
+
+template<typename Queue>
+std::size_t BasicThreadSafeQueueBuffer<Queue>::tryDequeueBulk(Queue& queue, std::span<Buffer*> buffers) {
+    if constexpr(requires { queue.try_dequeue_bulk(buffers.data(), buffers.size()); }) {
+        return queue.try_dequeue_bulk(buffers.data(), buffers.size());
+    }
+    std::size_t countTaken = 0;
+    while(countTaken < buffers.size() && queue.try_dequeue(buffers[countTaken])) {
+        ++countTaken;
+    }
+    return countTaken;
+}
+
+template<typename Queue>
+std::size_t BasicThreadSafeQueueBuffer<Queue>::dequeueInProcess(std::span<Buffer*> buffers) {
+    NET_ASSERT(!buffers.empty());
+    if(overflowPolicy != OverflowPolicy::DropOldest) {
+        buffers[0] = &dequeue(queueInProcess);
+        return 1 + tryDequeueBulk(queueInProcess, buffers.subspan(1));
+    }
+    // Whole burst is taken under single lock, so producer can't reclaim buffers in the middle of it
+    while(true) {
+        while(inProcessLock.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        const std::size_t countTaken = tryDequeueBulk(queueInProcess, buffers);
+        inProcessLock.clear(std::memory_order_release);
+        if(countTaken > 0) {
+            return countTaken;
+        }
+        std::this_thread::yield();
+    }
+}
+
+template<typename Queue>
+void BasicThreadSafeQueueBuffer<Queue>::enqueueInProcess(std::span<Buffer* const> buffers) {
+    if(overflowPolicy != OverflowPolicy::DropNewest) {
+        enqueueBulk(queueInProcess, buffers);
+        return;
+    }
+    for(Buffer* buffer : buffers) {
+        enqueueInProcess(buffer);
+    }
+}
+
+template<typename Queue>
+void BasicThreadSafeQueueBuffer<Queue>::enqueueUsed(std::span<Buffer* const> buffers) {
+    if(sizeClasses.size() == 1) {
+        enqueueBulk(queuesUsed.front(), buffers);
+        return;
+    }
+    for(Buffer* buffer : buffers) {
+        enqueueUsed(buffer);
+    }
+}
+
+template class BasicThreadSafeQueueBuffer<MoodycamelQueueT>;
+template class BasicThreadSafeQueueBuffer<CircularBufferQueueT>;
+template class BasicThreadSafeQueueBuffer<RingQueueT>;
+template class BasicThreadSafeQueueBuffer<LockFreeMPMCQueueT>;
+
+OverflowPolicy overflowPolicyFromString(std::string_view name) {
+    if(name == "block") {
+        return OverflowPolicy::Block;
+    }
+    if(name == "drop-oldest") {
+        return OverflowPolicy::DropOldest;
+    }
+    if(name == "drop-newest") {
+        return OverflowPolicy::DropNewest;
+    }
+    throw std::invalid_argument("Unknown overflow policy: " + std::string(name));
+}
+
+
+
+
+Backoff::Backoff(std::size_t countYields, std::chrono::microseconds maxSleepInterval)
+    : m_countYields(countYields),
+    m_maxSleepInterval(maxSleepInterval) {
+    NET_ASSERT(maxSleepInterval.count() > 0);
+}
+
+void Backoff::wait() {
+    if(m_countYielded < m_countYields) {
+        ++m_countYielded;
+        std::this_thread::yield();
+        return;
+    }
+    m_sleepInterval = std::clamp(m_sleepInterval * 2, std::chrono::microseconds(1), m_maxSleepInterval);
+    std::this_thread::sleep_for(m_sleepInterval);
+}
+
+void Backoff::reset() {
+    m_countYielded = 0;
+    m_sleepInterval = std::chrono::microseconds(0);
+}
+
+ReorderBuffer::ReorderBuffer(std::size_t capacity)
+    : m_slots(capacity) {
+    NET_ASSERT(capacity > 0);
+}
+
+ReorderBuffer::ReorderBuffer(ReorderBuffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+ReorderBuffer& ReorderBuffer::operator=(ReorderBuffer&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_nextSequenceNumber, other.m_nextSequenceNumber);
+    }
+    return *this;
+}
+
+void ReorderBuffer::publish(Buffer* buffer) {
+    Slot& slot = m_slots[buffer->sequenceNumber % m_slots.size()];
+    NET_ASSERT(slot.buffer.load(std::memory_order_relaxed) == nullptr);
+    slot.buffer.store(buffer, std::memory_order_release);
+}
+
+Buffer* ReorderBuffer::tryTake() {
+    Slot& slot = m_slots[m_nextSequenceNumber % m_slots.size()];
+    Buffer* buffer = slot.buffer.load(std::memory_order_acquire);
+    if(buffer == nullptr) {
+        return nullptr;
+    }
+    NET_ASSERT(buffer->sequenceNumber == m_nextSequenceNumber);
+    slot.buffer.store(nullptr, std::memory_order_relaxed);
+    ++m_nextSequenceNumber;
+    return buffer;
+}
 
 NamedPipe::NamedPipe(std::string_view pipePath) {
     // Ignore result since we don't know which process starts first
@@ -56,15 +431,19 @@ NamedPipe& NamedPipe::operator=(NamedPipe&& other) noexcept {
 }
 
 void NamedPipe::write(const std::vector<std::uint8_t>& bufferToWrite) {
-    const std::int32_t countWrites = (static_cast<std::int32_t>(bufferToWrite.size()) / PIPE_BUF) + 1;
+    write(bufferToWrite.data(), bufferToWrite.size());
+}
+
+void NamedPipe::write(const std::uint8_t* data, std::size_t countBytes) {
+    const std::int32_t countWrites = (static_cast<std::int32_t>(countBytes) / PIPE_BUF) + 1;
     std::int32_t offset = 0;
-    // since max buffer size of pipe might be less than bufferToWrite, we might need
+    // since max buffer size of pipe might be less than data, we might need
     // to do write in several iterations
     for(std::int32_t i = 0; i < countWrites; ++i) {
         const int fileDescriptor = ::open(m_pipePath.c_str(), O_WRONLY);
         NET_CHECK(fileDescriptor, -1);
-        const std::size_t countBytesToSend = i < countWrites - 1 ? PIPE_BUF : bufferToWrite.size() - offset;
-        const ssize_t resultWrite = ::write(fileDescriptor, bufferToWrite.data() + offset, countBytesToSend);
+        const std::size_t countBytesToSend = i < countWrites - 1 ? PIPE_BUF : countBytes - offset;
+        const ssize_t resultWrite = ::write(fileDescriptor, data + offset, countBytesToSend);
         NET_CHECK(resultWrite, -1L);
         const int resultClose = ::close(fileDescriptor);
         NET_CHECK(resultClose, -1);
@@ -72,6 +451,24 @@ void NamedPipe::write(const std::vector<std::uint8_t>& bufferToWrite) {
     }
 }
 
+void NamedPipe::write(std::span<const std::vector<std::uint8_t>> buffersToWrite) {
+    for(const std::vector<std::uint8_t>& bufferToWrite : buffersToWrite) {
+        write(bufferToWrite);
+    }
+}
+
+void NamedPipe::write(std::span<Buffer* const> buffersToWrite) {
+    for(const Buffer* bufferToWrite : buffersToWrite) {
+        write(bufferToWrite->data.data(), bufferToWrite->countBytes);
+    }
+}
+
+std::size_t NamedPipe::read(std::span<Buffer*> buffers) {
+    NET_ASSERT(!buffers.empty());
+    read(*buffers.front());
+    return 1;
+}
+
 void NamedPipe::read(Buffer& buffer) {
     const int fileDescriptor = ::open(m_pipePath.c_str(), O_RDONLY);
     NET_CHECK(fileDescriptor, -1);
@@ -82,4 +479,618 @@ void NamedPipe::read(Buffer& buffer) {
     NET_CHECK(resultClose, -1);
 }
 
-} // namespace Common
\ No newline at end of file
+
+
+
+
+SplicePipe::SplicePipe(std::string_view pipePath, std::size_t pipeCapacity, std::size_t slotSize, std::size_t countSlots)
+    : m_pipePath(pipePath),
+    m_pipeCapacity(pipeCapacity),
+    m_slotSize(slotSize),
+    m_countSlots(countSlots),
+    m_slotTickets(countSlots, 0) {
+    // Ignore result since we don't know which process starts first
+    ::mkfifo(m_pipePath.c_str(), 0666);
+    // Anonymous mapping is page aligned, slot size is multiple of page size, so every slot starts at page boundary
+    NET_ASSERT(m_slotSize % ::sysconf(_SC_PAGESIZE) == 0);
+    void* slots = ::mmap(nullptr, m_slotSize * m_countSlots, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    checkErrors(slots, MAP_FAILED);
+    m_slots = static_cast<std::uint8_t*>(slots);
+}
+
+SplicePipe::~SplicePipe() {
+    close();
+    if(m_slots != nullptr) {
+        ::munmap(m_slots, m_slotSize * m_countSlots);
+    }
+    if(!m_pipePath.empty()) {
+        ::unlink(m_pipePath.c_str());
+    }
+}
+
+SplicePipe::SplicePipe(SplicePipe&& other) noexcept {
+    *this = std::move(other);
+}
+
+SplicePipe& SplicePipe::operator=(SplicePipe&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_pipePath, other.m_pipePath);
+        std::swap(m_pipeCapacity, other.m_pipeCapacity);
+        std::swap(m_fileDescriptor, other.m_fileDescriptor);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_slotSize, other.m_slotSize);
+        std::swap(m_countSlots, other.m_countSlots);
+        std::swap(m_nextSlot, other.m_nextSlot);
+        std::swap(m_slotTickets, other.m_slotTickets);
+        std::swap(m_countBytesWritten, other.m_countBytesWritten);
+    }
+    return *this;
+}
+
+void SplicePipe::open(int flags) {
+    if(m_fileDescriptor != -1) {
+        return;
+    }
+    m_fileDescriptor = ::open(m_pipePath.c_str(), flags);
+    NET_CHECK(m_fileDescriptor, -1);
+    // Default capacity is 16 pages, every gifted slot takes at least one of them.
+    // Capacity above /proc/sys/fs/pipe-max-size is refused for unprivileged process, then default is kept
+    ::fcntl(m_fileDescriptor, F_SETPIPE_SZ, static_cast<int>(m_pipeCapacity));
+    // New pipe, nothing is referenced by it anymore
+    m_countBytesWritten = 0;
+    std::fill(m_slotTickets.begin(), m_slotTickets.end(), 0);
+}
+
+void SplicePipe::close() {
+    if(m_fileDescriptor != -1) {
+        ::close(m_fileDescriptor);
+        m_fileDescriptor = -1;
+    }
+}
+
+std::uint64_t SplicePipe::countBytesConsumed() const {
+    int countBytesPending = 0;
+    const int result = ::ioctl(m_fileDescriptor, FIONREAD, &countBytesPending);
+    // Counting failed read as everything consumed would hand out slots which pipe still references, so it throws in every build
+    checkErrors(result, -1);
+    return m_countBytesWritten - static_cast<std::uint64_t>(countBytesPending);
+}
+
+std::span<std::uint8_t> SplicePipe::acquire() {
+    open(O_WRONLY);
+    while(countBytesConsumed() < m_slotTickets[m_nextSlot]) {
+        std::this_thread::yield();
+    }
+    return {m_slots + m_nextSlot * m_slotSize, m_slotSize};
+}
+
+void SplicePipe::gift(std::size_t countBytes) {
+    NET_ASSERT(countBytes <= m_slotSize);
+    iovec ioVector{m_slots + m_nextSlot * m_slotSize, countBytes};
+    while(ioVector.iov_len > 0) {
+        const ssize_t resultSplice = ::vmsplice(m_fileDescriptor, &ioVector, 1, SPLICE_F_GIFT);
+        if(resultSplice == -1 && errno == EPIPE) {
+            // Reader went away, pipe is gone with everything it referenced, wait for next reader and send whole slot again
+            close();
+            open(O_WRONLY);
+            ioVector = {m_slots + m_nextSlot * m_slotSize, countBytes};
+            continue;
+        }
+        if(resultSplice == -1 && errno == EINTR) {
+            continue;
+        }
+        // Skipping the error would gift the rest from wrong offset and ticket of slot would cover wrong bytes
+        checkErrors(resultSplice, -1L);
+        ioVector.iov_base = static_cast<std::uint8_t*>(ioVector.iov_base) + resultSplice;
+        ioVector.iov_len -= static_cast<std::size_t>(resultSplice);
+    }
+    m_countBytesWritten += countBytes;
+    m_slotTickets[m_nextSlot] = m_countBytesWritten;
+    m_nextSlot = (m_nextSlot + 1) % m_countSlots;
+}
+
+void SplicePipe::write(const std::uint8_t* data, std::size_t countBytes) {
+    std::size_t offset = 0;
+    while(offset < countBytes) {
+        std::span<std::uint8_t> slot = acquire();
+        const std::size_t countBytesToGift = std::min(slot.size(), countBytes - offset);
+        std::memcpy(slot.data(), data + offset, countBytesToGift);
+        gift(countBytesToGift);
+        offset += countBytesToGift;
+    }
+}
+
+void SplicePipe::write(const std::vector<std::uint8_t>& bufferToWrite) {
+    write(bufferToWrite.data(), bufferToWrite.size());
+}
+
+void SplicePipe::write(std::span<const std::vector<std::uint8_t>> buffersToWrite) {
+    for(const std::vector<std::uint8_t>& bufferToWrite : buffersToWrite) {
+        write(bufferToWrite);
+    }
+}
+
+void SplicePipe::write(std::span<Buffer* const> buffersToWrite) {
+    for(const Buffer* bufferToWrite : buffersToWrite) {
+        write(bufferToWrite->data.data(), bufferToWrite->countBytes);
+    }
+}
+
+void SplicePipe::read(Buffer& buffer) {
+    while(true) {
+        open(O_RDONLY);
+        const ssize_t readBytes = ::read(m_fileDescriptor, buffer.data.data(), buffer.data.size());
+        NET_CHECK(readBytes, -1L);
+        if(readBytes > 0) {
+            buffer.countBytes = readBytes;
+            return;
+        }
+        // Writer went away, wait for the next one
+        close();
+    }
+}
+
+std::size_t SplicePipe::read(std::span<Buffer*> buffers) {
+    NET_ASSERT(!buffers.empty());
+    read(*buffers.front());
+    return 1;
+}
+
+
+
+
+ConnectedSocket::ConnectedSocket(int socketType, const sockaddr_storage& address, socklen_t addressLength, SocketRole role)
+    : m_role(role),
+    m_socketType(socketType),
+    m_address(address),
+    m_addressLength(addressLength) {
+    if(m_role == SocketRole::Listen) {
+        m_listenFileDescriptor = ::socket(m_address.ss_family, m_socketType | SOCK_CLOEXEC, 0);
+        checkErrors(m_listenFileDescriptor, -1);
+        if(m_address.ss_family == AF_UNIX) {
+            // Socket file might be left by previous run
+            ::unlink(reinterpret_cast<const sockaddr_un*>(&m_address)->sun_path);
+        } else {
+            const int reuseAddress = 1;
+            ::setsockopt(m_listenFileDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+        }
+        checkErrors(::bind(m_listenFileDescriptor, reinterpret_cast<const sockaddr*>(&m_address), m_addressLength), -1);
+        checkErrors(::listen(m_listenFileDescriptor, 1), -1);
+    }
+}
+
+ConnectedSocket::~ConnectedSocket() {
+    disconnect();
+    if(m_listenFileDescriptor != -1) {
+        ::close(m_listenFileDescriptor);
+    }
+}
+
+ConnectedSocket::ConnectedSocket(ConnectedSocket&& other) noexcept {
+    *this = std::move(other);
+}
+
+ConnectedSocket& ConnectedSocket::operator=(ConnectedSocket&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_role, other.m_role);
+        std::swap(m_socketType, other.m_socketType);
+        std::swap(m_address, other.m_address);
+        std::swap(m_addressLength, other.m_addressLength);
+        std::swap(m_listenFileDescriptor, other.m_listenFileDescriptor);
+        std::swap(m_socketFileDescriptor, other.m_socketFileDescriptor);
+        std::swap(m_ioVectors, other.m_ioVectors);
+        std::swap(m_messageHeaders, other.m_messageHeaders);
+    }
+    return *this;
+}
+
+void ConnectedSocket::configure(int socketDescriptor) const {
+    if(m_address.ss_family == AF_INET) {
+        // Messages are small and latency matters more than count of segments
+        const int noDelay = 1;
+        ::setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+}
+
+void ConnectedSocket::ensureConnected() {
+    while(m_socketFileDescriptor == -1) {
+        if(m_role == SocketRole::Listen) {
+            m_socketFileDescriptor = ::accept4(m_listenFileDescriptor, nullptr, nullptr, SOCK_CLOEXEC);
+            NET_CHECK(m_socketFileDescriptor, -1);
+            configure(m_socketFileDescriptor);
+            continue;
+        }
+
+        const int socketDescriptor = ::socket(m_address.ss_family, m_socketType | SOCK_CLOEXEC, 0);
+        NET_CHECK(socketDescriptor, -1);
+        if(::connect(socketDescriptor, reinterpret_cast<const sockaddr*>(&m_address), m_addressLength) == 0) {
+            configure(socketDescriptor);
+            m_socketFileDescriptor = socketDescriptor;
+        } else {
+            // Reader is not running yet, same as blocking open of fifo
+            ::close(socketDescriptor);
+            std::this_thread::sleep_for(RECONNECT_INTERVAL);
+        }
+    }
+}
+
+void ConnectedSocket::disconnect() {
+    if(m_socketFileDescriptor != -1) {
+        ::close(m_socketFileDescriptor);
+        m_socketFileDescriptor = -1;
+    }
+}
+
+void ConnectedSocket::write(const std::vector<std::uint8_t>& bufferToWrite) {
+    write(std::span<const std::vector<std::uint8_t>>(&bufferToWrite, 1));
+}
+
+void ConnectedSocket::write(std::span<const std::vector<std::uint8_t>> buffersToWrite) {
+    // Reuse io vectors between calls, so steady state does not allocate
+    m_ioVectors.resize(buffersToWrite.size());
+    for(std::size_t i = 0; i < buffersToWrite.size(); ++i) {
+        m_ioVectors[i].iov_base = const_cast<std::uint8_t*>(buffersToWrite[i].data());
+        m_ioVectors[i].iov_len = buffersToWrite[i].size();
+    }
+    sendMessages();
+}
+
+void ConnectedSocket::write(std::span<Buffer* const> buffersToWrite) {
+    m_ioVectors.resize(buffersToWrite.size());
+    for(std::size_t i = 0; i < buffersToWrite.size(); ++i) {
+        m_ioVectors[i].iov_base = buffersToWrite[i]->data.data();
+        m_ioVectors[i].iov_len = buffersToWrite[i]->countBytes;
+    }
+    sendMessages();
+}
+
+void ConnectedSocket::sendMessages() {
+    m_messageHeaders.assign(m_ioVectors.size(), mmsghdr{});
+    for(std::size_t i = 0; i < m_ioVectors.size(); ++i) {
+        m_messageHeaders[i].msg_hdr.msg_iov = &m_ioVectors[i];
+        m_messageHeaders[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    std::size_t countSent = 0;
+    while(countSent < m_messageHeaders.size()) {
+        ensureConnected();
+        const int resultSend = ::sendmmsg(m_socketFileDescriptor, m_messageHeaders.data() + countSent, m_messageHeaders.size() - countSent, MSG_NOSIGNAL);
+        if(resultSend == -1 && isPeerGone(errno)) {
+            disconnect();
+            continue;
+        }
+        NET_CHECK(resultSend, -1);
+        countSent += std::max(resultSend, 0);
+    }
+}
+
+void ConnectedSocket::read(Buffer& buffer) {
+    Buffer* bufferPtr = &buffer;
+    read(std::span<Buffer*>(&bufferPtr, 1));
+}
+
+std::size_t ConnectedSocket::read(std::span<Buffer*> buffers) {
+    NET_ASSERT(!buffers.empty());
+    // Reuse headers between calls, so steady state does not allocate
+    m_ioVectors.resize(buffers.size());
+    m_messageHeaders.assign(buffers.size(), mmsghdr{});
+    for(std::size_t i = 0; i < buffers.size(); ++i) {
+        m_ioVectors[i].iov_base = buffers[i]->data.data();
+        m_ioVectors[i].iov_len = buffers[i]->data.size();
+        m_messageHeaders[i].msg_hdr.msg_iov = &m_ioVectors[i];
+        m_messageHeaders[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while(true) {
+        ensureConnected();
+        const int resultReceive = ::recvmmsg(m_socketFileDescriptor, m_messageHeaders.data(), m_messageHeaders.size(), MSG_WAITFORONE, nullptr);
+        if(resultReceive == -1 && isPeerGone(errno)) {
+            disconnect();
+            continue;
+        }
+        NET_CHECK(resultReceive, -1);
+
+        // Zero length message means writer closed connection, messages before it are still valid
+        std::size_t countReceived = 0;
+        while(countReceived < static_cast<std::size_t>(std::max(resultReceive, 0)) && m_messageHeaders[countReceived].msg_len > 0) {
+            NET_ASSERT((m_messageHeaders[countReceived].msg_hdr.msg_flags & MSG_TRUNC) == 0);
+            buffers[countReceived]->countBytes = m_messageHeaders[countReceived].msg_len;
+            ++countReceived;
+        }
+        if(countReceived < static_cast<std::size_t>(std::max(resultReceive, 0))) {
+            disconnect();
+        }
+        if(countReceived > 0) {
+            return countReceived;
+        }
+    }
+}
+
+UnixSeqPacketSocket::UnixSeqPacketSocket(std::string_view socketPath, SocketRole role)
+    : ConnectedSocket(SOCK_SEQPACKET, getUnixAddressStructHelper(socketPath), sizeof(sockaddr_un), role) {
+    if(role == SocketRole::Listen) {
+        m_socketPath = socketPath;
+    }
+}
+
+UnixSeqPacketSocket::~UnixSeqPacketSocket() {
+    // Only listening side owns socket file
+    if(!m_socketPath.empty()) {
+        ::unlink(m_socketPath.c_str());
+    }
+}
+
+void UnixSeqPacketSocket::sendDescriptor(int fileDescriptor) {
+    ensureConnected();
+    // At least one byte of data is required to carry ancillary data
+    std::uint8_t marker = 0;
+    iovec ioVector{&marker, sizeof(marker)};
+    alignas(cmsghdr) std::uint8_t control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &ioVector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+    controlMessage->cmsg_level = SOL_SOCKET;
+    controlMessage->cmsg_type = SCM_RIGHTS;
+    controlMessage->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(controlMessage), &fileDescriptor, sizeof(int));
+    checkErrors(::sendmsg(m_socketFileDescriptor, &message, MSG_NOSIGNAL), -1L);
+}
+
+int UnixSeqPacketSocket::receiveDescriptor() {
+    ensureConnected();
+    std::uint8_t marker = 0;
+    iovec ioVector{&marker, sizeof(marker)};
+    alignas(cmsghdr) std::uint8_t control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &ioVector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    checkErrors(::recvmsg(m_socketFileDescriptor, &message, MSG_CMSG_CLOEXEC), -1L);
+    const cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+    if(controlMessage == nullptr || controlMessage->cmsg_type != SCM_RIGHTS) {
+        throw std::runtime_error("Expected file descriptor from peer");
+    }
+    int fileDescriptor = -1;
+    std::memcpy(&fileDescriptor, CMSG_DATA(controlMessage), sizeof(int));
+    return fileDescriptor;
+}
+
+LoopbackTcpSocket::LoopbackTcpSocket(std::uint16_t port, SocketRole role)
+    : ConnectedSocket(SOCK_STREAM, getLoopbackAddressStructHelper(port), sizeof(sockaddr_in), role) {
+}
+
+
+
+
+namespace {
+
+constexpr std::uint32_t WRAP_MARKER = std::numeric_limits<std::uint32_t>::max();
+constexpr std::size_t RECORD_ALIGNMENT = 8;
+
+// Record is length followed by message, aligned so length never crosses end of ring
+std::size_t recordSize(std::size_t messageSize) {
+    return (sizeof(std::uint32_t) + messageSize + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+}
+
+} // namespace
+
+SharedMemoryQueue::SharedMemoryQueue(std::string_view name, std::size_t capacity, SocketRole role)
+    : m_name(name),
+    m_role(role),
+    m_capacity(capacity) {
+    NET_ASSERT(m_capacity != 0 && (m_capacity & (m_capacity - 1)) == 0);
+    // Whoever comes first creates zeroed object, size is the same for both sides
+    const int fileDescriptor = ::shm_open(m_name.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0666);
+    checkErrors(fileDescriptor, -1);
+    m_mappingSize = sizeof(Header) + m_capacity;
+    const int resultTruncate = ::ftruncate(fileDescriptor, static_cast<off_t>(m_mappingSize));
+    if(resultTruncate == -1) {
+        ::close(fileDescriptor);
+    }
+    checkErrors(resultTruncate, -1);
+    m_mapping = ::mmap(nullptr, m_mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fileDescriptor, 0);
+    ::close(fileDescriptor);
+    checkErrors(m_mapping, MAP_FAILED);
+
+    m_header = static_cast<Header*>(m_mapping);
+    m_data = static_cast<std::uint8_t*>(m_mapping) + sizeof(Header);
+    // Continue where previous run stopped, messages written while peer was away are not lost
+    m_writeIndex = std::atomic_ref<std::uint64_t>(m_header->writeIndex).load(std::memory_order_acquire);
+    m_readIndex = std::atomic_ref<std::uint64_t>(m_header->readIndex).load(std::memory_order_acquire);
+    m_cachedWriteIndex = m_writeIndex;
+    m_cachedReadIndex = m_readIndex;
+}
+
+SharedMemoryQueue::~SharedMemoryQueue() {
+    if(m_mapping != nullptr) {
+        ::munmap(m_mapping, m_mappingSize);
+    }
+    if(m_role == SocketRole::Listen && !m_name.empty()) {
+        ::shm_unlink(m_name.c_str());
+    }
+}
+
+SharedMemoryQueue::SharedMemoryQueue(SharedMemoryQueue&& other) noexcept {
+    *this = std::move(other);
+}
+
+SharedMemoryQueue& SharedMemoryQueue::operator=(SharedMemoryQueue&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_name, other.m_name);
+        std::swap(m_role, other.m_role);
+        std::swap(m_mapping, other.m_mapping);
+        std::swap(m_mappingSize, other.m_mappingSize);
+        std::swap(m_header, other.m_header);
+        std::swap(m_data, other.m_data);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_writeIndex, other.m_writeIndex);
+        std::swap(m_readIndex, other.m_readIndex);
+        std::swap(m_cachedWriteIndex, other.m_cachedWriteIndex);
+        std::swap(m_cachedReadIndex, other.m_cachedReadIndex);
+    }
+    return *this;
+}
+
+void SharedMemoryQueue::publish() {
+    std::atomic_ref<std::uint64_t>(m_header->writeIndex).store(m_writeIndex, std::memory_order_release);
+}
+
+void SharedMemoryQueue::writeRecord(const std::uint8_t* data, std::size_t countBytes) {
+    const std::size_t size = recordSize(countBytes);
+    NET_ASSERT(size <= m_capacity / 2);
+    while(true) {
+        const std::size_t position = m_writeIndex & (m_capacity - 1);
+        const std::size_t tailSize = m_capacity - position;
+        // Record never wraps, rest of the ring is skipped instead
+        const std::size_t requiredSize = tailSize < size ? tailSize + size : size;
+        if(m_writeIndex + requiredSize - m_cachedReadIndex > m_capacity) {
+            m_cachedReadIndex = std::atomic_ref<std::uint64_t>(m_header->readIndex).load(std::memory_order_acquire);
+            if(m_writeIndex + requiredSize - m_cachedReadIndex > m_capacity) {
+                // Reader can't see records which are not published yet
+                publish();
+                std::this_thread::yield();
+            }
+            continue;
+        }
+
+        if(tailSize < size) {
+            std::memcpy(m_data + position, &WRAP_MARKER, sizeof(WRAP_MARKER));
+            m_writeIndex += tailSize;
+            continue;
+        }
+
+        const std::uint32_t length = static_cast<std::uint32_t>(countBytes);
+        std::memcpy(m_data + position, &length, sizeof(length));
+        std::memcpy(m_data + position + sizeof(length), data, countBytes);
+        m_writeIndex += size;
+        return;
+    }
+}
+
+void SharedMemoryQueue::write(const std::vector<std::uint8_t>& bufferToWrite) {
+    writeRecord(bufferToWrite.data(), bufferToWrite.size());
+    publish();
+}
+
+void SharedMemoryQueue::write(std::span<const std::vector<std::uint8_t>> buffersToWrite) {
+    for(const std::vector<std::uint8_t>& bufferToWrite : buffersToWrite) {
+        writeRecord(bufferToWrite.data(), bufferToWrite.size());
+    }
+    publish();
+}
+
+void SharedMemoryQueue::write(std::span<Buffer* const> buffersToWrite) {
+    for(const Buffer* bufferToWrite : buffersToWrite) {
+        writeRecord(bufferToWrite->data.data(), bufferToWrite->countBytes);
+    }
+    publish();
+}
+
+void SharedMemoryQueue::read(Buffer& buffer) {
+    Buffer* bufferPtr = &buffer;
+    read(std::span<Buffer*>(&bufferPtr, 1));
+}
+
+std::size_t SharedMemoryQueue::read(std::span<Buffer*> buffers) {
+    NET_ASSERT(!buffers.empty());
+    std::size_t countRead = 0;
+    // Writer might publish only wrap marker while it waits for free space, so loop until there is a message
+    while(countRead == 0) {
+        while(m_cachedWriteIndex == m_readIndex) {
+            m_cachedWriteIndex = std::atomic_ref<std::uint64_t>(m_header->writeIndex).load(std::memory_order_acquire);
+            if(m_cachedWriteIndex == m_readIndex) {
+                std::this_thread::yield();
+            }
+        }
+
+        while(countRead < buffers.size() && m_readIndex != m_cachedWriteIndex) {
+            const std::size_t position = m_readIndex & (m_capacity - 1);
+            std::uint32_t length = 0;
+            std::memcpy(&length, m_data + position, sizeof(length));
+            if(length == WRAP_MARKER) {
+                m_readIndex += m_capacity - position;
+                continue;
+            }
+
+            Buffer& buffer = *buffers[countRead];
+            NET_ASSERT(length <= buffer.data.size());
+            buffer.countBytes = std::min<std::size_t>(length, buffer.data.size());
+            std::memcpy(buffer.data.data(), m_data + position + sizeof(length), buffer.countBytes);
+            m_readIndex += recordSize(length);
+            ++countRead;
+        }
+        std::atomic_ref<std::uint64_t>(m_header->readIndex).store(m_readIndex, std::memory_order_release);
+    }
+    return countRead;
+}
+
+
+
+TcpProfile tcpProfileFromString(std::string_view name) {
+    if(name == "kernel") {
+        return TcpProfile::Kernel;
+    }
+    if(name == "nodelay") {
+        return TcpProfile::NoDelay;
+    }
+    if(name == "latency") {
+        return TcpProfile::Latency;
+    }
+    if(name == "throughput") {
+        return TcpProfile::Throughput;
+    }
+    throw std::invalid_argument("Unknown tcp profile: " + std::string(name));
+}
+
+TransportType transportTypeFromString(std::string_view name) {
+    if(name == "fifo") {
+        return TransportType::Fifo;
+    }
+    if(name == "fifo-splice") {
+        return TransportType::FifoSplice;
+    }
+    if(name == "unix") {
+        return TransportType::UnixSocket;
+    }
+    if(name == "shm") {
+        return TransportType::SharedMemory;
+    }
+    if(name == "tcp") {
+        return TransportType::LoopbackTcp;
+    }
+    throw std::invalid_argument("Unknown transport: " + std::string(name));
+}
+
+CommandLineOptions::CommandLineOptions(int argc, char* argv[]) {
+    for(int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if(!argument.starts_with("--")) {
+            m_positional.push_back(argument);
+            continue;
+        }
+        if(i + 1 == argc) {
+            throw std::invalid_argument("Missing value for option " + std::string(argument));
+        }
+        m_options[argument.substr(2)] = argv[++i];
+    }
+}
+
+std::string_view CommandLineOptions::get(std::string_view name, std::string_view defaultValue) const {
+    const auto iterator = m_options.find(name);
+    return iterator != m_options.end() ? iterator->second : defaultValue;
+}
+
+bool CommandLineOptions::containsOnly(std::initializer_list<std::string_view> knownNames) const {
+    for(const auto& [name, value] : m_options) {
+        if(std::find(knownNames.begin(), knownNames.end(), name) == knownNames.end()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace Common
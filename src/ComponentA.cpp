@@ -1,53 +1,293 @@
+#include <algorithm>
 #include <cassert>
 #include <csignal>
 #include <iostream>
+#include <optional>
 #include <thread>
 #include <vector>
 
 #include "Settings.h"
 #include "Common.h"
+#include "Backpressure.h"
+#include "Batching.h"
 #include "EntriesProcessing.h"
+#include "FilterWorkers.h"
+#include "PacketMmapReader.h"
+#include "Transport.h"
+#include "XdpReader.h"
 
-void readerOfEntries(std::shared_ptr<Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr, std::uint16_t port) {
+// Batch of 1 reads every datagram as soon as it arrives, bigger batches read bursts with single recvmmsg when queue builds up
+void readerOfEntries(std::shared_ptr<Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr, std::uint16_t port, std::size_t maxBatchSize) {
     using namespace Common;
     try {
-        NetworkReaderWriter<ProtocolType::UDP> readerUdp(port);
+        BatchedUdpReader readerUdp(port, maxBatchSize);
+        BatchController batchController(1, maxBatchSize);
+        std::uint64_t countTruncated = 0;
         while (true) {
-            Buffer &entries = threadSafeQueueBufferPtr->dequeueReadyToUse();
-            entries.countBytes = readerUdp.read(entries.data);
-            NET_ASSERT(entries.countBytes <= entries.data.size());
-            threadSafeQueueBufferPtr->enqueueInProcess(&entries);
+            readerUdp.read(*threadSafeQueueBufferPtr, batchController.next(threadSafeQueueBufferPtr->countInProcess()));
+            if(readerUdp.countTruncated() != countTruncated) {
+                countTruncated = readerUdp.countTruncated();
+                std::cerr << "Datagrams truncated in bursts: " << countTruncated << std::endl;
+            }
         }
     } catch (std::exception& e) {
         std::cerr << "Error from readerOfEntries: " << e.what() << std::endl;
     }
 }
 
-void writerToComponentB(std::shared_ptr<Common::ThreadSafeQueueBuffer>& threadSafeQueueBufferPtr, std::string_view pipePath) {
+template<Common::LinkWriter Transport>
+void writerToComponentB(std::shared_ptr<Common::ThreadSafeQueueBuffer>& threadSafeQueueBufferPtr, Transport& transport, Common::BatchController& batchController) {
     using namespace Common;
-    NamedPipe namedPipe(pipePath);
-    std::vector<std::uint8_t> pricesToSend;
-    pricesToSend.reserve(Settings::MAX_UDP_BUF);
+    // One message per received datagram, transports with message boundaries send whole batch with single syscall
+    std::vector<Buffer*> entriesBatch(batchController.maxBatchSize());
+    std::vector<Buffer*> pricesToSend;
+    pricesToSend.reserve(batchController.maxBatchSize());
+    // Grows only for datagrams with unusually many records, then keeps its capacity
+    std::vector<std::size_t> recordEnds;
+    recordEnds.reserve(Settings::RECORDS_PER_DATAGRAM_HINT);
     while(true) {
-        Buffer& entries = threadSafeQueueBufferPtr->dequeueInProcess();
-
-        // Filter entries and remove unnecessary data (volume)
-        // obviously sending less data will help with efficiency of system
-        // make sure we do not allocate
-        NET_ASSERT(entries.countBytes <= pricesToSend.capacity());
-        NET_ASSERT(entries.data.size() >= entries.countBytes);
-        // Validate input data and filter prices, if not valid skip
-        // any deviation from pattern price volume EOF will be skipped
-        if(Processing::filterEntries(entries, pricesToSend, Settings::EOF_MARKER)) {
-            // Writes entries from udp to pipe between A and B
-            NET_ASSERT(!pricesToSend.empty());
-            namedPipe.write(pricesToSend);
-        }
-
-        threadSafeQueueBufferPtr->enqueueUsed(&entries);
+        if constexpr(requires { transport.flush(); }) {
+            // Messages waiting for credits go out as soon as ComponentB grants them, even when nothing new arrives
+            Backoff backoff;
+            while(threadSafeQueueBufferPtr->countInProcess() == 0 && transport.flush()) {
+                backoff.wait();
+            }
+        }
+        // Wait for one buffer and take the rest which are already received, up to batch picked by depth of the queue
+        const std::span<Buffer*> entriesAllowed = std::span<Buffer*>(entriesBatch).first(batchController.next(threadSafeQueueBufferPtr->countInProcess()));
+        const std::span<Buffer*> entriesReceived = entriesAllowed.first(threadSafeQueueBufferPtr->dequeueInProcess(entriesAllowed));
+
+        pricesToSend.clear();
+        for(Buffer* entries : entriesReceived) {
+            // Filter entries and remove unnecessary data (volume)
+            // obviously sending less data will help with efficiency of system
+            // prices are compacted in place, so buffer goes to transport without copying
+            NET_ASSERT(entries->data.size() >= entries->countBytes);
+            // Validate input data and filter prices, if not valid skip
+            // any deviation from pattern price volume EOF will be skipped
+            // datagram might carry several records, prices of all of them go in one message
+            if(Processing::filterRecords(*entries, recordEnds, Settings::EOF_MARKER) > 0 && entries->countBytes > 0) {
+                pricesToSend.push_back(entries);
+            }
+        }
+
+        // Writes entries from udp to transport between A and B
+        if(!pricesToSend.empty()) {
+            transport.write(std::span<Buffer* const>(pricesToSend));
+        }
+
+        threadSafeQueueBufferPtr->enqueueUsed(entriesReceived);
+    }
+}
+
+/* Same as above, but records are filtered by worker threads: this thread only dispatches received buffers
+ * and writes filtered ones in the order they were received
+ * */
+template<Common::LinkWriter Transport>
+void parallelWriterToComponentB(std::shared_ptr<Common::ThreadSafeQueueBuffer>& threadSafeQueueBufferPtr, Processing::FilterWorkers& filterWorkers, Transport& transport) {
+    using namespace Common;
+    std::vector<Buffer*> entriesReceived(Settings::TRANSPORT_MAX_BATCH);
+    std::vector<Buffer*> entriesBatch;
+    entriesBatch.reserve(Settings::TRANSPORT_MAX_BATCH);
+    std::vector<Buffer*> pricesToSend;
+    pricesToSend.reserve(Settings::TRANSPORT_MAX_BATCH);
+    // Nothing to block on here (input queue and workers both), so idle writer backs off into sleep
+    Backoff backoff;
+    while(true) {
+        bool isIdle = true;
+        while(threadSafeQueueBufferPtr->countInProcess() > 0) {
+            const std::size_t countReceived = threadSafeQueueBufferPtr->dequeueInProcess(entriesReceived);
+            for(std::size_t index = 0; index < countReceived; ++index) {
+                filterWorkers.submit(entriesReceived[index]);
+            }
+            isIdle = false;
+        }
+
+        entriesBatch.clear();
+        pricesToSend.clear();
+        while(entriesBatch.size() < Settings::TRANSPORT_MAX_BATCH) {
+            Buffer* entries = filterWorkers.tryTake();
+            if(entries == nullptr) {
+                break;
+            }
+            entriesBatch.push_back(entries);
+            // Prices are compacted in place by worker, invalid datagram comes back empty
+            if(entries->countBytes > 0) {
+                pricesToSend.push_back(entries);
+            }
+        }
+
+        if(!pricesToSend.empty()) {
+            transport.write(std::span<Buffer* const>(pricesToSend));
+        }
+        threadSafeQueueBufferPtr->enqueueUsed(entriesBatch);
+
+        if(isIdle && entriesBatch.empty()) {
+            if constexpr(requires { transport.flush(); }) {
+                // Messages waiting for credits go out as soon as ComponentB grants them, even when nothing new arrives
+                transport.flush();
+            }
+            backoff.wait();
+        } else {
+            backoff.reset();
+        }
+    }
+}
+
+// Zero copy fifo: prices are filtered straight into the slot which is gifted to the pipe, so they are never copied into the pipe
+void writerToComponentB(std::shared_ptr<Common::ThreadSafeQueueBuffer>& threadSafeQueueBufferPtr, Common::SplicePipe& splicePipe, Common::BatchController& batchController) {
+    using namespace Common;
+    std::vector<std::size_t> recordEnds;
+    recordEnds.reserve(Settings::RECORDS_PER_DATAGRAM_HINT);
+    std::vector<Buffer*> entriesBatch(batchController.maxBatchSize());
+    while(true) {
+        const std::span<Buffer*> entriesAllowed = std::span<Buffer*>(entriesBatch).first(batchController.next(threadSafeQueueBufferPtr->countInProcess()));
+        const std::span<Buffer*> entriesReceived = entriesAllowed.first(threadSafeQueueBufferPtr->dequeueInProcess(entriesAllowed));
+        for(Buffer* entries : entriesReceived) {
+            std::span<std::uint8_t> slot = splicePipe.acquire();
+            NET_ASSERT((entries->countBytes + 1) / 2 <= slot.size());
+            std::size_t countPrices = 0;
+            if(Processing::filterRecords(entries->data.data(), entries->countBytes, slot.data(), countPrices, recordEnds, Settings::EOF_MARKER) > 0 && countPrices > 0) {
+                splicePipe.gift(countPrices);
+            }
+        }
+        // Pipe references only the slots, so entries buffers are free to be reused right away
+        threadSafeQueueBufferPtr->enqueueUsed(entriesReceived);
+    }
+}
+
+/* Run to completion: single thread receives, filters and writes to transport, so datagram stays in cache of one core
+ * and there is no queue between reading and writing
+ * */
+template<Common::LinkWriter Transport>
+void runToCompletionToComponentB(std::uint16_t port, Transport& transport) {
+    using namespace Common;
+    NetworkReaderWriter<ProtocolType::UDP> readerUdp(port);
+    // Any datagram fits, size classes are not needed for a single buffer
+    Buffer entries{std::vector<std::uint8_t>(Settings::MAX_UDP_BUF)};
+    Buffer* const entriesPtr = &entries;
+    std::vector<std::size_t> recordEnds;
+    recordEnds.reserve(Settings::RECORDS_PER_DATAGRAM_HINT);
+    while(true) {
+        if constexpr(requires { transport.flush(); }) {
+            // Socket is polled while messages wait for credits
+            if(transport.flush() && !readerUdp.waitReadable(1)) {
+                continue;
+            }
+        }
+        const std::int64_t readBytes = readerUdp.read(entries.data);
+        NET_CHECK(readBytes, -1L);
+        if(readBytes <= 0) {
+            continue;
+        }
+        entries.countBytes = static_cast<std::size_t>(readBytes);
+        if(Processing::filterRecords(entries, recordEnds, Settings::EOF_MARKER) > 0 && entries.countBytes > 0) {
+            transport.write(std::span<Buffer* const>(&entriesPtr, 1));
+        }
     }
 }
 
+// Zero copy fifo in run to completion: prices are filtered from the datagram straight into the gifted slot
+void runToCompletionToComponentB(std::uint16_t port, Common::SplicePipe& splicePipe) {
+    using namespace Common;
+    NetworkReaderWriter<ProtocolType::UDP> readerUdp(port);
+    std::vector<std::uint8_t> entries(Settings::MAX_UDP_BUF);
+    std::vector<std::size_t> recordEnds;
+    recordEnds.reserve(Settings::RECORDS_PER_DATAGRAM_HINT);
+    while(true) {
+        const std::int64_t readBytes = readerUdp.read(entries);
+        NET_CHECK(readBytes, -1L);
+        if(readBytes <= 0) {
+            continue;
+        }
+        std::span<std::uint8_t> slot = splicePipe.acquire();
+        NET_ASSERT(static_cast<std::size_t>(readBytes) / 2 <= slot.size());
+        std::size_t countPrices = 0;
+        if(Processing::filterRecords(entries.data(), static_cast<std::size_t>(readBytes), slot.data(), countPrices, recordEnds, Settings::EOF_MARKER) > 0 && countPrices > 0) {
+            splicePipe.gift(countPrices);
+        }
+    }
+}
+
+// Receives datagrams from PACKET_MMAP or AF_XDP ring and filters them in place, payload is never copied into a Buffer
+template<typename RingReader, Common::LinkWriter Transport>
+void ringReaderToComponentB(RingReader& readerRing, Transport& transport) {
+    using namespace Common;
+    Buffer pricesToSend{std::vector<std::uint8_t>(Settings::MAX_PRICES_MESSAGE_SIZE)};
+    Buffer* const pricesToSendPtr = &pricesToSend;
+    std::vector<std::size_t> recordEnds;
+    recordEnds.reserve(Settings::RECORDS_PER_DATAGRAM_HINT);
+    while(true) {
+        int timeoutMilliseconds = -1;
+        if constexpr(requires { transport.flush(); }) {
+            // Ring is polled while messages wait for credits
+            timeoutMilliseconds = transport.flush() ? 1 : -1;
+        }
+        readerRing.readBatch([&transport, &pricesToSend, pricesToSendPtr, &recordEnds](const std::uint8_t* entries, std::size_t countBytes) {
+            NET_ASSERT(countBytes / 2 <= pricesToSend.data.size());
+            if(Processing::filterRecords(entries, countBytes, pricesToSend.data.data(), pricesToSend.countBytes, recordEnds, Settings::EOF_MARKER) > 0 && pricesToSend.countBytes > 0) {
+                transport.write(std::span<Buffer* const>(&pricesToSendPtr, 1));
+            }
+        }, timeoutMilliseconds);
+    }
+}
+
+// Prints counters of credit policy once per second if they changed
+void reporterOfCredits(std::shared_ptr<const Common::CreditCounters> countersPtr) {
+    std::uint64_t countReported = 0;
+    while(true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const std::uint64_t countSent = countersPtr->countSent.load(std::memory_order_relaxed);
+        const std::uint64_t countDroppedNewest = countersPtr->countDroppedNewest.load(std::memory_order_relaxed);
+        const std::uint64_t countDroppedOldest = countersPtr->countDroppedOldest.load(std::memory_order_relaxed);
+        const std::uint64_t countConflated = countersPtr->countConflated.load(std::memory_order_relaxed);
+        const std::uint64_t countTotal = countSent + countDroppedNewest + countDroppedOldest + countConflated;
+        if(countTotal != countReported) {
+            countReported = countTotal;
+            std::cout << "Credits: sent " << countSent << " dropped newest " << countDroppedNewest
+                << " dropped oldest " << countDroppedOldest << " conflated " << countConflated << std::endl;
+        }
+    }
+}
+
+// Prints overflow counters of buffer pool once per second if they changed
+void reporterOfOverflows(std::shared_ptr<const Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr) {
+    const Common::OverflowCounters& counters = threadSafeQueueBufferPtr->counters();
+    std::uint64_t countReported = 0;
+    while(true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const std::uint64_t countBlocked = counters.countBlocked.load(std::memory_order_relaxed);
+        const std::uint64_t countDroppedOldest = counters.countDroppedOldest.load(std::memory_order_relaxed);
+        const std::uint64_t countDroppedNewest = counters.countDroppedNewest.load(std::memory_order_relaxed);
+        const std::uint64_t countTotal = countBlocked + countDroppedOldest + countDroppedNewest;
+        if(countTotal != countReported) {
+            countReported = countTotal;
+            std::cout << "Buffers exhausted: blocked " << countBlocked << " dropped oldest " << countDroppedOldest
+                << " dropped newest " << countDroppedNewest << std::endl;
+        }
+    }
+}
+
+/* Runs component loop with transport of A -> B link, wrapped into credited writer if credit policy is set.
+ * Without policy ComponentA blocks inside transport write when ComponentB falls behind
+ * */
+template<typename Run>
+void withComponentBLink(Common::TransportType transportType, std::optional<Common::CreditPolicy> creditPolicy, Run&& run) {
+    using namespace Common;
+    Transport::withTransport(transportType, SocketRole::Connect, [creditPolicy, &run](auto& transport) {
+        if(!creditPolicy) {
+            run(transport);
+            return;
+        }
+        CreditWindow creditWindow(Settings::CREDITS_SHARED_MEMORY_NAME, Settings::CREDIT_WINDOW_BYTES, SocketRole::Connect);
+        std::shared_ptr<CreditCounters> countersPtr = std::make_shared<CreditCounters>();
+        std::thread reporterThread(reporterOfCredits, countersPtr);
+        reporterThread.detach();
+        CreditedWriter creditedWriter(transport, creditWindow, *creditPolicy, Settings::CREDIT_BACKLOG_SIZE, Settings::MAX_UDP_BUF, *countersPtr);
+        run(creditedWriter);
+    });
+}
+
 void terminationSignalHandler(int signal) {
     ::unlink(Settings::PIPE_PATH);
     std::exit(signal);
@@ -55,29 +295,119 @@ void terminationSignalHandler(int signal) {
 
 int main(int argc, char *argv[]) {
     using namespace Common;
-    if(argc != 2) {
-        std::cerr << "Wrong arguments, usage: ./ComponentA [port] " << std::endl;
-        return -1;
-    }
+    constexpr std::string_view usage = "usage: ./ComponentA [port] [--ingest socket|packet-mmap|xdp] [--interface name, or empty for lo] [--transport fifo|fifo-splice|unix|shm|tcp] [--credit-policy drop-newest|drop-oldest|conflate] [--overflow-policy block|drop-oldest|drop-newest] [--layout two-thread|run-to-completion] [--filter-workers count] [--batching fixed|adaptive]";
 
     std::signal(SIGINT, terminationSignalHandler);
+    // Broken pipe is reported by errno, transports reconnect on it
+    std::signal(SIGPIPE, SIG_IGN);
 
     try {
-        std::int32_t port = std::stoi(argv[1]);
+        const CommandLineOptions options(argc, argv);
+        if(options.countPositional() != 1 || !options.containsOnly({"ingest", "interface", "transport", "credit-policy", "overflow-policy", "layout", "filter-workers", "batching"})) {
+            std::cerr << "Wrong arguments, " << usage << std::endl;
+            return -1;
+        }
+
+        std::int32_t port = std::stoi(std::string(options.positional(0)));
         if(port > std::numeric_limits<std::uint16_t>::max() || port < 0) {
             std::cerr << "Wrong port number" << std::endl;
             return -1;
         }
 
-        std::shared_ptr<ThreadSafeQueueBuffer> threadSafeQueueBufferPtr = std::make_shared<ThreadSafeQueueBuffer>(PIPE_BUF, Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS);
+        const std::string_view ingestBackend = options.get("ingest", "socket");
+        if(ingestBackend != "socket" && ingestBackend != "packet-mmap" && ingestBackend != "xdp") {
+            std::cerr << "Wrong ingest backend, " << usage << std::endl;
+            return -1;
+        }
+        const std::string_view interfaceName = options.get("interface", Settings::DEFAULT_INTERFACE);
+        // Ring ingest always runs to completion, layout selects threads of socket ingest only
+        const std::string_view layout = options.get("layout", "two-thread");
+        if(layout != "two-thread" && layout != "run-to-completion") {
+            std::cerr << "Wrong layout, " << usage << std::endl;
+            return -1;
+        }
+        // Filter workers apply to two thread layout of socket ingest only, 0 filters on the writer thread
+        const std::int32_t countFilterWorkers = std::stoi(std::string(options.get("filter-workers", "0")));
+        if(countFilterWorkers < 0 || countFilterWorkers > Settings::MAX_FILTER_WORKERS) {
+            std::cerr << "Wrong count of filter workers, " << usage << std::endl;
+            return -1;
+        }
+        // Batching applies to two thread layout of socket ingest, fixed reads datagrams one by one and writes up to TRANSPORT_MAX_BATCH at once.
+        // Adaptive bursts take buffers of the biggest size class only, so it is opt-in
+        const std::string_view batching = options.get("batching", "fixed");
+        if(batching != "adaptive" && batching != "fixed") {
+            std::cerr << "Wrong batching, " << usage << std::endl;
+            return -1;
+        }
+        const bool isAdaptiveBatching = batching == "adaptive";
+        const TransportType transportType = transportTypeFromString(options.get("transport", "fifo"));
+        std::optional<CreditPolicy> creditPolicy;
+        if(const std::string_view creditPolicyName = options.get("credit-policy", ""); !creditPolicyName.empty()) {
+            creditPolicy = creditPolicyFromString(creditPolicyName);
+        }
+
+        if(ingestBackend == "packet-mmap") {
+            PacketMmapReader readerRing(interfaceName, port, Settings::PACKET_MMAP_BLOCK_SIZE, Settings::PACKET_MMAP_COUNT_BLOCKS, Settings::PACKET_MMAP_BLOCK_TIMEOUT_MILLISECONDS);
+            withComponentBLink(transportType, creditPolicy, [&readerRing](auto& transport) {
+                ringReaderToComponentB(readerRing, transport);
+            });
+            return 0;
+        }
+
+        if(ingestBackend == "xdp") {
+            std::unique_ptr<XdpReader> readerXdpPtr;
+            try {
+                readerXdpPtr = std::make_unique<XdpReader>(interfaceName, port, Settings::XDP_QUEUE_ID, Settings::XDP_COUNT_FRAMES, Settings::XDP_FRAME_SIZE);
+            } catch (std::exception& e) {
+                std::cerr << "AF_XDP is not available (" << e.what() << "), falling back to socket" << std::endl;
+            }
+            if(readerXdpPtr) {
+                withComponentBLink(transportType, creditPolicy, [&readerXdpPtr](auto& transport) {
+                    ringReaderToComponentB(*readerXdpPtr, transport);
+                });
+                return 0;
+            }
+        }
+
+        if(layout == "run-to-completion") {
+            withComponentBLink(transportType, creditPolicy, [port](auto& transport) {
+                runToCompletionToComponentB(port, transport);
+            });
+            return 0;
+        }
 
-        std::thread readerThread(readerOfEntries, threadSafeQueueBufferPtr, port);
+        // Overflow policy applies to socket ingest only, ring readers have no buffer pool
+        const std::string_view overflowPolicyName = options.get("overflow-policy", "");
+        const OverflowPolicy overflowPolicy = overflowPolicyName.empty() ? OverflowPolicy::Block : overflowPolicyFromString(overflowPolicyName);
+        std::shared_ptr<ThreadSafeQueueBuffer> threadSafeQueueBufferPtr = std::make_shared<ThreadSafeQueueBuffer>(std::vector<SizeClass>{
+            {Settings::INGEST_SMALL_BUFFER_SIZE, Settings::INGEST_SMALL_COUNT_BUFFERS},
+            {Settings::INGEST_MEDIUM_BUFFER_SIZE, Settings::INGEST_MEDIUM_COUNT_BUFFERS},
+            {Settings::INGEST_LARGE_BUFFER_SIZE, Settings::INGEST_LARGE_COUNT_BUFFERS}
+        }, overflowPolicy);
+        if(!overflowPolicyName.empty()) {
+            std::thread reporterThread(reporterOfOverflows, threadSafeQueueBufferPtr);
+            reporterThread.detach();
+        }
+
+        std::thread readerThread(readerOfEntries, threadSafeQueueBufferPtr, port, isAdaptiveBatching ? Settings::ADAPTIVE_MAX_READ_BATCH_SIZE : 1);
         readerThread.detach();
 
-        writerToComponentB(threadSafeQueueBufferPtr, Settings::PIPE_PATH);
+        if(countFilterWorkers > 0) {
+            // Every buffer of the pool might be in flight between dispatch and write
+            Processing::FilterWorkers filterWorkers(countFilterWorkers, threadSafeQueueBufferPtr->capacityToUse(), Settings::EOF_MARKER);
+            withComponentBLink(transportType, creditPolicy, [&threadSafeQueueBufferPtr, &filterWorkers](auto& transport) {
+                parallelWriterToComponentB(threadSafeQueueBufferPtr, filterWorkers, transport);
+            });
+            return 0;
+        }
+
+        BatchController batchController = isAdaptiveBatching ? BatchController(1, Settings::ADAPTIVE_MAX_BATCH_SIZE) : BatchController(Settings::TRANSPORT_MAX_BATCH, Settings::TRANSPORT_MAX_BATCH);
+        withComponentBLink(transportType, creditPolicy, [&threadSafeQueueBufferPtr, &batchController](auto& transport) {
+            writerToComponentB(threadSafeQueueBufferPtr, transport, batchController);
+        });
     } catch (std::exception& e) {
         std::cerr << "Error from writerToComponentB: " << e.what() << std::endl;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,3 +1,4 @@
+#include <array>
 #include <cassert>
 #include <csignal>
 #include <iostream>
@@ -5,18 +6,35 @@
 #include <thread>
 #include <vector>
 
+#include <poll.h>
+#include <sys/mman.h>
+
 #include "Settings.h"
 #include "Common.h"
+#include "Backpressure.h"
+#include "FlushWindow.h"
 #include "EntriesProcessing.h"
+#include "Pipeline.h"
+#include "Transport.h"
 
-void readerFromComponentA(std::shared_ptr<Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr, std::string_view pipePath) {
+template<Common::LinkReader Transport>
+void readerFromComponentA(std::shared_ptr<Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr, Transport& transport) {
     using namespace Common;
     try {
-        NamedPipe readerPipe(pipePath);
+        // Buffers not filled by previous batch read stay here, this thread is not allowed to return them to queue of ready to use
+        std::vector<Buffer*> buffers;
+        buffers.reserve(Settings::TRANSPORT_MAX_BATCH);
         while (true) {
-            Buffer &buffer = threadSafeQueueBufferPtr->dequeueReadyToUse();
-            readerPipe.read(buffer);
-            threadSafeQueueBufferPtr->enqueueInProcess(&buffer);
+            if(buffers.empty()) {
+                buffers.push_back(&threadSafeQueueBufferPtr->dequeueReadyToUse());
+            }
+            while(buffers.size() < Settings::TRANSPORT_MAX_BATCH && threadSafeQueueBufferPtr->countToUse() > 0) {
+                buffers.push_back(&threadSafeQueueBufferPtr->dequeueReadyToUse());
+            }
+
+            const std::size_t countRead = transport.read(std::span<Buffer*>(buffers));
+            threadSafeQueueBufferPtr->enqueueInProcess(std::span<Buffer* const>(buffers).first(countRead));
+            buffers.erase(buffers.begin(), buffers.begin() + static_cast<std::ptrdiff_t>(countRead));
         }
     } catch (std::exception& e) {
         std::cerr << "Error from readerFromComponentA: " << e.what() << std::endl;
@@ -41,6 +59,12 @@ void tryReconnectWhileRefused(std::shared_ptr<Common::NetworkReaderWriter<Common
     }
 }
 
+void printReply(const std::vector<std::uint8_t>& buffer, std::int64_t readBytes) {
+    for (std::int64_t index = 0; index < readBytes; ++index) {
+        std::cout << buffer[index];
+    }
+}
+
 void readerFromExternalServer(std::shared_ptr<Common::NetworkReaderWriter<Common::ProtocolType::TCP>> readerWriterTcpPtr, std::uint16_t port, std::string_view ipv4Address) {
     using namespace Common;
     try {
@@ -48,9 +72,7 @@ void readerFromExternalServer(std::shared_ptr<Common::NetworkReaderWriter<Common
         while(true) {
             std::int64_t readBytes = readerWriterTcpPtr->read(buffer);
             if(readBytes > 0) {
-                for (std::size_t index = 0; index < readBytes; ++index) {
-                    std::cout << buffer[index];
-                }
+                printReply(buffer, readBytes);
             } else {
                 tryReconnectWhileRefused(readerWriterTcpPtr, port, ipv4Address, std::chrono::milliseconds (Settings::RECONNECT_RETRY_INTERVAL_MILLISECONDS));
             }
@@ -60,67 +82,259 @@ void readerFromExternalServer(std::shared_ptr<Common::NetworkReaderWriter<Common
     }
 }
 
-void writerToExternalServer(std::shared_ptr<Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr, std::uint16_t port, std::string_view ipv4Address) {
+// Prints replies which are already there without waiting for more, reconnects if server closed connection
+void drainRepliesFromExternalServer(std::shared_ptr<Common::NetworkReaderWriter<Common::ProtocolType::TCP>>& readerWriterTcpPtr, std::vector<std::uint8_t>& buffer, std::uint16_t port, std::string_view ipv4Address) {
+    while(true) {
+        const std::int64_t readBytes = readerWriterTcpPtr->tryRead(buffer);
+        if(readBytes > 0) {
+            printReply(buffer, readBytes);
+        } else if(readBytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            tryReconnectWhileRefused(readerWriterTcpPtr, port, ipv4Address, std::chrono::milliseconds (Settings::RECONNECT_RETRY_INTERVAL_MILLISECONDS));
+            return;
+        }
+    }
+}
+
+// Writes messages collected by flush window with single write, reconnects if server closed connection
+void flushToExternalServer(std::shared_ptr<Common::NetworkReaderWriter<Common::ProtocolType::TCP>>& readerWriterTcpPtr, Common::FlushWindow& flushWindow, Common::FlushReason reason, std::uint16_t port, std::string_view ipv4Address) {
+    while(readerWriterTcpPtr->write(flushWindow.pending()) == -1) {
+        tryReconnectWhileRefused(readerWriterTcpPtr, port, ipv4Address, std::chrono::milliseconds (Settings::RECONNECT_RETRY_INTERVAL_MILLISECONDS));
+    }
+    if(reason == Common::FlushReason::Deadline) {
+        // Corked socket holds partial segment until it is pushed
+        readerWriterTcpPtr->push();
+    }
+    flushWindow.flushed(reason);
+}
+
+// Expired messages leave once socket is writable: with latency profile only while little is unsent,
+// until then they keep collecting in window instead of queueing in kernel
+bool isReadyToFlush(std::shared_ptr<Common::NetworkReaderWriter<Common::ProtocolType::TCP>>& readerWriterTcpPtr, const Common::FlushWindow& flushWindow) {
+    return flushWindow.isExpired(Common::FlushWindow::Clock::now()) && readerWriterTcpPtr->waitWritable(0);
+}
+
+// According to the task we should send single message (eg. 88 88 88 88 88) to external server for every good price
+constexpr auto PRICES_TO_MESSAGES = Processing::pipeline(Processing::priceStream,
+                                                         Processing::threshold<Settings::THRESHOLD_PRICE>,
+                                                         Processing::expand<Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE>);
+
+// Output of the pipeline: messages are copied from the table of all 256 messages into flush window, which writes them as soon as it is full
+struct ExternalServerOutput {
+    std::shared_ptr<Common::NetworkReaderWriter<Common::ProtocolType::TCP>>& readerWriterTcpPtr;
+    Common::FlushWindow& flushWindow;
+    std::uint16_t port;
+    std::string_view ipv4Address;
+
+    void append(std::span<const std::uint8_t> message) {
+        flushWindow.append(message);
+        if (flushWindow.isFull()) {
+            flushToExternalServer(readerWriterTcpPtr, flushWindow, Common::FlushReason::Size, port, ipv4Address);
+        }
+    }
+};
+
+void sendToExternalServer(std::shared_ptr<Common::NetworkReaderWriter<Common::ProtocolType::TCP>>& readerWriterTcpPtr, const Common::Buffer& prices, Common::FlushWindow& flushWindow, std::uint16_t port, std::string_view ipv4Address) {
+    ExternalServerOutput output{readerWriterTcpPtr, flushWindow, port, ipv4Address};
+    PRICES_TO_MESSAGES.run(prices, output);
+}
+
+void writerToExternalServer(std::shared_ptr<Common::ThreadSafeQueueBuffer> threadSafeQueueBufferPtr, Common::CreditWindow& creditWindow, Common::FlushWindow& flushWindow, const Common::TcpTuning& tcpTuning, std::uint16_t port, std::string_view ipv4Address) {
     using namespace Common;
     std::shared_ptr<NetworkReaderWriter<ProtocolType::TCP>> readerWriterTcpPtr = std::make_shared<NetworkReaderWriter<ProtocolType::TCP>>(port, ipv4Address);
+    readerWriterTcpPtr->setTcpTuning(tcpTuning);
 
     std::thread readerThread (readerFromExternalServer, readerWriterTcpPtr, port, ipv4Address);
     readerThread.detach();
 
-    std::vector<std::vector<std::uint8_t>> pricesToSend;
-    pricesToSend.reserve(PIPE_BUF);
-    for(std::vector<std::uint8_t>& buffer : pricesToSend) {
-        buffer.reserve(Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE);
+    std::vector<Buffer*> pricesBatch(Settings::TRANSPORT_MAX_BATCH);
+    while(true) {
+        if(!flushWindow.isEmpty()) {
+            // Pending messages leave at deadline even if nothing new arrives. Messages coming before deadline would join
+            // the same flush anyway, so writer sleeps until deadline, then waits for writable socket
+            while(threadSafeQueueBufferPtr->countInProcess() == 0) {
+                if(!flushWindow.isExpired(FlushWindow::Clock::now())) {
+                    std::this_thread::sleep_until(flushWindow.deadline());
+                } else if(readerWriterTcpPtr->waitWritable(Settings::EGRESS_WRITABLE_POLL_MILLISECONDS)) {
+                    break;
+                }
+            }
+            if(threadSafeQueueBufferPtr->countInProcess() == 0) {
+                flushToExternalServer(readerWriterTcpPtr, flushWindow, FlushReason::Deadline, port, ipv4Address);
+            }
+        }
+        const std::span<Buffer*> pricesReceived = std::span<Buffer*>(pricesBatch).first(threadSafeQueueBufferPtr->dequeueInProcess(pricesBatch));
+
+        std::size_t countBytesProcessed = 0;
+        for(Buffer* prices : pricesReceived) {
+            sendToExternalServer(readerWriterTcpPtr, *prices, flushWindow, port, ipv4Address);
+            countBytesProcessed += prices->countBytes;
+        }
+
+        // Bytes are given back to ComponentA only when buffers are free again
+        threadSafeQueueBufferPtr->enqueueUsed(pricesReceived);
+        creditWindow.grant(countBytesProcessed);
+        if(isReadyToFlush(readerWriterTcpPtr, flushWindow)) {
+            flushToExternalServer(readerWriterTcpPtr, flushWindow, FlushReason::Deadline, port, ipv4Address);
+        }
     }
+}
 
-    while(true) {
-        Buffer& prices = threadSafeQueueBufferPtr->dequeueInProcess();
+/* Single thread reads from ComponentA, filters and sends to external server inline, so there is no thread hop on egress path.
+ * Replies of the server are read in the same loop: transports with a descriptor are polled together with the server socket,
+ * others (fifo reopens on every read, shared memory has no descriptor) drain replies after every batch
+ * */
+template<Common::LinkReader Transport>
+void runToCompletionToExternalServer(Transport& transport, Common::CreditWindow& creditWindow, Common::FlushWindow& flushWindow, const Common::TcpTuning& tcpTuning, std::uint16_t port, std::string_view ipv4Address) {
+    using namespace Common;
+    std::shared_ptr<NetworkReaderWriter<ProtocolType::TCP>> readerWriterTcpPtr = std::make_shared<NetworkReaderWriter<ProtocolType::TCP>>(port, ipv4Address);
+    readerWriterTcpPtr->setTcpTuning(tcpTuning);
 
-        NET_ASSERT(prices.countBytes <= pricesToSend.capacity());
-        Processing::filterPrices(prices, pricesToSend, Settings::MESSAGE_TO_EXTERNAL_SERVER_SIZE, [](const std::uint8_t price) {
-            return price > Settings::THRESHOLD_PRICE;
-        });
+    std::vector<Buffer> buffers(Settings::TRANSPORT_MAX_BATCH, Buffer{std::vector<std::uint8_t>(Settings::MAX_PRICES_MESSAGE_SIZE)});
+    std::vector<Buffer*> buffersToRead;
+    buffersToRead.reserve(buffers.size());
+    for(Buffer& buffer : buffers) {
+        buffersToRead.push_back(&buffer);
+    }
 
-        // According to the task we should send single message (eg. 88 88 88 88 88) to external server
-        for (std::int32_t index = 0; index < pricesToSend.size(); ++index) {
-            const std::int64_t result = readerWriterTcpPtr->write(pricesToSend[index]);
-            if (result == -1) {
-                tryReconnectWhileRefused(readerWriterTcpPtr, port, ipv4Address, std::chrono::milliseconds (Settings::RECONNECT_RETRY_INTERVAL_MILLISECONDS));
-                --index;
+    std::vector<std::uint8_t> reply(PIPE_BUF);
+
+    while(true) {
+        if constexpr (requires { transport.pollDescriptor(); }) {
+            // Expired messages wait for write readiness, pending ones for their deadline, microseconds need ppoll
+            const bool isExpired = flushWindow.isExpired(FlushWindow::Clock::now());
+            const short serverEvents = isExpired ? POLLIN | POLLOUT : POLLIN;
+            std::array<pollfd, 2> pollDescriptors{pollfd{transport.pollDescriptor(), POLLIN, 0}, pollfd{readerWriterTcpPtr->fileDescriptor(), serverEvents, 0}};
+            timespec timeout{};
+            const bool isWaitingForDeadline = !flushWindow.isEmpty() && !isExpired;
+            if(isWaitingForDeadline) {
+                const std::chrono::nanoseconds untilDeadline = std::max(flushWindow.deadline() - FlushWindow::Clock::now(), FlushWindow::Clock::duration::zero());
+                timeout.tv_sec = static_cast<time_t>(untilDeadline.count() / 1'000'000'000);
+                timeout.tv_nsec = static_cast<long>(untilDeadline.count() % 1'000'000'000);
+            }
+            const int resultPoll = ::ppoll(pollDescriptors.data(), pollDescriptors.size(), isWaitingForDeadline ? &timeout : nullptr, nullptr);
+            if(resultPoll == -1 && errno == EINTR) {
+                continue;
+            }
+            NET_CHECK(resultPoll, -1);
+            if(isReadyToFlush(readerWriterTcpPtr, flushWindow)) {
+                flushToExternalServer(readerWriterTcpPtr, flushWindow, FlushReason::Deadline, port, ipv4Address);
+            }
+            if((pollDescriptors[1].revents & ~POLLOUT) != 0) {
+                drainRepliesFromExternalServer(readerWriterTcpPtr, reply, port, ipv4Address);
+            }
+            if(pollDescriptors[0].revents == 0) {
+                continue;
             }
         }
 
-        threadSafeQueueBufferPtr->enqueueUsed(&prices);
+        const std::size_t countRead = transport.read(std::span<Buffer*>(buffersToRead));
+        std::size_t countBytesProcessed = 0;
+        for(std::size_t index = 0; index < countRead; ++index) {
+            sendToExternalServer(readerWriterTcpPtr, buffers[index], flushWindow, port, ipv4Address);
+            countBytesProcessed += buffers[index].countBytes;
+        }
+        // Buffers are reused by the next read right away, so the whole batch is granted back at once
+        creditWindow.grant(countBytesProcessed);
+        if constexpr (!requires { transport.pollDescriptor(); }) {
+            // Read of these transports can't wait for deadline, so pending messages never outlive the batch
+            if(!flushWindow.isEmpty()) {
+                flushToExternalServer(readerWriterTcpPtr, flushWindow, FlushReason::Deadline, port, ipv4Address);
+            }
+        } else if(isReadyToFlush(readerWriterTcpPtr, flushWindow)) {
+            flushToExternalServer(readerWriterTcpPtr, flushWindow, FlushReason::Deadline, port, ipv4Address);
+        }
+        drainRepliesFromExternalServer(readerWriterTcpPtr, reply, port, ipv4Address);
+    }
+}
+
+// Prints why messages to external server were flushed once per second if it changed
+void reporterOfFlushes(std::shared_ptr<const Common::FlushCounters> countersPtr) {
+    std::uint64_t countReported = 0;
+    while(true) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const std::uint64_t countFlushedBySize = countersPtr->countFlushedBySize.load(std::memory_order_relaxed);
+        const std::uint64_t countFlushedByDeadline = countersPtr->countFlushedByDeadline.load(std::memory_order_relaxed);
+        if(countFlushedBySize + countFlushedByDeadline != countReported) {
+            countReported = countFlushedBySize + countFlushedByDeadline;
+            std::cout << "Flushes: by size " << countFlushedBySize << " by deadline " << countFlushedByDeadline << std::endl;
+        }
     }
 }
 
 void terminationSignalHandler(int signal) {
     ::unlink(Settings::PIPE_PATH);
+    ::unlink(Settings::SOCKET_PATH);
+    ::shm_unlink(Settings::SHARED_MEMORY_NAME);
+    ::shm_unlink(Settings::CREDITS_SHARED_MEMORY_NAME);
     std::exit(signal);
 }
 
 int main(int argc, char *argv[]) {
     using namespace Common;
-    if(argc != 2 && argc != 3) {
-        std::cerr << "Wrong arguments, usage: ./ComponentB [port] [external server address (ipv4), or empty for localhost]" << std::endl;
-        return -1;
-    }
+    constexpr std::string_view usage = "usage: ./ComponentB [port] [external server address (ipv4), or empty for localhost] [--transport fifo|fifo-splice|unix|shm|tcp] [--layout two-thread|run-to-completion] [--flush-bytes count] [--flush-delay-us microseconds] [--tcp-profile kernel|nodelay|latency|throughput]";
 
     std::signal(SIGINT, terminationSignalHandler);
 
     try {
-        std::int32_t port = std::stoi(argv[1]);
+        const CommandLineOptions options(argc, argv);
+        if((options.countPositional() != 1 && options.countPositional() != 2) || !options.containsOnly({"transport", "layout", "flush-bytes", "flush-delay-us", "tcp-profile"})) {
+            std::cerr << "Wrong arguments, " << usage << std::endl;
+            return -1;
+        }
+
+        std::int32_t port = std::stoi(std::string(options.positional(0)));
         if(port > std::numeric_limits<std::uint16_t>::max() || port < 0) {
             std::cerr << "Wrong port number" << std::endl;
             return -1;
         }
+        const std::string ipv4Address(options.countPositional() == 2 ? options.positional(1) : Settings::LOCAL_HOST);
+        const TransportType transportType = transportTypeFromString(options.get("transport", "fifo"));
+        const std::string_view layout = options.get("layout", "two-thread");
+        if(layout != "two-thread" && layout != "run-to-completion") {
+            std::cerr << "Wrong layout, " << usage << std::endl;
+            return -1;
+        }
+
+        const std::string_view flushBytesOption = options.get("flush-bytes", "");
+        const std::int64_t flushBytes = flushBytesOption.empty() ? Settings::EGRESS_FLUSH_BYTES : std::stoll(std::string(flushBytesOption));
+        const std::string_view flushDelayOption = options.get("flush-delay-us", "");
+        const std::int64_t flushDelayMicroseconds = flushDelayOption.empty() ? Settings::EGRESS_FLUSH_DELAY_MICROSECONDS : std::stoll(std::string(flushDelayOption));
+        if(flushBytes <= 0 || flushDelayMicroseconds < 0) {
+            std::cerr << "Wrong flush window, " << usage << std::endl;
+            return -1;
+        }
+        // Flush window does the batching, so kernel is told not to add Nagle delay on top unless asked for
+        TcpTuning tcpTuning{tcpProfileFromString(options.get("tcp-profile", "nodelay"))};
+        if(tcpTuning.profile == TcpProfile::Latency) {
+            tcpTuning.sendBufferSize = Settings::TCP_LATENCY_SEND_BUFFER_SIZE;
+            tcpTuning.notSentLowWatermark = Settings::TCP_LATENCY_NOT_SENT_LOW_WATERMARK;
+        }
+        std::shared_ptr<FlushCounters> flushCountersPtr = std::make_shared<FlushCounters>();
+        FlushWindow flushWindow(flushBytes, std::chrono::microseconds(flushDelayMicroseconds), *flushCountersPtr);
+        std::thread reporterThread(reporterOfFlushes, flushCountersPtr);
+        reporterThread.detach();
+
+        // Credits are granted always, ComponentA uses them only if it runs with credit policy, otherwise grants are skipped by its resync
+        CreditWindow creditWindow(Settings::CREDITS_SHARED_MEMORY_NAME, Settings::CREDIT_WINDOW_BYTES, SocketRole::Listen);
 
-        std::shared_ptr<ThreadSafeQueueBuffer> threadSafeQueueBufferPtr = std::make_shared<ThreadSafeQueueBuffer>(PIPE_BUF, Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS);
+        if(layout == "run-to-completion") {
+            Transport::withTransport(transportType, SocketRole::Listen, [&](auto& transport) {
+                runToCompletionToExternalServer(transport, creditWindow, flushWindow, tcpTuning, port, ipv4Address);
+            });
+            return 0;
+        }
 
-        std::thread readerThread(readerFromComponentA, threadSafeQueueBufferPtr, Settings::PIPE_PATH);
-        readerThread.detach();
+        std::shared_ptr<ThreadSafeQueueBuffer> threadSafeQueueBufferPtr = std::make_shared<ThreadSafeQueueBuffer>(Settings::MAX_PRICES_MESSAGE_SIZE, Settings::THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS);
+        Transport::withTransport(transportType, SocketRole::Listen, [&](auto& transport) {
+            std::thread readerThread([threadSafeQueueBufferPtr, &transport]() {
+                readerFromComponentA(threadSafeQueueBufferPtr, transport);
+            });
+            readerThread.detach();
 
-        writerToExternalServer(threadSafeQueueBufferPtr, port, argc == 3 ? argv[2] : Settings::LOCAL_HOST);
+            writerToExternalServer(threadSafeQueueBufferPtr, creditWindow, flushWindow, tcpTuning, port, ipv4Address);
+        });
     } catch (std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return -1;
@@ -1,25 +1,129 @@
 #include "EntriesProcessing.h"
 
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 namespace Processing {
 
-bool filterEntries(const Common::Buffer& entries, std::vector<std::uint8_t>& outPrices, std::uint8_t eofMarker) {
-    if(entries.countBytes < 3) {
+namespace {
+
+constexpr std::size_t MARKER_BLOCK_SIZE = 32;
+
+// Bit i is set if byte i of 32 byte block is EOF marker
+std::uint32_t markerMask(const std::uint8_t* block, std::uint8_t eofMarker) {
+#if defined(__AVX2__)
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(static_cast<char>(eofMarker)))));
+#elif defined(__SSE2__)
+    const __m128i marker = _mm_set1_epi8(static_cast<char>(eofMarker));
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16));
+    const std::uint32_t lowMask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(low, marker)));
+    const std::uint32_t highMask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(high, marker)));
+    return lowMask | (highMask << 16);
+#else
+    std::uint32_t mask = 0;
+    for(std::size_t i = 0; i < MARKER_BLOCK_SIZE; ++i) {
+        mask |= static_cast<std::uint32_t>(block[i] == eofMarker) << i;
+    }
+    return mask;
+#endif
+}
+
+/* Returns position of EOF marker which ends record starting at start, or countBytes if record is not terminated.
+ * Volume might be equal to EOF marker, so only positions with the same parity as start are taken into account
+ * */
+std::size_t findRecordEnd(const std::uint8_t* data, std::size_t countBytes, std::size_t start, std::uint8_t eofMarker) {
+    const std::uint32_t parityMask = (start & 1U) == 0 ? 0x55555555U : 0xAAAAAAAAU;
+    std::size_t block = start & ~(MARKER_BLOCK_SIZE - 1);
+    std::uint32_t startMask = ~0U << (start - block);
+    for(; block + MARKER_BLOCK_SIZE <= countBytes; block += MARKER_BLOCK_SIZE) {
+        const std::uint32_t mask = markerMask(data + block, eofMarker) & parityMask & startMask;
+        if(mask != 0) {
+            return block + static_cast<std::size_t>(__builtin_ctz(mask));
+        }
+        startMask = ~0U;
+    }
+    for(std::size_t i = std::max(block + ((block ^ start) & 1U), start); i < countBytes; i += 2) {
+        if(data[i] == eofMarker) {
+            return i;
+        }
+    }
+    return countBytes;
+}
+
+// Calls append(price) for every price before EOF marker, returns false if there is no EOF marker
+template<typename Append>
+bool deinterleaveEntries(const std::uint8_t* data, std::size_t countBytes, std::uint8_t eofMarker, Append&& append) {
+    if(countBytes < 3) {
         return false;
     }
 
-    outPrices.clear();
-    const std::vector<std::uint8_t>& data = entries.data;
-    bool foundEof = false;
-    for(std::int32_t i = 0; i < entries.countBytes; i += 2) {
+    for(std::size_t i = 0; i < countBytes; i += 2) {
         const std::uint8_t byte = data[i];
         if(byte != eofMarker) {
-            outPrices.push_back(byte);
+            append(byte);
         } else {
             // assumption that we can skip the rest of the packet
-            foundEof = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+bool filterEntries(const Common::Buffer& entries, std::vector<std::uint8_t>& outPrices, std::uint8_t eofMarker) {
+    return filterEntries(entries.data.data(), entries.countBytes, outPrices, eofMarker);
+}
+
+bool filterEntries(Common::Buffer& entries, std::uint8_t eofMarker) {
+    // Price i is read from 2 * i and written to i, so it never overwrites entry which is not read yet
+    std::size_t countPrices = 0;
+    const bool foundEof = filterEntries(entries.data.data(), entries.countBytes, entries.data.data(), countPrices, eofMarker);
+    entries.countBytes = countPrices;
+    return foundEof;
+}
+
+std::size_t filterRecords(const std::uint8_t* data, std::size_t countBytes, std::uint8_t* outPrices, std::size_t& outCountPrices, std::vector<std::size_t>& outRecordEnds, std::uint8_t eofMarker) {
+    outRecordEnds.clear();
+    outCountPrices = 0;
+    if(countBytes < 3) {
+        return 0;
+    }
+
+    std::size_t start = 0;
+    while(start < countBytes) {
+        const std::size_t end = findRecordEnd(data, countBytes, start, eofMarker);
+        if(end == countBytes) {
+            // Bytes after the last EOF marker are not a record
             break;
         }
+        // Writes never overtake reads (price of entry at 2 * i goes to i or lower), so outPrices might be data itself
+        for(std::size_t i = start; i < end; i += 2) {
+            outPrices[outCountPrices++] = data[i];
+        }
+        outRecordEnds.push_back(outCountPrices);
+        start = end + 1;
     }
+    return outRecordEnds.size();
+}
+
+std::size_t filterRecords(Common::Buffer& entries, std::vector<std::size_t>& outRecordEnds, std::uint8_t eofMarker) {
+    std::size_t countPrices = 0;
+    const std::size_t countRecords = filterRecords(entries.data.data(), entries.countBytes, entries.data.data(), countPrices, outRecordEnds, eofMarker);
+    entries.countBytes = countPrices;
+    return countRecords;
+}
+
+bool filterEntries(const std::uint8_t* data, std::size_t countBytes, std::vector<std::uint8_t>& outPrices, std::uint8_t eofMarker) {
+    outPrices.clear();
+    const bool foundEof = deinterleaveEntries(data, countBytes, eofMarker, [&outPrices](std::uint8_t price) {
+        outPrices.push_back(price);
+    });
 
     if(!foundEof) {
         outPrices.clear();
@@ -28,4 +132,136 @@ bool filterEntries(const Common::Buffer& entries, std::vector<std::uint8_t>& out
     return true;
 }
 
-}
\ No newline at end of file
+bool filterEntries(const std::uint8_t* data, std::size_t countBytes, std::uint8_t* outPrices, std::size_t& outCountPrices, std::uint8_t eofMarker) {
+    std::size_t countPrices = 0;
+    const bool foundEof = deinterleaveEntries(data, countBytes, eofMarker, [outPrices, &countPrices](std::uint8_t price) {
+        outPrices[countPrices++] = price;
+    });
+
+    outCountPrices = foundEof ? countPrices : 0;
+    return foundEof;
+}
+
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void goodPriceMasksAvx2(const std::uint8_t* prices, std::size_t countBlocks, const PriceBitmap& goodPrices,
+                                                         std::uint32_t* outMasks) {
+    const __m256i rowsBelow128 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(goodPrices.rowsBelow128().data())));
+    const __m256i rowsFrom128 = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(goodPrices.rowsFrom128().data())));
+    const __m256i bitsOfRow = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                               1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    for(std::size_t b = 0; b < countBlocks; ++b) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prices + b * PRICE_BLOCK_SIZE));
+        const __m256i lowNibbles = _mm256_and_si256(block, _mm256_set1_epi8(0x0f));
+        const __m256i highNibbles = _mm256_and_si256(_mm256_srli_epi16(block, 4), _mm256_set1_epi8(0x07));
+        // Top bit of price picks the table
+        const __m256i rows = _mm256_blendv_epi8(_mm256_shuffle_epi8(rowsBelow128, lowNibbles), _mm256_shuffle_epi8(rowsFrom128, lowNibbles), block);
+        const __m256i bitOfPrice = _mm256_shuffle_epi8(bitsOfRow, highNibbles);
+        outMasks[b] = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(rows, bitOfPrice), bitOfPrice)));
+    }
+}
+
+__attribute__((target("ssse3"))) void goodPriceMasksSsse3(const std::uint8_t* prices, std::size_t countBlocks, const PriceBitmap& goodPrices,
+                                                           std::uint32_t* outMasks) {
+    const __m128i rowsBelow128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(goodPrices.rowsBelow128().data()));
+    const __m128i rowsFrom128 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(goodPrices.rowsFrom128().data()));
+    const __m128i bitsOfRow = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    for(std::size_t b = 0; b < countBlocks; ++b) {
+        std::uint32_t mask = 0;
+        for(std::size_t half = 0; half < 2; ++half) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prices + b * PRICE_BLOCK_SIZE + half * 16));
+            const __m128i lowNibbles = _mm_and_si128(block, _mm_set1_epi8(0x0f));
+            const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(block, 4), _mm_set1_epi8(0x07));
+            // blendv needs SSE4.1, prices from 128 are negative as signed bytes
+            const __m128i isFrom128 = _mm_cmplt_epi8(block, _mm_setzero_si128());
+            const __m128i rows = _mm_or_si128(_mm_andnot_si128(isFrom128, _mm_shuffle_epi8(rowsBelow128, lowNibbles)), _mm_and_si128(isFrom128, _mm_shuffle_epi8(rowsFrom128, lowNibbles)));
+            const __m128i bitOfPrice = _mm_shuffle_epi8(bitsOfRow, highNibbles);
+            mask |= static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(rows, bitOfPrice), bitOfPrice))) << (half * 16);
+        }
+        outMasks[b] = mask;
+    }
+}
+#endif
+
+void goodPriceMasksScalar(const std::uint8_t* prices, std::size_t countBlocks, const PriceBitmap& goodPrices, std::uint32_t* outMasks) {
+    for(std::size_t b = 0; b < countBlocks; ++b) {
+        std::uint32_t mask = 0;
+        for(std::size_t i = 0; i < PRICE_BLOCK_SIZE; ++i) {
+            mask |= static_cast<std::uint32_t>(goodPrices.contains(prices[b * PRICE_BLOCK_SIZE + i])) << i;
+        }
+        outMasks[b] = mask;
+    }
+}
+
+}
+
+InstructionSet instructionSet() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const InstructionSet supported = []() {
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) {
+            return InstructionSet::Avx2;
+        }
+        return __builtin_cpu_supports("ssse3") ? InstructionSet::Ssse3 : InstructionSet::Scalar;
+    }();
+    return supported;
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+void goodPriceMasks(const std::uint8_t* prices, std::size_t countBlocks, const PriceBitmap& goodPrices, std::uint32_t* outMasks,
+                    InstructionSet kernel) {
+    switch(kernel) {
+#if defined(__x86_64__) || defined(__i386__)
+        case InstructionSet::Avx2:
+            goodPriceMasksAvx2(prices, countBlocks, goodPrices, outMasks);
+            return;
+        case InstructionSet::Ssse3:
+            goodPriceMasksSsse3(prices, countBlocks, goodPrices, outMasks);
+            return;
+#endif
+        default:
+            goodPriceMasksScalar(prices, countBlocks, goodPrices, outMasks);
+    }
+}
+
+EntryBlockMasks entryBlockMasks(const std::uint8_t* entries, std::uint8_t thresholdPrice, std::uint8_t eofMarker) {
+#if defined(__AVX2__)
+    const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+    const __m256i first = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(entries)), lowBytes);
+    const __m256i second = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(entries + 32)), lowBytes);
+    // packus works inside of 128 bit lanes, permute puts prices back in order
+    const __m256i prices = _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second), 0xD8);
+    // No unsigned byte compare, flipping top bit makes signed compare work for unsigned values
+    const __m256i topBit = _mm256_set1_epi8(static_cast<char>(0x80));
+    const __m256i isGood = _mm256_cmpgt_epi8(_mm256_xor_si256(prices, topBit), _mm256_set1_epi8(static_cast<char>(thresholdPrice ^ 0x80)));
+    const __m256i isEof = _mm256_cmpeq_epi8(prices, _mm256_set1_epi8(static_cast<char>(eofMarker)));
+    return {static_cast<std::uint32_t>(_mm256_movemask_epi8(isEof)), static_cast<std::uint32_t>(_mm256_movemask_epi8(isGood))};
+#elif defined(__SSE2__)
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    const __m128i topBit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i threshold = _mm_set1_epi8(static_cast<char>(thresholdPrice ^ 0x80));
+    const __m128i marker = _mm_set1_epi8(static_cast<char>(eofMarker));
+    EntryBlockMasks masks;
+    for(std::size_t half = 0; half < 2; ++half) {
+        const std::uint8_t* block = entries + half * 32;
+        const __m128i first = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), lowBytes);
+        const __m128i second = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16)), lowBytes);
+        const __m128i prices = _mm_packus_epi16(first, second);
+        masks.eof |= static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(prices, marker))) << (half * 16);
+        masks.good |= static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_xor_si128(prices, topBit), threshold))) << (half * 16);
+    }
+    return masks;
+#else
+    EntryBlockMasks masks;
+    for(std::size_t i = 0; i < ENTRY_BLOCK_SIZE; ++i) {
+        masks.eof |= static_cast<std::uint32_t>(entries[2 * i] == eofMarker) << i;
+        masks.good |= static_cast<std::uint32_t>(entries[2 * i] > thresholdPrice) << i;
+    }
+    return masks;
+#endif
+}
+
+}
@@ -0,0 +1,53 @@
+#include "FilterWorkers.h"
+#include "EntriesProcessing.h"
+
+namespace Processing {
+
+FilterWorkers::FilterWorkers(std::size_t countWorkers, std::size_t capacity, std::uint8_t eofMarker)
+    : m_queue(capacity),
+    m_reorderBuffer(capacity),
+    m_eofMarker(eofMarker) {
+    NET_ASSERT(countWorkers > 0);
+    m_threads.reserve(countWorkers);
+    for(std::size_t i = 0; i < countWorkers; ++i) {
+        m_threads.emplace_back(&FilterWorkers::worker, this);
+    }
+}
+
+FilterWorkers::~FilterWorkers() {
+    m_stopped.store(true, std::memory_order_relaxed);
+    for(std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void FilterWorkers::submit(Common::Buffer* entries) {
+    entries->sequenceNumber = m_nextSequenceNumber++;
+    // Queue has room for every buffer in flight, so worker is never waited for in practice
+    Common::Backoff backoff;
+    while(!m_queue.try_enqueue(entries)) {
+        backoff.wait();
+    }
+}
+
+void FilterWorkers::worker() {
+    // Grows on the first datagrams, then keeps its capacity
+    std::vector<std::size_t> recordEnds;
+    Common::Buffer* entries = nullptr;
+    // Idle workers end up sleeping, so they don't take cores from reader and writer between bursts
+    Common::Backoff backoff;
+    while(!m_stopped.load(std::memory_order_relaxed)) {
+        if(!m_queue.try_dequeue(entries)) {
+            backoff.wait();
+            continue;
+        }
+        backoff.reset();
+        NET_ASSERT(entries->data.size() >= entries->countBytes);
+        if(filterRecords(*entries, recordEnds, m_eofMarker) == 0) {
+            entries->countBytes = 0;
+        }
+        m_reorderBuffer.publish(entries);
+    }
+}
+
+} // namespace Processing
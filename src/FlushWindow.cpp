@@ -0,0 +1,26 @@
+#include "FlushWindow.h"
+
+namespace Common {
+
+FlushWindow::FlushWindow(std::size_t thresholdBytes, std::chrono::microseconds maxDelay, FlushCounters& counters)
+    : m_thresholdBytes(thresholdBytes),
+    m_maxDelay(maxDelay),
+    m_counters(counters) {
+    NET_ASSERT(thresholdBytes > 0);
+    // Message which crosses threshold is still appended whole
+    m_pending.reserve(thresholdBytes * 2);
+}
+
+void FlushWindow::append(std::span<const std::uint8_t> message) {
+    if(m_pending.empty()) {
+        m_deadline = Clock::now() + m_maxDelay;
+    }
+    m_pending.insert(m_pending.end(), message.begin(), message.end());
+}
+
+void FlushWindow::flushed(FlushReason reason) {
+    m_pending.clear();
+    increment(reason == FlushReason::Size ? m_counters.countFlushedBySize : m_counters.countFlushedByDeadline);
+}
+
+} // namespace Common
@@ -0,0 +1,130 @@
+#include "PacketMmapReader.h"
+
+#include <net/if.h>
+#include <sys/mman.h>
+
+#include <linux/if_ether.h>
+
+namespace Common {
+
+PacketMmapReader::PacketMmapReader(std::string_view interfaceName, std::uint16_t port, std::size_t blockSize, std::size_t countBlocks, std::uint32_t blockTimeoutMilliseconds)
+    : m_blockSize(blockSize),
+    m_countBlocks(countBlocks),
+    m_port(port) {
+    // Setup errors are checked in release too: without CAP_NET_RAW or a valid interface there is nothing to read
+    // SOCK_DGRAM strips link layer header, so tp_net points to the ip header on every interface
+    m_socketFileDescriptor = ::socket(AF_PACKET, SOCK_DGRAM, ::htons(ETH_P_IP));
+    checkErrors(m_socketFileDescriptor, -1);
+
+    const int version = TPACKET_V3;
+    checkErrors(::setsockopt(m_socketFileDescriptor, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)), -1);
+
+    // On loopback every datagram is seen twice (outgoing and incoming), we only need the incoming one.
+    // Old kernels don't know this option, parseUdpPayload skips outgoing packets anyway
+    const int ignoreOutgoing = 1;
+    ::setsockopt(m_socketFileDescriptor, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignoreOutgoing, sizeof(ignoreOutgoing));
+
+    // Frame size is ignored by TPACKET_V3 (frames are packed in the block), but the kernel still validates it
+    tpacket_req3 request{};
+    request.tp_block_size = static_cast<unsigned int>(m_blockSize);
+    request.tp_block_nr = static_cast<unsigned int>(m_countBlocks);
+    request.tp_frame_size = TPACKET_ALIGNMENT << 7;
+    request.tp_frame_nr = static_cast<unsigned int>((m_blockSize * m_countBlocks) / request.tp_frame_size);
+    // Retires partially filled block after timeout, so latency is bounded at low rates
+    request.tp_retire_blk_tov = blockTimeoutMilliseconds;
+    checkErrors(::setsockopt(m_socketFileDescriptor, SOL_PACKET, PACKET_RX_RING, &request, sizeof(request)), -1);
+
+    void* ring = ::mmap(nullptr, m_blockSize * m_countBlocks, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, m_socketFileDescriptor, 0);
+    if(ring == MAP_FAILED) {
+        // MAP_LOCKED might fail because of RLIMIT_MEMLOCK, ring works without it
+        ring = ::mmap(nullptr, m_blockSize * m_countBlocks, PROT_READ | PROT_WRITE, MAP_SHARED, m_socketFileDescriptor, 0);
+    }
+    checkErrors(ring, MAP_FAILED);
+    m_ring = static_cast<std::uint8_t*>(ring);
+
+    const std::string interface(interfaceName);
+    const unsigned int interfaceIndex = ::if_nametoindex(interface.c_str());
+    checkErrors(interfaceIndex, 0U);
+
+    sockaddr_ll address{};
+    address.sll_family = AF_PACKET;
+    address.sll_protocol = ::htons(ETH_P_IP);
+    address.sll_ifindex = static_cast<int>(interfaceIndex);
+    checkErrors(::bind(m_socketFileDescriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)), -1);
+
+    // Kernel copy of datagram into this socket is dropped as soon as its small buffer is full
+    m_udpFileDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+    checkErrors(m_udpFileDescriptor, -1);
+    const int receiveBufferSize = 0;
+    ::setsockopt(m_udpFileDescriptor, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+    sockaddr_in udpAddress{};
+    udpAddress.sin_family = AF_INET;
+    udpAddress.sin_addr.s_addr = ::htonl(INADDR_ANY);
+    udpAddress.sin_port = ::htons(port);
+    checkErrors(::bind(m_udpFileDescriptor, reinterpret_cast<sockaddr*>(&udpAddress), sizeof(udpAddress)), -1);
+}
+
+PacketMmapReader::~PacketMmapReader() {
+    if(m_ring != nullptr) {
+        ::munmap(m_ring, m_blockSize * m_countBlocks);
+    }
+    if(m_socketFileDescriptor != -1) {
+        ::close(m_socketFileDescriptor);
+    }
+    if(m_udpFileDescriptor != -1) {
+        ::close(m_udpFileDescriptor);
+    }
+}
+
+PacketMmapReader::PacketMmapReader(PacketMmapReader&& other) noexcept {
+    *this = std::move(other);
+}
+
+PacketMmapReader& PacketMmapReader::operator=(PacketMmapReader&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_socketFileDescriptor, other.m_socketFileDescriptor);
+        std::swap(m_udpFileDescriptor, other.m_udpFileDescriptor);
+        std::swap(m_ring, other.m_ring);
+        std::swap(m_blockSize, other.m_blockSize);
+        std::swap(m_countBlocks, other.m_countBlocks);
+        std::swap(m_currentBlock, other.m_currentBlock);
+        std::swap(m_port, other.m_port);
+    }
+    return *this;
+}
+
+const std::uint8_t* PacketMmapReader::parseUdpPayload(const tpacket3_hdr& header, std::size_t& outPayloadSize) const {
+    const std::uint8_t* frame = reinterpret_cast<const std::uint8_t*>(&header);
+    const sockaddr_ll& linkAddress = *reinterpret_cast<const sockaddr_ll*>(frame + TPACKET_ALIGN(sizeof(tpacket3_hdr)));
+    if(linkAddress.sll_pkttype == PACKET_OUTGOING) {
+        return nullptr;
+    }
+
+    const std::uint8_t* network = frame + header.tp_net;
+    const std::size_t captured = header.tp_snaplen;
+    if(captured < sizeof(iphdr)) {
+        return nullptr;
+    }
+
+    const iphdr& ipHeader = *reinterpret_cast<const iphdr*>(network);
+    const std::size_t ipHeaderSize = ipHeader.ihl * 4U;
+    // Fragments are skipped: only the first one carries udp header, reassembly is not worth it here
+    const bool isFragment = (::ntohs(ipHeader.frag_off) & (IP_MF | IP_OFFMASK)) != 0;
+    if(ipHeader.version != 4 || ipHeader.protocol != IPPROTO_UDP || isFragment || captured < ipHeaderSize + sizeof(udphdr)) {
+        return nullptr;
+    }
+
+    const udphdr& udpHeader = *reinterpret_cast<const udphdr*>(network + ipHeaderSize);
+    if(::ntohs(udpHeader.dest) != m_port) {
+        return nullptr;
+    }
+
+    const std::size_t udpLength = ::ntohs(udpHeader.len);
+    if(udpLength < sizeof(udphdr) || ipHeaderSize + udpLength > captured) {
+        return nullptr;
+    }
+    outPayloadSize = udpLength - sizeof(udphdr);
+    return network + ipHeaderSize + sizeof(udphdr);
+}
+
+} // namespace Common
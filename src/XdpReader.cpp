@@ -0,0 +1,241 @@
+#include "XdpReader.h"
+
+#include <array>
+
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+
+namespace Common {
+
+namespace {
+
+constexpr std::size_t ETHERNET_HEADER_SIZE = sizeof(ethhdr);
+constexpr std::size_t IP_HEADER_SIZE = sizeof(iphdr);
+constexpr std::size_t HEADERS_SIZE = ETHERNET_HEADER_SIZE + IP_HEADER_SIZE + sizeof(udphdr);
+
+int bpf(bpf_cmd command, bpf_attr& attributes) {
+    return static_cast<int>(::syscall(__NR_bpf, command, &attributes, sizeof(attributes)));
+}
+
+constexpr bpf_insn instruction(std::uint8_t code, std::uint8_t destination, std::uint8_t source, std::int16_t offset, std::int32_t immediate) {
+    return bpf_insn{code, destination, source, offset, immediate};
+}
+
+constexpr bpf_insn loadPacketField(std::uint8_t size, std::uint8_t destination, std::uint8_t source, std::int16_t offset) {
+    return instruction(BPF_LDX | size | BPF_MEM, destination, source, offset, 0);
+}
+
+/* XDP program: redirects unfragmented ipv4 udp datagrams (without ip options) for port to XSKMAP[rx_queue_index],
+ * passes everything else to the kernel stack.
+ * Packet fields are loaded in host order, so constants are converted with htons
+ * */
+std::array<bpf_insn, 24> makeRedirectProgram(int mapFileDescriptor, std::uint16_t port) {
+    constexpr std::int16_t PASS = 22;
+    const auto jumpToPass = [](std::uint8_t operation, std::uint8_t destination, std::int32_t immediate, std::int16_t index) {
+        return instruction(BPF_JMP | operation | BPF_K, destination, 0, PASS - index - 1, immediate);
+    };
+    return {
+        /* 0 */ instruction(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0),
+        /* 1 */ loadPacketField(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, data)),
+        /* 2 */ loadPacketField(BPF_W, BPF_REG_3, BPF_REG_6, offsetof(xdp_md, data_end)),
+        /* 3 */ instruction(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+        /* 4 */ instruction(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, HEADERS_SIZE),
+        /* 5 */ instruction(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, PASS - 5 - 1, 0),
+        /* 6 */ loadPacketField(BPF_H, BPF_REG_5, BPF_REG_2, offsetof(ethhdr, h_proto)),
+        /* 7 */ jumpToPass(BPF_JNE, BPF_REG_5, ::htons(ETH_P_IP), 7),
+        /* 8 */ loadPacketField(BPF_B, BPF_REG_5, BPF_REG_2, ETHERNET_HEADER_SIZE),
+        /* 9 */ jumpToPass(BPF_JNE, BPF_REG_5, 0x45, 9),
+        /* 10 */ loadPacketField(BPF_B, BPF_REG_5, BPF_REG_2, ETHERNET_HEADER_SIZE + offsetof(iphdr, protocol)),
+        /* 11 */ jumpToPass(BPF_JNE, BPF_REG_5, IPPROTO_UDP, 11),
+        /* 12 */ loadPacketField(BPF_H, BPF_REG_5, BPF_REG_2, ETHERNET_HEADER_SIZE + offsetof(iphdr, frag_off)),
+        /* 13 */ jumpToPass(BPF_JSET, BPF_REG_5, ::htons(IP_MF | IP_OFFMASK), 13),
+        /* 14 */ loadPacketField(BPF_H, BPF_REG_5, BPF_REG_2, ETHERNET_HEADER_SIZE + IP_HEADER_SIZE + offsetof(udphdr, dest)),
+        /* 15 */ jumpToPass(BPF_JNE, BPF_REG_5, ::htons(port), 15),
+        /* 16 */ loadPacketField(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(xdp_md, rx_queue_index)),
+        /* 17 */ instruction(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, mapFileDescriptor),
+        /* 18 */ instruction(0, 0, 0, 0, 0),
+        // Action returned by redirect_map when there is no socket for the queue
+        /* 19 */ instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+        /* 20 */ instruction(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        /* 21 */ instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        /* 22 */ instruction(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+        /* 23 */ instruction(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+}
+
+} // namespace
+
+XdpReader::XdpReader(std::string_view interfaceName, std::uint16_t port, std::uint32_t queueId, std::uint32_t countFrames, std::size_t frameSize)
+    : m_frameSize(frameSize),
+    m_port(port) {
+    const std::string interface(interfaceName);
+    const unsigned int interfaceIndex = ::if_nametoindex(interface.c_str());
+    try {
+        checkErrors(interfaceIndex, 0U);
+        createSocket(countFrames);
+
+        sockaddr_xdp address{};
+        address.sxdp_family = AF_XDP;
+        // Generic mode has no zero copy support
+        address.sxdp_flags = XDP_COPY;
+        address.sxdp_ifindex = interfaceIndex;
+        address.sxdp_queue_id = queueId;
+        checkErrors(::bind(m_socketFileDescriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)), -1);
+
+        attachProgram(interfaceIndex, queueId);
+    } catch (...) {
+        close();
+        throw;
+    }
+}
+
+XdpReader::~XdpReader() {
+    close();
+}
+
+XdpReader::XdpReader(XdpReader&& other) noexcept {
+    *this = std::move(other);
+}
+
+XdpReader& XdpReader::operator=(XdpReader&& other) noexcept {
+    if(this != &other) {
+        std::swap(m_socketFileDescriptor, other.m_socketFileDescriptor);
+        std::swap(m_mapFileDescriptor, other.m_mapFileDescriptor);
+        std::swap(m_programFileDescriptor, other.m_programFileDescriptor);
+        std::swap(m_linkFileDescriptor, other.m_linkFileDescriptor);
+        std::swap(m_umem, other.m_umem);
+        std::swap(m_umemSize, other.m_umemSize);
+        std::swap(m_frameSize, other.m_frameSize);
+        std::swap(m_rxRing, other.m_rxRing);
+        std::swap(m_fillRing, other.m_fillRing);
+        std::swap(m_port, other.m_port);
+    }
+    return *this;
+}
+
+void XdpReader::close() {
+    // Closing link detaches program from interface
+    for(int* fileDescriptor : {&m_linkFileDescriptor, &m_programFileDescriptor, &m_mapFileDescriptor, &m_socketFileDescriptor}) {
+        if(*fileDescriptor != -1) {
+            ::close(*fileDescriptor);
+            *fileDescriptor = -1;
+        }
+    }
+    for(XdpRing* ring : {&m_rxRing, &m_fillRing}) {
+        if(ring->mapping != nullptr) {
+            ::munmap(ring->mapping, ring->mappingSize);
+            *ring = XdpRing{};
+        }
+    }
+    if(m_umem != nullptr) {
+        ::munmap(m_umem, m_umemSize);
+        m_umem = nullptr;
+    }
+}
+
+void XdpReader::createSocket(std::uint32_t countFrames) {
+    // Kernel requires power of two ring sizes
+    NET_ASSERT(countFrames != 0 && (countFrames & (countFrames - 1)) == 0);
+    m_socketFileDescriptor = ::socket(AF_XDP, SOCK_RAW, 0);
+    checkErrors(m_socketFileDescriptor, -1);
+
+    m_umemSize = countFrames * m_frameSize;
+    void* umem = ::mmap(nullptr, m_umemSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    checkErrors(umem, MAP_FAILED);
+    m_umem = static_cast<std::uint8_t*>(umem);
+
+    xdp_umem_reg umemRegistration{};
+    umemRegistration.addr = reinterpret_cast<std::uint64_t>(m_umem);
+    umemRegistration.len = m_umemSize;
+    umemRegistration.chunk_size = static_cast<std::uint32_t>(m_frameSize);
+    checkErrors(::setsockopt(m_socketFileDescriptor, SOL_XDP, XDP_UMEM_REG, &umemRegistration, sizeof(umemRegistration)), -1);
+
+    // Every frame is either in fill ring, in rx ring or in our hands, so rings of countFrames never overflow.
+    // Completion ring is never used for rx only socket, but bind requires it
+    checkErrors(::setsockopt(m_socketFileDescriptor, SOL_XDP, XDP_UMEM_FILL_RING, &countFrames, sizeof(countFrames)), -1);
+    checkErrors(::setsockopt(m_socketFileDescriptor, SOL_XDP, XDP_UMEM_COMPLETION_RING, &countFrames, sizeof(countFrames)), -1);
+    checkErrors(::setsockopt(m_socketFileDescriptor, SOL_XDP, XDP_RX_RING, &countFrames, sizeof(countFrames)), -1);
+
+    xdp_mmap_offsets offsets{};
+    socklen_t offsetsSize = sizeof(offsets);
+    checkErrors(::getsockopt(m_socketFileDescriptor, SOL_XDP, XDP_MMAP_OFFSETS, &offsets, &offsetsSize), -1);
+
+    const auto mapRing = [this, countFrames](XdpRing& ring, const xdp_ring_offset& offset, std::size_t descriptorSize, off_t pageOffset) {
+        ring.mappingSize = offset.desc + countFrames * descriptorSize;
+        void* mapping = ::mmap(nullptr, ring.mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_socketFileDescriptor, pageOffset);
+        checkErrors(mapping, MAP_FAILED);
+        std::uint8_t* base = static_cast<std::uint8_t*>(mapping);
+        ring.mapping = mapping;
+        ring.producer = reinterpret_cast<std::uint32_t*>(base + offset.producer);
+        ring.consumer = reinterpret_cast<std::uint32_t*>(base + offset.consumer);
+        ring.descriptors = base + offset.desc;
+        ring.mask = countFrames - 1;
+    };
+    mapRing(m_rxRing, offsets.rx, sizeof(xdp_desc), XDP_PGOFF_RX_RING);
+    mapRing(m_fillRing, offsets.fr, sizeof(std::uint64_t), XDP_UMEM_PGOFF_FILL_RING);
+
+    // Hand all frames to the kernel
+    std::uint64_t* fillDescriptors = static_cast<std::uint64_t*>(m_fillRing.descriptors);
+    for(std::uint32_t frame = 0; frame < countFrames; ++frame) {
+        fillDescriptors[frame] = frame * m_frameSize;
+    }
+    std::atomic_ref<std::uint32_t>(*m_fillRing.producer).store(countFrames, std::memory_order_release);
+}
+
+void XdpReader::attachProgram(unsigned int interfaceIndex, std::uint32_t queueId) {
+    bpf_attr mapAttributes{};
+    mapAttributes.map_type = BPF_MAP_TYPE_XSKMAP;
+    mapAttributes.key_size = sizeof(std::uint32_t);
+    mapAttributes.value_size = sizeof(std::uint32_t);
+    mapAttributes.max_entries = queueId + 1;
+    m_mapFileDescriptor = bpf(BPF_MAP_CREATE, mapAttributes);
+    checkErrors(m_mapFileDescriptor, -1);
+
+    bpf_attr updateAttributes{};
+    updateAttributes.map_fd = m_mapFileDescriptor;
+    updateAttributes.key = reinterpret_cast<std::uint64_t>(&queueId);
+    updateAttributes.value = reinterpret_cast<std::uint64_t>(&m_socketFileDescriptor);
+    checkErrors(bpf(BPF_MAP_UPDATE_ELEM, updateAttributes), -1);
+
+    const std::array<bpf_insn, 24> program = makeRedirectProgram(m_mapFileDescriptor, m_port);
+    static constexpr char license[] = "GPL";
+    bpf_attr programAttributes{};
+    programAttributes.prog_type = BPF_PROG_TYPE_XDP;
+    programAttributes.expected_attach_type = BPF_XDP;
+    programAttributes.insns = reinterpret_cast<std::uint64_t>(program.data());
+    programAttributes.insn_cnt = program.size();
+    programAttributes.license = reinterpret_cast<std::uint64_t>(license);
+    m_programFileDescriptor = bpf(BPF_PROG_LOAD, programAttributes);
+    checkErrors(m_programFileDescriptor, -1);
+
+    // Link is owned by this process, so program is detached even if we crash
+    bpf_attr linkAttributes{};
+    linkAttributes.link_create.prog_fd = m_programFileDescriptor;
+    linkAttributes.link_create.target_ifindex = interfaceIndex;
+    linkAttributes.link_create.attach_type = BPF_XDP;
+    linkAttributes.link_create.flags = XDP_FLAGS_SKB_MODE;
+    m_linkFileDescriptor = bpf(BPF_LINK_CREATE, linkAttributes);
+    checkErrors(m_linkFileDescriptor, -1);
+}
+
+const std::uint8_t* udpPayloadOf(const std::uint8_t* frame, std::uint32_t length, std::size_t& outPayloadSize) {
+    if(length < HEADERS_SIZE) {
+        return nullptr;
+    }
+    const udphdr& udpHeader = *reinterpret_cast<const udphdr*>(frame + ETHERNET_HEADER_SIZE + IP_HEADER_SIZE);
+    const std::size_t udpLength = ::ntohs(udpHeader.len);
+    if(udpLength < sizeof(udphdr) || ETHERNET_HEADER_SIZE + IP_HEADER_SIZE + udpLength > length) {
+        return nullptr;
+    }
+    outPayloadSize = udpLength - sizeof(udphdr);
+    return frame + HEADERS_SIZE;
+}
+
+} // namespace Common
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Common.h"
+
+namespace Common {
+
+/* Credit window of A -> B link in shared memory, counted in bytes so it works for transports without message boundaries.
+ * ComponentB grants bytes back when it finished with a buffer, ComponentA consumes them when it writes,
+ * so granted - sent bytes never exceed window and ComponentA never blocks inside of transport write.
+ * Both counters are cumulative, restarted ComponentB forgets everything in flight by granting up to sent,
+ * ComponentA moves sent up to granted whenever granted overtakes it, so granted never exceeds sent
+ * */
+class CreditWindow {
+    struct Counters {
+        alignas(64) std::uint64_t countBytesSent;
+        alignas(64) std::uint64_t countBytesGranted;
+    };
+
+    std::string m_name;
+    SocketRole m_role = SocketRole::Connect;
+    Counters* m_counters = nullptr;
+    std::size_t m_windowBytes = 0;
+    std::uint64_t m_countBytesSent = 0;
+    std::uint64_t m_countBytesGranted = 0;
+
+    void resyncSent();
+    bool fits(std::size_t countBytes) const;
+
+public:
+    // Listening side (ComponentB) grants, connecting side (ComponentA) consumes
+    CreditWindow(std::string_view name, std::size_t windowBytes, SocketRole role);
+    ~CreditWindow();
+
+    CreditWindow(const CreditWindow&) = delete;
+    CreditWindow& operator=(const CreditWindow&) = delete;
+    CreditWindow(CreditWindow&& other) noexcept;
+    CreditWindow& operator=(CreditWindow&& other) noexcept;
+
+    // Takes credits for countBytes if there are enough of them
+    bool tryConsume(std::size_t countBytes);
+    void grant(std::size_t countBytes);
+};
+
+enum class CreditPolicy {
+    // Message which doesn't fit into window is thrown away
+    DropNewest,
+    // Messages wait for credits in bounded backlog, the oldest one is thrown away when backlog is full
+    DropOldest,
+    // Only the latest message waits for credits, it replaces the waiting one
+    Conflate
+};
+
+// Throws std::invalid_argument for unknown names
+CreditPolicy creditPolicyFromString(std::string_view name);
+
+struct CreditCounters {
+    std::atomic_uint64_t countSent = 0;
+    std::atomic_uint64_t countDroppedNewest = 0;
+    std::atomic_uint64_t countDroppedOldest = 0;
+    std::atomic_uint64_t countConflated = 0;
+};
+
+/* Writer of A -> B link which never waits for ComponentB: when credits run out messages are handled by policy */
+template<LinkWriter Transport>
+class CreditedWriter {
+    Transport& m_transport;
+    CreditWindow& m_creditWindow;
+    CreditPolicy m_policy;
+    // Ring of messages waiting for credits, vectors keep their capacity, so steady state does not allocate
+    std::vector<std::vector<std::uint8_t>> m_backlog;
+    std::size_t m_backlogHead = 0;
+    std::size_t m_backlogSize = 0;
+    CreditCounters& m_counters;
+
+    void addToBacklog(std::span<const std::uint8_t> bufferToWrite);
+    void sendBacklog();
+
+    template<typename Message>
+    void writeBatch(std::span<const Message> messages);
+
+    static std::span<const std::uint8_t> bytesOf(const std::vector<std::uint8_t>& message) { return message; }
+    static std::span<const std::uint8_t> bytesOf(const Buffer* message) { return {message->data.data(), message->countBytes}; }
+
+    static void increment(std::atomic_uint64_t& counter, std::uint64_t value = 1) {
+        // Single writer, counters are only read by reporting thread
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+public:
+    CreditedWriter(Transport& transport, CreditWindow& creditWindow, CreditPolicy policy, std::size_t backlogSize, std::size_t maxMessageSize, CreditCounters& counters);
+
+    void write(const std::vector<std::uint8_t>& bufferToWrite);
+    void write(std::span<const std::vector<std::uint8_t>> buffersToWrite);
+    void write(std::span<Buffer* const> buffersToWrite);
+
+    // Sends waiting messages if credits came back, returns true if something is still waiting
+    bool flush();
+};
+
+template<LinkWriter Transport>
+CreditedWriter<Transport>::CreditedWriter(Transport& transport, CreditWindow& creditWindow, CreditPolicy policy, std::size_t backlogSize, std::size_t maxMessageSize, CreditCounters& counters)
+    : m_transport(transport),
+    m_creditWindow(creditWindow),
+    m_policy(policy),
+    m_backlog(policy == CreditPolicy::Conflate ? 1 : backlogSize),
+    m_counters(counters) {
+    NET_ASSERT(!m_backlog.empty());
+    for(std::vector<std::uint8_t>& message : m_backlog) {
+        message.reserve(maxMessageSize);
+    }
+}
+
+template<LinkWriter Transport>
+void CreditedWriter<Transport>::addToBacklog(std::span<const std::uint8_t> bufferToWrite) {
+    if(m_backlogSize == m_backlog.size()) {
+        if(m_policy == CreditPolicy::Conflate) {
+            increment(m_counters.countConflated);
+        } else {
+            increment(m_counters.countDroppedOldest);
+        }
+        m_backlogHead = (m_backlogHead + 1) % m_backlog.size();
+        --m_backlogSize;
+    }
+    m_backlog[(m_backlogHead + m_backlogSize) % m_backlog.size()].assign(bufferToWrite.begin(), bufferToWrite.end());
+    ++m_backlogSize;
+}
+
+template<LinkWriter Transport>
+void CreditedWriter<Transport>::sendBacklog() {
+    while(m_backlogSize > 0 && m_creditWindow.tryConsume(m_backlog[m_backlogHead].size())) {
+        m_transport.write(m_backlog[m_backlogHead]);
+        increment(m_counters.countSent);
+        m_backlogHead = (m_backlogHead + 1) % m_backlog.size();
+        --m_backlogSize;
+    }
+}
+
+template<LinkWriter Transport>
+void CreditedWriter<Transport>::write(const std::vector<std::uint8_t>& bufferToWrite) {
+    write(std::span<const std::vector<std::uint8_t>>(&bufferToWrite, 1));
+}
+
+template<LinkWriter Transport>
+void CreditedWriter<Transport>::write(std::span<const std::vector<std::uint8_t>> buffersToWrite) {
+    writeBatch(buffersToWrite);
+}
+
+template<LinkWriter Transport>
+void CreditedWriter<Transport>::write(std::span<Buffer* const> buffersToWrite) {
+    writeBatch(buffersToWrite);
+}
+
+template<LinkWriter Transport>
+template<typename Message>
+void CreditedWriter<Transport>::writeBatch(std::span<const Message> messages) {
+    sendBacklog();
+    // Messages are never reordered, so nothing bypasses backlog
+    std::size_t countCredited = 0;
+    while(m_backlogSize == 0 && countCredited < messages.size() && m_creditWindow.tryConsume(bytesOf(messages[countCredited]).size())) {
+        ++countCredited;
+    }
+    if(countCredited > 0) {
+        m_transport.write(messages.first(countCredited));
+        increment(m_counters.countSent, countCredited);
+    }
+
+    const std::span<const Message> rest = messages.subspan(countCredited);
+    if(m_policy == CreditPolicy::DropNewest) {
+        increment(m_counters.countDroppedNewest, rest.size());
+        return;
+    }
+    for(const Message& message : rest) {
+        addToBacklog(bytesOf(message));
+    }
+}
+
+template<LinkWriter Transport>
+bool CreditedWriter<Transport>::flush() {
+    sendBacklog();
+    return m_backlogSize > 0;
+}
+
+} // namespace Common
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "Common.h"
+
+namespace Common {
+
+/* Picks size of the next batch of a stage from depth of the queue in front of it.
+ * Empty queue keeps batch at minimum, so at low rates every datagram is handled as soon as it arrives.
+ * Batch doubles while queue holds more than one batch and halves when it drains below half of a batch,
+ * so under load syscalls and queue operations are amortized over more datagrams
+ * */
+class BatchController {
+    std::size_t m_minBatchSize = 1;
+    std::size_t m_maxBatchSize = 1;
+    // Written only by the stage, atomic so reporting thread can read it
+    std::atomic_size_t m_batchSize = 1;
+
+public:
+    BatchController(std::size_t minBatchSize, std::size_t maxBatchSize);
+
+    std::size_t next(std::size_t queueDepth);
+
+    std::size_t batchSize() const { return m_batchSize.load(std::memory_order_relaxed); }
+    std::size_t maxBatchSize() const { return m_maxBatchSize; }
+};
+
+/* Receives datagrams into buffers of the pool and puts them in process, several at once with single recvmmsg when batch allows it.
+ * Single read peeks size of datagram and takes buffer of its size class, sizes of datagrams of a burst are unknown,
+ * so burst takes buffers of the biggest size class. When none of them is free, datagram is read alone into buffer of its size class,
+ * so the smaller classes keep taking datagrams under load. Buffers left empty by short burst stay with reader for the next read:
+ * queue of used buffers has consumer as its only producer, so reader can't return them there and never sends them downstream
+ * */
+class BatchedUdpReader {
+    NetworkReaderWriter<ProtocolType::UDP> m_readerUdp;
+    std::vector<mmsghdr> m_messages;
+    std::vector<iovec> m_ioVectors;
+    std::vector<Buffer*> m_burstBuffers;
+    std::vector<Buffer*> m_spareBuffers;
+    std::atomic_uint64_t m_countTruncated = 0;
+
+    Buffer* tryAcquire(ThreadSafeQueueBuffer& threadSafeQueueBuffer, std::size_t minimumSize);
+    Buffer& acquire(ThreadSafeQueueBuffer& threadSafeQueueBuffer, std::size_t minimumSize);
+    // Peeks size of the next datagram and reads it into buffer of its size class
+    std::size_t readSingle(ThreadSafeQueueBuffer& threadSafeQueueBuffer);
+
+public:
+    BatchedUdpReader(std::uint16_t port, std::size_t maxBatchSize);
+
+    BatchedUdpReader(const BatchedUdpReader&) = delete;
+    BatchedUdpReader& operator=(const BatchedUdpReader&) = delete;
+
+    /* Waits for at least one datagram, reads up to batchSize of them and puts them in process, returns count of read datagrams.
+     * Datagram bigger than the biggest size class is truncated by burst read, it is dropped and counted
+     * */
+    std::size_t read(ThreadSafeQueueBuffer& threadSafeQueueBuffer, std::size_t batchSize);
+
+    std::uint64_t countTruncated() const { return m_countTruncated.load(std::memory_order_relaxed); }
+};
+
+} // namespace Common
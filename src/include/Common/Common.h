@@ -1,56 +1,204 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <climits>
+#include <concepts>
 #include <cstring>
 #include <cstdint>
+#include <map>
+#include <span>
+#include <string>
 #include <thread>
 #include <vector>
 
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <unistd.h>
 
+#include "readerwritercircularbuffer.h"
 #include "readerwriterqueue.h"
+#include "MpmcRing.h"
+#include "SpscRing.h"
 
 namespace Common {
 
 struct Buffer {
     std::vector<std::uint8_t> data;
     std::size_t countBytes = 0;
+    // Order of receiving, set only when buffers are processed out of order and merged back
+    std::uint64_t sequenceNumber = 0;
 };
 
-using LockFreeSPSCQueueT = moodycamel::ReaderWriterQueue<Buffer*>;
+// Queues of buffer pointers which ThreadSafeQueueBuffer can be built on, "Benchmarks queue" compares them
+using MoodycamelQueueT = moodycamel::ReaderWriterQueue<Buffer*>;
+using CircularBufferQueueT = moodycamel::BlockingReaderWriterCircularBuffer<Buffer*>;
+using RingQueueT = SpscRing<Buffer*>;
+using LockFreeSPSCQueueT = RingQueueT;
+// For pools shared by more than one producer or consumer
+using LockFreeMPMCQueueT = MpmcRing<Buffer*>;
+
+enum class OverflowPolicy {
+    // Producer waits until consumer returns a buffer
+    Block,
+    // Producer reclaims the oldest buffer which is waiting for consumer
+    DropOldest,
+    // Producer reads into scratch buffer which is thrown away on enqueue
+    DropNewest
+};
+
+// Throws std::invalid_argument for unknown names
+OverflowPolicy overflowPolicyFromString(std::string_view name);
+
+struct OverflowCounters {
+    std::atomic_uint64_t countBlocked = 0;
+    std::atomic_uint64_t countDroppedOldest = 0;
+    std::atomic_uint64_t countDroppedNewest = 0;
+};
 
-class ThreadSafeQueueBuffer {
+struct SizeClass {
+    std::size_t bufferSize = 0;
+    std::size_t countBuffers = 0;
+};
+
+/* Pool of buffers passed from single producer to single consumer and back.
+ * Buffers are split into size classes, producer asks for the size it needs and gets the smallest free buffer which fits it.
+ * When producer finds no such buffer, overflow policy decides who loses data, every decision is counted.
+ * Queue is any single producer single consumer queue of Buffer* with interface of moodycamel queues,
+ * implementation is instantiated in Common.cpp for MoodycamelQueueT, CircularBufferQueueT and RingQueueT.
+ * With LockFreeMPMCQueueT any number of threads might produce and consume, overflow policy must be Block then:
+ * reclaimed and scratch buffers belong to single producer
+ * */
+template<typename Queue>
+class BasicThreadSafeQueueBuffer {
+    static constexpr bool isShared = requires { Queue::isMultiProducerMultiConsumer; };
+
+    // Sorted by size class, so size class of a buffer is known from its position
     std::vector<Buffer> buffers;
-    LockFreeSPSCQueueT queueUsed;
-    LockFreeSPSCQueueT queueInProcess;
+    std::vector<SizeClass> sizeClasses;
+    std::vector<std::size_t> sizeClassEnds;
+    std::vector<Queue> queuesUsed;
+    Queue queueInProcess;
+    OverflowPolicy overflowPolicy = OverflowPolicy::Block;
+    // Only with DropOldest: producer dequeues from queueInProcess too, so both sides of it take the lock
+    std::atomic_flag inProcessLock;
+    // Only with DropOldest: reclaimed buffers too small for the request, owned by producer until it needs them
+    std::vector<Buffer*> reclaimedBuffers;
+    Buffer scratchBuffer;
+    OverflowCounters overflowCounters;
+
+    static Buffer& dequeue(Queue& queue);
+    static void enqueue(Queue& queue, Buffer* buffer);
+    static void enqueueBulk(Queue& queue, std::span<Buffer* const> buffers);
+    // Takes buffers which are already in queue, up to size of buffers, returns count of taken
+    static std::size_t tryDequeueBulk(Queue& queue, std::span<Buffer*> buffers);
+    static void increment(std::atomic_uint64_t& counter);
+    static std::size_t countBuffersOf(const std::vector<SizeClass>& sizeClasses);
+
+    std::size_t sizeClassOf(const Buffer* buffer) const;
+    bool tryDequeueReadyToUse(std::size_t minimumSize, Buffer*& buffer);
+    bool tryTakeReclaimed(std::size_t minimumSize, Buffer*& buffer);
+    bool tryDequeueInProcessLocked(Buffer*& buffer);
+    Buffer& dequeueReadyToUseOnOverflow(std::size_t minimumSize);
+
+public:
+    BasicThreadSafeQueueBuffer(std::size_t defaultBufferSize, std::size_t countBuffers, OverflowPolicy overflowPolicy = OverflowPolicy::Block);
+    // Size classes are sorted by buffer size
+    explicit BasicThreadSafeQueueBuffer(std::vector<SizeClass> sizeClasses, OverflowPolicy overflowPolicy = OverflowPolicy::Block);
+
+    // Returns the smallest free buffer with at least minimumSize bytes, minimumSize must fit into the biggest size class
+    Buffer& dequeueReadyToUse(std::size_t minimumSize = 0);
+    // Returns nullptr instead of waiting or applying overflow policy, for producers which take extra buffers only when they are free
+    Buffer* tryDequeueReadyToUse(std::size_t minimumSize);
+    void enqueueUsed(Buffer* buffer) { enqueue(queuesUsed[sizeClassOf(buffer)], buffer); }
+
+    Buffer& dequeueInProcess();
+    // Returns nullptr instead of waiting, for consumers which share the pool and can't rely on countInProcess
+    Buffer* tryDequeueInProcess();
+    void enqueueInProcess(Buffer* buffer);
+
+    /* Bulk versions for stages which handle bursts: dequeue waits for at least one buffer and takes as many as are
+     * already there (up to size of buffers), returns count of taken buffers. Burst needs no size_approx polling between
+     * buffers, DropOldest lock is taken once per burst and single size class skips lookup.
+     * Queues with bulk operations (RingQueueT) publish the whole burst with single index update
+     * */
+    std::size_t dequeueInProcess(std::span<Buffer*> buffers);
+    void enqueueInProcess(std::span<Buffer* const> buffers);
+    void enqueueUsed(std::span<Buffer* const> buffers);
+
+    std::size_t countToUse() const;
+    std::size_t capacityToUse() const;
+    std::size_t countInProcess() const { return queueInProcess.size_approx(); }
+    std::size_t capacityInProcess() const { return queueInProcess.max_capacity(); }
+    std::size_t maxBufferSize() const { return sizeClasses.empty() ? 0 : sizeClasses.back().bufferSize; }
+
+    const OverflowCounters& counters() const { return overflowCounters; }
+};
 
-    static Buffer& dequeue(LockFreeSPSCQueueT& queue);
-    static void enqueue(LockFreeSPSCQueueT& queue, Buffer* buffer);
+using ThreadSafeQueueBuffer = BasicThreadSafeQueueBuffer<LockFreeSPSCQueueT>;
+using SharedThreadSafeQueueBuffer = BasicThreadSafeQueueBuffer<LockFreeMPMCQueueT>;
+
+/* Waiting of threads which poll lock-free queues and have nothing to block on: yields first, so work which comes right away
+ * is picked up without delay, then sleeps with interval doubled on every wait up to maximum, so idle thread doesn't burn a core.
+ * Caller resets it whenever it found work
+ * */
+class Backoff {
+    std::size_t m_countYields = 0;
+    std::size_t m_countYielded = 0;
+    std::chrono::microseconds m_maxSleepInterval;
+    std::chrono::microseconds m_sleepInterval{0};
 
 public:
-    ThreadSafeQueueBuffer(std::size_t defaultBufferSize, std::size_t countBuffers);
+    explicit Backoff(std::size_t countYields = 64, std::chrono::microseconds maxSleepInterval = std::chrono::microseconds(1000));
 
-    Buffer& dequeueReadyToUse() { return dequeue(queueUsed); }
-    void enqueueUsed(Buffer* buffer) { enqueue(queueUsed, buffer); }
+    void wait();
+    void reset();
 
-    Buffer& dequeueInProcess() { return dequeue(queueInProcess); }
-    void enqueueInProcess(Buffer* buffer) { enqueue(queueInProcess, buffer); }
+    // Interval of the last sleep, 0 while still yielding
+    std::chrono::microseconds sleepInterval() const { return m_sleepInterval; }
+};
 
-    std::size_t countToUse() const { return queueUsed.size_approx(); }
-    std::size_t capacityToUse() const { return queueUsed.max_capacity(); }
-    std::size_t countInProcess() const { return queueInProcess.size_approx(); }
-    std::size_t capacityInProcess() const { return queueInProcess.max_capacity(); }
+/* Lock-free reorder buffer: any thread publishes a buffer stamped with sequence number, single consumer takes them strictly in order.
+ * Slot of a buffer is its sequence number modulo capacity, so capacity must be at least count of buffers in flight
+ * */
+class ReorderBuffer {
+    // Every slot has its own cache line, neighbouring sequence numbers are published by different threads
+    struct alignas(64) Slot {
+        std::atomic<Buffer*> buffer = nullptr;
+    };
+
+    std::vector<Slot> m_slots;
+    std::uint64_t m_nextSequenceNumber = 0;
+
+public:
+    explicit ReorderBuffer(std::size_t capacity);
+
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+    ReorderBuffer(ReorderBuffer&& other) noexcept;
+    ReorderBuffer& operator=(ReorderBuffer&& other) noexcept;
+
+    void publish(Buffer* buffer);
+    // Returns buffer with the next sequence number if it was published already, otherwise nullptr
+    Buffer* tryTake();
+
+    std::size_t capacity() const { return m_slots.size(); }
 };
 
 class NamedPipe {
     std::string m_pipePath;
 
+    void write(const std::uint8_t* data, std::size_t countBytes);
+
 public:
     explicit NamedPipe(std::string_view pipePath);
     ~NamedPipe();
@@ -61,11 +209,228 @@ public:
     NamedPipe& operator=(NamedPipe&& other) noexcept;
 
     void write(const std::vector<std::uint8_t>& bufferToWrite);
+    void write(std::span<const std::vector<std::uint8_t>> buffersToWrite);
+    // Writes first countBytes of every buffer, so filled buffers are sent without copying them into vectors
+    void write(std::span<Buffer* const> buffersToWrite);
+    void read(Buffer& buffer);
+    // Pipe has no message boundaries, so batch read fills only first buffer
+    std::size_t read(std::span<Buffer*> buffers);
+};
+
+/* Zero copy mode of named pipe: writer gifts page aligned slots to the pipe with vmsplice, so data is referenced by the pipe
+ * instead of being copied into it. Slot must stay untouched until reader consumed it, that's why slots are owned by the pipe
+ * and acquire() hands out the next slot only when pipe has drained past it (tracked with FIONREAD).
+ * Both ends keep descriptor open, otherwise pipe and its raised capacity would be destroyed between writes
+ * */
+class SplicePipe {
+    std::string m_pipePath;
+    std::size_t m_pipeCapacity = 0;
+    int m_fileDescriptor = -1;
+    std::uint8_t* m_slots = nullptr;
+    std::size_t m_slotSize = 0;
+    std::size_t m_countSlots = 0;
+    std::size_t m_nextSlot = 0;
+    // Slot is free when count of bytes consumed by reader reaches its ticket
+    std::vector<std::uint64_t> m_slotTickets;
+    std::uint64_t m_countBytesWritten = 0;
+
+    void open(int flags);
+    void close();
+    std::uint64_t countBytesConsumed() const;
+    void write(const std::uint8_t* data, std::size_t countBytes);
+
+public:
+    SplicePipe(std::string_view pipePath, std::size_t pipeCapacity, std::size_t slotSize, std::size_t countSlots);
+    ~SplicePipe();
+
+    SplicePipe(const SplicePipe&) = delete;
+    SplicePipe& operator=(const SplicePipe&) = delete;
+    SplicePipe(SplicePipe&& other) noexcept;
+    SplicePipe& operator=(SplicePipe&& other) noexcept;
+
+    // Waits until next slot is consumed by reader and returns it for filling
+    std::span<std::uint8_t> acquire();
+    // Hands first countBytes of acquired slot to the pipe
+    void gift(std::size_t countBytes);
+
+    // Copies into slot and gifts it, for callers which already have data in their own memory
+    void write(const std::vector<std::uint8_t>& bufferToWrite);
+    void write(std::span<const std::vector<std::uint8_t>> buffersToWrite);
+    void write(std::span<Buffer* const> buffersToWrite);
+    void read(Buffer& buffer);
+    std::size_t read(std::span<Buffer*> buffers);
+};
+
+enum class SocketRole {
+    Listen,
+    Connect
+};
+
+/* Connection between components over local socket.
+ * Listening side accepts lazily on read, connecting side connects lazily on write and both reconnect if peer goes away
+ * */
+class ConnectedSocket {
+    SocketRole m_role = SocketRole::Connect;
+    int m_socketType = 0;
+    sockaddr_storage m_address{};
+    socklen_t m_addressLength = 0;
+    int m_listenFileDescriptor = -1;
+    std::vector<iovec> m_ioVectors;
+    std::vector<mmsghdr> m_messageHeaders;
+
+    void configure(int socketDescriptor) const;
+    void disconnect();
+    // Sends messages described by m_ioVectors
+    void sendMessages();
+
+protected:
+    int m_socketFileDescriptor = -1;
+
+    ConnectedSocket(int socketType, const sockaddr_storage& address, socklen_t addressLength, SocketRole role);
+    ~ConnectedSocket();
+
+    ConnectedSocket(ConnectedSocket&& other) noexcept;
+    ConnectedSocket& operator=(ConnectedSocket&& other) noexcept;
+
+    void ensureConnected();
+
+public:
+    ConnectedSocket(const ConnectedSocket&) = delete;
+    ConnectedSocket& operator=(const ConnectedSocket&) = delete;
+
+    void write(const std::vector<std::uint8_t>& bufferToWrite);
+    // Sends every buffer as separate message with single sendmmsg
+    void write(std::span<const std::vector<std::uint8_t>> buffersToWrite);
+    void write(std::span<Buffer* const> buffersToWrite);
     void read(Buffer& buffer);
+    // Waits for at least one message and receives as many as available into buffers with single recvmmsg, returns count of filled buffers
+    std::size_t read(std::span<Buffer*> buffers);
+    // Descriptor which becomes readable when read would not wait: listening socket until the peer connects, then the connection
+    int pollDescriptor() const { return m_socketFileDescriptor != -1 ? m_socketFileDescriptor : m_listenFileDescriptor; }
+};
+
+/* Unix domain SOCK_SEQPACKET socket, unlike pipe it preserves message boundaries, so every read returns exactly one write */
+class UnixSeqPacketSocket : public ConnectedSocket {
+    std::string m_socketPath;
+
+public:
+    UnixSeqPacketSocket(std::string_view socketPath, SocketRole role);
+    ~UnixSeqPacketSocket();
+
+    UnixSeqPacketSocket(UnixSeqPacketSocket&& other) noexcept = default;
+    UnixSeqPacketSocket& operator=(UnixSeqPacketSocket&& other) noexcept = default;
+
+    // Passes file descriptor (eg. memfd with buffers) to peer with SCM_RIGHTS
+    void sendDescriptor(int fileDescriptor);
+    int receiveDescriptor();
+};
+
+/* TCP over loopback with Nagle disabled, stream has no message boundaries, same as pipe */
+class LoopbackTcpSocket : public ConnectedSocket {
+public:
+    LoopbackTcpSocket(std::uint16_t port, SocketRole role);
+};
+
+/* Single producer single consumer queue of messages in POSIX shared memory, messages keep their boundaries.
+ * Both sides map the same object and exchange only two indices on separate cache lines, each side caches index of the other one
+ * and reloads it only when queue looks full (writer) or empty (reader).
+ * Listening side (reader) removes the object on destruction, after restart of ComponentB ComponentA has to be restarted too
+ * */
+class SharedMemoryQueue {
+    struct Header {
+        alignas(64) std::uint64_t writeIndex;
+        alignas(64) std::uint64_t readIndex;
+    };
+
+    std::string m_name;
+    SocketRole m_role = SocketRole::Connect;
+    void* m_mapping = nullptr;
+    std::size_t m_mappingSize = 0;
+    Header* m_header = nullptr;
+    std::uint8_t* m_data = nullptr;
+    std::size_t m_capacity = 0;
+    std::uint64_t m_writeIndex = 0;
+    std::uint64_t m_readIndex = 0;
+    std::uint64_t m_cachedWriteIndex = 0;
+    std::uint64_t m_cachedReadIndex = 0;
+
+    void writeRecord(const std::uint8_t* data, std::size_t countBytes);
+    void publish();
+
+public:
+    // Capacity must be power of two, biggest message must fit in half of it
+    SharedMemoryQueue(std::string_view name, std::size_t capacity, SocketRole role);
+    ~SharedMemoryQueue();
+
+    SharedMemoryQueue(const SharedMemoryQueue&) = delete;
+    SharedMemoryQueue& operator=(const SharedMemoryQueue&) = delete;
+    SharedMemoryQueue(SharedMemoryQueue&& other) noexcept;
+    SharedMemoryQueue& operator=(SharedMemoryQueue&& other) noexcept;
+
+    void write(const std::vector<std::uint8_t>& bufferToWrite);
+    // Publishes whole batch with single index update
+    void write(std::span<const std::vector<std::uint8_t>> buffersToWrite);
+    void write(std::span<Buffer* const> buffersToWrite);
+    void read(Buffer& buffer);
+    std::size_t read(std::span<Buffer*> buffers);
+};
+
+/* Everything which is able to carry filtered prices from ComponentA to ComponentB.
+ * Component loops are templated on it, so transport calls are resolved at compile time
+ * */
+template<typename T>
+concept LinkWriter = requires(T transport, const std::vector<std::uint8_t>& bufferToWrite, std::span<const std::vector<std::uint8_t>> buffersToWrite, std::span<Buffer* const> filledBuffers) {
+    transport.write(bufferToWrite);
+    transport.write(buffersToWrite);
+    transport.write(filledBuffers);
+};
+
+template<typename T>
+concept LinkReader = requires(T transport, Buffer& buffer, std::span<Buffer*> buffers) {
+    transport.read(buffer);
+    { transport.read(buffers) } -> std::same_as<std::size_t>;
 };
 
 template<typename T>
-void checkErrors(const T value, const T badValue) {
+concept LinkTransport = LinkWriter<T> && LinkReader<T>;
+
+static_assert(LinkTransport<NamedPipe>);
+static_assert(LinkTransport<SplicePipe>);
+static_assert(LinkTransport<UnixSeqPacketSocket>);
+static_assert(LinkTransport<LoopbackTcpSocket>);
+static_assert(LinkTransport<SharedMemoryQueue>);
+
+enum class TransportType {
+    Fifo,
+    FifoSplice,
+    UnixSocket,
+    SharedMemory,
+    LoopbackTcp
+};
+
+// Throws std::invalid_argument for unknown names
+TransportType transportTypeFromString(std::string_view name);
+
+/* Parses command line as positional arguments followed by "--name value" options */
+class CommandLineOptions {
+    std::vector<std::string_view> m_positional;
+    std::map<std::string_view, std::string_view> m_options;
+
+public:
+    // Throws std::invalid_argument if option has no value
+    CommandLineOptions(int argc, char* argv[]);
+
+    std::size_t countPositional() const { return m_positional.size(); }
+    std::string_view positional(std::size_t index) const { return m_positional.at(index); }
+
+    std::string_view get(std::string_view name, std::string_view defaultValue) const;
+    // True if there are no options except known
+    bool containsOnly(std::initializer_list<std::string_view> knownNames) const;
+};
+
+// Value and bad value might differ in type (eg. ssize_t result and -1 literal)
+template<typename T, typename U>
+void checkErrors(const T value, const U badValue) {
     if(value == badValue) {
         throw std::system_error(errno, std::generic_category());
     }
@@ -86,9 +451,36 @@ enum class ProtocolType {
     UDP
 };
 
+enum class TcpProfile {
+    // Socket as kernel creates it, Nagle is on
+    Kernel,
+    // Nagle is off, for writers which batch small messages themselves
+    NoDelay,
+    // Nagle is off, little unsent data is queued in small send buffer and acks are never delayed
+    Latency,
+    // Corked: partial segments wait in kernel until they are full or pushed
+    Throughput
+};
+
+// Throws std::invalid_argument for unknown names
+TcpProfile tcpProfileFromString(std::string_view name);
+
+struct TcpTuning {
+    TcpProfile profile = TcpProfile::Kernel;
+    // Only for latency profile, 0 keeps kernel defaults
+    int sendBufferSize = 0;
+    int notSentLowWatermark = 0;
+};
+
 template<ProtocolType Protocol>
 class NetworkReaderWriter {
-    int m_socketFileDescriptor = 0;
+    int m_socketFileDescriptor = -1;
+    // Socket options are applied again to the socket created by reConnect
+    TcpTuning m_tcpTuning;
+
+    int setOption(int level, int name, int value) const;
+    // Acks are delayed again after every read, so quick ack has to be renewed
+    void renewQuickAck() const;
 
     static sockaddr_in getAddressStructHelper(std::uint16_t port);
 
@@ -108,9 +500,24 @@ public:
 
     int bind(std::uint16_t port) const;
     int reConnect(std::uint16_t port, std::string_view ipv4);
+    // Applies options of the profile, returns -1 if one of them failed
+    int setTcpTuning(const TcpTuning& tcpTuning);
+    // Sends partial segments held back by cork, does nothing for other profiles
+    int push() const;
+    // Returns true if write would not block, with latency profile only while unsent data is below low watermark
+    bool waitWritable(int timeoutMilliseconds) const;
 
     std::int64_t read(std::vector<std::uint8_t>& bufferToRead) const;
+    // Same as read, but returns -1 with EAGAIN instead of waiting when nothing is available
+    std::int64_t tryRead(std::vector<std::uint8_t>& bufferToRead) const;
+    // TCP returns only when everything is sent or -1 if connection failed, UDP sends single datagram
     std::int64_t write(std::vector<std::uint8_t>& dataToSend) const;
+    // Waits for the next datagram and returns its full size without reading it
+    std::int64_t peekSize() const;
+    // Returns true if read would not block, waits at most timeoutMilliseconds (-1 waits forever)
+    bool waitReadable(int timeoutMilliseconds) const;
+    // For callers multiplexing this socket with other descriptors
+    int fileDescriptor() const { return m_socketFileDescriptor; }
 };
 
 template<ProtocolType Protocol>
@@ -124,7 +531,7 @@ sockaddr_in NetworkReaderWriter<Protocol>::getAddressStructHelper(std::uint16_t
 }
 
 template<>
-int NetworkReaderWriter<ProtocolType::UDP>::bind(int socketDescriptor, std::uint16_t port) {
+inline int NetworkReaderWriter<ProtocolType::UDP>::bind(int socketDescriptor, std::uint16_t port) {
     sockaddr_in serverAddress = getAddressStructHelper(port);
     const int result = ::bind(socketDescriptor, reinterpret_cast<sockaddr*>(&serverAddress), sizeof(serverAddress));
     NET_CHECK(result, -1);
@@ -132,7 +539,7 @@ int NetworkReaderWriter<ProtocolType::UDP>::bind(int socketDescriptor, std::uint
 }
 
 template<>
-int NetworkReaderWriter<ProtocolType::TCP>::connect(int socketDescriptor, std::uint16_t port, std::string_view ipv4) {
+inline int NetworkReaderWriter<ProtocolType::TCP>::connect(int socketDescriptor, std::uint16_t port, std::string_view ipv4) {
     sockaddr_in serverAddress = getAddressStructHelper(port);
     const int resultInetPton = ::inet_pton(AF_INET, ipv4.data(), &serverAddress.sin_addr);
     NET_CHECK(resultInetPton, -1);
@@ -149,45 +556,160 @@ template<ProtocolType Protocol>
 NetworkReaderWriter<Protocol>& NetworkReaderWriter<Protocol>::operator=(NetworkReaderWriter&& other) noexcept {
     if(this != &other) {
         m_socketFileDescriptor = other.m_socketFileDescriptor;
-        other.m_socketFileDescriptor = 0;
+        other.m_socketFileDescriptor = -1;
+        m_tcpTuning = other.m_tcpTuning;
     }
     return *this;
 }
 
 template<ProtocolType Protocol>
 NetworkReaderWriter<Protocol>::~NetworkReaderWriter() {
-    ::close(m_socketFileDescriptor);
+    if(m_socketFileDescriptor != -1) {
+        ::close(m_socketFileDescriptor);
+    }
 }
 
 template<>
-int NetworkReaderWriter<ProtocolType::UDP>::bind(std::uint16_t port) const {
+inline int NetworkReaderWriter<ProtocolType::UDP>::bind(std::uint16_t port) const {
     return NetworkReaderWriter::bind(m_socketFileDescriptor, port);
 }
 
+template<ProtocolType Protocol>
+int NetworkReaderWriter<Protocol>::setOption(int level, int name, int value) const {
+    const int result = ::setsockopt(m_socketFileDescriptor, level, name, &value, sizeof(value));
+    NET_CHECK(result, -1);
+    return result;
+}
+
+template<ProtocolType Protocol>
+void NetworkReaderWriter<Protocol>::renewQuickAck() const {
+    if constexpr (Protocol == ProtocolType::TCP) {
+        if(m_tcpTuning.profile == TcpProfile::Latency) {
+            setOption(IPPROTO_TCP, TCP_QUICKACK, 1);
+        }
+    }
+}
+
+template<>
+inline int NetworkReaderWriter<ProtocolType::TCP>::setTcpTuning(const TcpTuning& tcpTuning) {
+    m_tcpTuning = tcpTuning;
+    int result = 0;
+    switch(m_tcpTuning.profile) {
+        case TcpProfile::Kernel:
+            break;
+        case TcpProfile::NoDelay:
+            result = setOption(IPPROTO_TCP, TCP_NODELAY, 1);
+            break;
+        case TcpProfile::Latency:
+            result = std::min(result, setOption(IPPROTO_TCP, TCP_NODELAY, 1));
+            result = std::min(result, setOption(IPPROTO_TCP, TCP_QUICKACK, 1));
+            if(m_tcpTuning.sendBufferSize > 0) {
+                result = std::min(result, setOption(SOL_SOCKET, SO_SNDBUF, m_tcpTuning.sendBufferSize));
+            }
+            if(m_tcpTuning.notSentLowWatermark > 0) {
+                // Socket is writable only while unsent data is below watermark, blocking write waits for that too
+                result = std::min(result, setOption(IPPROTO_TCP, TCP_NOTSENT_LOWAT, m_tcpTuning.notSentLowWatermark));
+            }
+            break;
+        case TcpProfile::Throughput:
+            result = setOption(IPPROTO_TCP, TCP_CORK, 1);
+            break;
+    }
+    return result;
+}
+
 template<>
-int NetworkReaderWriter<ProtocolType::TCP>::reConnect(std::uint16_t port, std::string_view ipv4) {
-    close(m_socketFileDescriptor);
+inline int NetworkReaderWriter<ProtocolType::TCP>::push() const {
+    if(m_tcpTuning.profile != TcpProfile::Throughput) {
+        return 0;
+    }
+    // Removing cork sends whatever is held back, next writes are corked again
+    const int result = setOption(IPPROTO_TCP, TCP_CORK, 0);
+    return std::min(result, setOption(IPPROTO_TCP, TCP_CORK, 1));
+}
+
+template<>
+inline int NetworkReaderWriter<ProtocolType::TCP>::reConnect(std::uint16_t port, std::string_view ipv4) {
+    // Object which was never connected has no descriptor yet
+    if(m_socketFileDescriptor != -1) {
+        ::close(m_socketFileDescriptor);
+    }
     const int socketDescriptor = ::socket(AF_INET, SOCK_STREAM, 0);
     NET_CHECK(socketDescriptor, -1);
     const int result = NetworkReaderWriter::connect(socketDescriptor, port, ipv4);
     m_socketFileDescriptor = socketDescriptor;
+    setTcpTuning(m_tcpTuning);
     return result;
 }
 
 template<ProtocolType Protocol>
 std::int64_t NetworkReaderWriter<Protocol>::read(std::vector<std::uint8_t>& bufferToRead) const {
     const ssize_t readBytes = ::read(m_socketFileDescriptor, bufferToRead.data(), bufferToRead.size());
+    if(readBytes > 0) {
+        renewQuickAck();
+    }
+    return readBytes;
+}
+
+template<ProtocolType Protocol>
+std::int64_t NetworkReaderWriter<Protocol>::tryRead(std::vector<std::uint8_t>& bufferToRead) const {
+    const ssize_t readBytes = ::recv(m_socketFileDescriptor, bufferToRead.data(), bufferToRead.size(), MSG_DONTWAIT);
+    if(readBytes > 0) {
+        renewQuickAck();
+    }
     return readBytes;
 }
 
+template<ProtocolType Protocol>
+bool NetworkReaderWriter<Protocol>::waitReadable(int timeoutMilliseconds) const {
+    pollfd pollDescriptor{m_socketFileDescriptor, POLLIN, 0};
+    const int resultPoll = ::poll(&pollDescriptor, 1, timeoutMilliseconds);
+    NET_CHECK(resultPoll, -1);
+    return resultPoll > 0;
+}
+
+template<ProtocolType Protocol>
+bool NetworkReaderWriter<Protocol>::waitWritable(int timeoutMilliseconds) const {
+    pollfd pollDescriptor{m_socketFileDescriptor, POLLOUT, 0};
+    const int resultPoll = ::poll(&pollDescriptor, 1, timeoutMilliseconds);
+    NET_CHECK(resultPoll, -1);
+    return resultPoll > 0;
+}
+
 template<ProtocolType Protocol>
 std::int64_t NetworkReaderWriter<Protocol>::write(std::vector<std::uint8_t>& dataToSend) const {
-    const ssize_t result = ::send(m_socketFileDescriptor, dataToSend.data(), dataToSend.size(), MSG_NOSIGNAL);
-    return result;
+    if constexpr (Protocol == ProtocolType::UDP) {
+        const ssize_t result = ::send(m_socketFileDescriptor, dataToSend.data(), dataToSend.size(), MSG_NOSIGNAL);
+        return result;
+    }
+    // Stream might take only part of data (signal, send buffer full), the rest is sent once socket is writable again
+    std::size_t countBytesSent = 0;
+    while(countBytesSent < dataToSend.size()) {
+        const ssize_t result = ::send(m_socketFileDescriptor, dataToSend.data() + countBytesSent, dataToSend.size() - countBytesSent, MSG_NOSIGNAL);
+        if(result == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                waitWritable(-1);
+                continue;
+            }
+            return -1;
+        }
+        countBytesSent += static_cast<std::size_t>(result);
+    }
+    return static_cast<std::int64_t>(countBytesSent);
+}
+
+template<>
+inline std::int64_t NetworkReaderWriter<ProtocolType::UDP>::peekSize() const {
+    // MSG_TRUNC makes recv return real size of datagram even though nothing is copied
+    const ssize_t datagramSize = ::recv(m_socketFileDescriptor, nullptr, 0, MSG_PEEK | MSG_TRUNC);
+    return datagramSize;
 }
 
 template<>
-NetworkReaderWriter<ProtocolType::UDP>::NetworkReaderWriter(std::uint16_t port) {
+inline NetworkReaderWriter<ProtocolType::UDP>::NetworkReaderWriter(std::uint16_t port) {
     const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
     NET_CHECK(socketDescriptor, -1);
     NetworkReaderWriter::bind(socketDescriptor, port);
@@ -195,7 +717,7 @@ NetworkReaderWriter<ProtocolType::UDP>::NetworkReaderWriter(std::uint16_t port)
 }
 
 template<>
-NetworkReaderWriter<ProtocolType::TCP>::NetworkReaderWriter(std::uint16_t port, std::string_view ipv4Address) {
+inline NetworkReaderWriter<ProtocolType::TCP>::NetworkReaderWriter(std::uint16_t port, std::string_view ipv4Address) {
     reConnect(port, ipv4Address);
 }
 
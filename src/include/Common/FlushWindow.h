@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Common.h"
+
+namespace Common {
+
+enum class FlushReason {
+    // Window holds threshold bytes
+    Size,
+    // The oldest message waited for max delay
+    Deadline
+};
+
+struct FlushCounters {
+    std::atomic_uint64_t countFlushedBySize = 0;
+    std::atomic_uint64_t countFlushedByDeadline = 0;
+};
+
+/* Collects small messages to external server, so they leave with single write once window holds thresholdBytes
+ * or the oldest of them waited for maxDelay, whichever comes first. Zero delay flushes at the end of every batch,
+ * so at idle nothing waits. Socket must have Nagle disabled, otherwise kernel adds its own delay on top
+ * */
+class FlushWindow {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    std::vector<std::uint8_t> m_pending;
+    std::size_t m_thresholdBytes = 0;
+    std::chrono::microseconds m_maxDelay{0};
+    Clock::time_point m_deadline;
+    FlushCounters& m_counters;
+
+    static void increment(std::atomic_uint64_t& counter) {
+        // Single writer, counters are only read by reporting thread
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+public:
+    FlushWindow(std::size_t thresholdBytes, std::chrono::microseconds maxDelay, FlushCounters& counters);
+
+    void append(std::span<const std::uint8_t> message);
+
+    bool isEmpty() const { return m_pending.empty(); }
+    bool isFull() const { return m_pending.size() >= m_thresholdBytes; }
+    // Empty window never expires
+    bool isExpired(Clock::time_point now) const { return !m_pending.empty() && now >= m_deadline; }
+    Clock::time_point deadline() const { return m_deadline; }
+
+    // Bytes for single write, cleared by flushed once they are written
+    std::vector<std::uint8_t>& pending() { return m_pending; }
+    void flushed(FlushReason reason);
+};
+
+} // namespace Common
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace Common {
+
+/* Bounded multi producer multi consumer ring (Vyukov), lock-free for any number of threads on both sides.
+ * Every cell carries a sequence number which tells whose turn it is: producer of position p waits for sequence p,
+ * consumer of position p waits for p + 1, and consumer hands the cell to the next lap with p + size.
+ * Positions only grow, so a stale producer or consumer can never mistake a reused cell for its own (no ABA).
+ * Storage is rounded up to power of two, max_capacity reports requested capacity, which callers keep by design
+ * (eg. pool never has more buffers than that), the ring itself takes up to storage size.
+ * Interface follows moodycamel queues, so the ring can back ThreadSafeQueueBuffer
+ * */
+template<typename T>
+class MpmcRing {
+    static_assert(std::is_trivially_copyable_v<T>, "MpmcRing copies values without constructing them");
+
+    struct alignas(64) Cell {
+        std::atomic_size_t sequence = 0;
+        T value{};
+    };
+
+    alignas(64) std::atomic_size_t m_enqueuePosition = 0;
+    alignas(64) std::atomic_size_t m_dequeuePosition = 0;
+    alignas(64) std::size_t m_capacity = 0;
+    std::size_t m_mask = 0;
+    std::unique_ptr<Cell[]> m_cells;
+
+    void swapPositions(std::atomic_size_t& left, std::atomic_size_t& right) {
+        const std::size_t position = left.load(std::memory_order_relaxed);
+        left.store(right.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        right.store(position, std::memory_order_relaxed);
+    }
+
+public:
+    // Both sides may be used by any number of threads
+    static constexpr bool isMultiProducerMultiConsumer = true;
+
+    explicit MpmcRing(std::size_t capacity)
+        : m_capacity(capacity),
+        m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1),
+        m_cells(std::make_unique<Cell[]>(m_mask + 1)) {
+        for(std::size_t position = 0; position <= m_mask; ++position) {
+            m_cells[position].sequence.store(position, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+    // Moving is meant for setup only (eg. vector of rings), neither of rings may be used by other threads meanwhile
+    MpmcRing(MpmcRing&& other) noexcept {
+        *this = std::move(other);
+    }
+    MpmcRing& operator=(MpmcRing&& other) noexcept {
+        if(this != &other) {
+            swapPositions(m_enqueuePosition, other.m_enqueuePosition);
+            swapPositions(m_dequeuePosition, other.m_dequeuePosition);
+            std::swap(m_capacity, other.m_capacity);
+            std::swap(m_mask, other.m_mask);
+            std::swap(m_cells, other.m_cells);
+        }
+        return *this;
+    }
+
+    bool try_enqueue(T value) {
+        std::size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        while(true) {
+            Cell& cell = m_cells[position & m_mask];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if(difference == 0) {
+                if(m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if(difference < 0) {
+                // Consumer of the previous lap hasn't freed the cell yet, ring is full
+                return false;
+            } else {
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_dequeue(T& value) {
+        std::size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+        while(true) {
+            Cell& cell = m_cells[position & m_mask];
+            const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            const std::intptr_t difference = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+            if(difference == 0) {
+                if(m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if(difference < 0) {
+                // Producer of this position hasn't published yet, ring is empty
+                return false;
+            } else {
+                position = m_dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t size_approx() const {
+        // Dequeue position first: enqueue position never falls behind it
+        const std::size_t dequeuePosition = m_dequeuePosition.load(std::memory_order_acquire);
+        return m_enqueuePosition.load(std::memory_order_acquire) - dequeuePosition;
+    }
+
+    std::size_t max_capacity() const { return m_capacity; }
+};
+
+} // namespace Common
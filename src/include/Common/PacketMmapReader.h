@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+#include <linux/if_packet.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <poll.h>
+
+#include "Common.h"
+
+namespace Common {
+
+/* Receives UDP datagrams for a single port from a PACKET_MMAP TPACKET_V3 ring bound to an interface.
+ * Payloads are handed out as pointers into the ring, so they stay valid only inside the callback
+ * */
+class PacketMmapReader {
+    int m_socketFileDescriptor = -1;
+    // Keeps the port reserved, otherwise the kernel answers every datagram with ICMP port unreachable
+    int m_udpFileDescriptor = -1;
+    std::uint8_t* m_ring = nullptr;
+    std::size_t m_blockSize = 0;
+    std::size_t m_countBlocks = 0;
+    std::size_t m_currentBlock = 0;
+    std::uint16_t m_port = 0;
+
+    tpacket_block_desc& blockDescriptor(std::size_t index) const {
+        return *reinterpret_cast<tpacket_block_desc*>(m_ring + index * m_blockSize);
+    }
+
+    // Returns payload of the datagram if it is an unfragmented UDP datagram for our port, otherwise nullptr
+    const std::uint8_t* parseUdpPayload(const tpacket3_hdr& header, std::size_t& outPayloadSize) const;
+
+public:
+    PacketMmapReader(std::string_view interfaceName, std::uint16_t port, std::size_t blockSize, std::size_t countBlocks, std::uint32_t blockTimeoutMilliseconds);
+    ~PacketMmapReader();
+
+    PacketMmapReader(const PacketMmapReader&) = delete;
+    PacketMmapReader& operator=(const PacketMmapReader&) = delete;
+    PacketMmapReader(PacketMmapReader&& other) noexcept;
+    PacketMmapReader& operator=(PacketMmapReader&& other) noexcept;
+
+    /* Waits for the next retired block and calls onPayload(const std::uint8_t* data, std::size_t size)
+     * for every matching datagram in it, then gives the block back to the kernel.
+     * Returns count of delivered datagrams, 0 on timeout
+     * */
+    template<typename Callback>
+    std::size_t readBatch(Callback&& onPayload, int timeoutMilliseconds = -1);
+};
+
+template<typename Callback>
+std::size_t PacketMmapReader::readBatch(Callback&& onPayload, int timeoutMilliseconds) {
+    tpacket_block_desc& block = blockDescriptor(m_currentBlock);
+    std::atomic_ref<std::uint32_t> blockStatus(block.hdr.bh1.block_status);
+    while((blockStatus.load(std::memory_order_acquire) & TP_STATUS_USER) == 0) {
+        pollfd pollDescriptor{m_socketFileDescriptor, POLLIN | POLLERR, 0};
+        const int resultPoll = ::poll(&pollDescriptor, 1, timeoutMilliseconds);
+        NET_CHECK(resultPoll, -1);
+        if(resultPoll == 0) {
+            return 0;
+        }
+    }
+
+    std::size_t countDelivered = 0;
+    const std::uint32_t countPackets = block.hdr.bh1.num_pkts;
+    const std::uint8_t* packet = reinterpret_cast<const std::uint8_t*>(&block) + block.hdr.bh1.offset_to_first_pkt;
+    for(std::uint32_t i = 0; i < countPackets; ++i) {
+        const tpacket3_hdr& header = *reinterpret_cast<const tpacket3_hdr*>(packet);
+        std::size_t payloadSize = 0;
+        const std::uint8_t* payload = parseUdpPayload(header, payloadSize);
+        if(payload != nullptr) {
+            onPayload(payload, payloadSize);
+            ++countDelivered;
+        }
+        packet += header.tp_next_offset;
+    }
+
+    blockStatus.store(TP_STATUS_KERNEL, std::memory_order_release);
+    m_currentBlock = (m_currentBlock + 1) % m_countBlocks;
+    return countDelivered;
+}
+
+} // namespace Common
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace Common {
+
+/* Fixed capacity single producer single consumer ring for handoff of small values (eg. Buffer pointers).
+ * Storage is rounded up to power of two and indices run freely, so position in the ring is index & mask,
+ * ring is full at requested capacity.
+ * Every index has its own cache line and each side keeps a cached copy of the other side's index, which is reloaded
+ * only when ring looks full (producer) or empty (consumer), so in steady state an operation touches the shared line
+ * of the other side once per lap instead of once per value.
+ * Interface follows moodycamel queues, so rings and moodycamel queues are interchangeable in ThreadSafeQueueBuffer
+ * */
+template<typename T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRing copies values without constructing them");
+
+    alignas(64) std::atomic_size_t m_writeIndex = 0;
+    alignas(64) std::size_t m_cachedReadIndex = 0;
+    alignas(64) std::atomic_size_t m_readIndex = 0;
+    alignas(64) std::size_t m_cachedWriteIndex = 0;
+    alignas(64) std::size_t m_capacity = 0;
+    std::size_t m_mask = 0;
+    std::unique_ptr<T[]> m_slots;
+
+public:
+    explicit SpscRing(std::size_t capacity)
+        : m_capacity(capacity),
+        m_mask(std::bit_ceil(std::max<std::size_t>(capacity, 1)) - 1),
+        m_slots(std::make_unique<T[]>(m_mask + 1)) {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+    // Moving is meant for setup only (eg. vector of rings), neither of rings may be used by other threads meanwhile
+    SpscRing(SpscRing&& other) noexcept {
+        *this = std::move(other);
+    }
+    SpscRing& operator=(SpscRing&& other) noexcept {
+        if(this != &other) {
+            const std::size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+            m_writeIndex.store(other.m_writeIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.m_writeIndex.store(writeIndex, std::memory_order_relaxed);
+            const std::size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+            m_readIndex.store(other.m_readIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            other.m_readIndex.store(readIndex, std::memory_order_relaxed);
+            std::swap(m_cachedReadIndex, other.m_cachedReadIndex);
+            std::swap(m_cachedWriteIndex, other.m_cachedWriteIndex);
+            std::swap(m_capacity, other.m_capacity);
+            std::swap(m_mask, other.m_mask);
+            std::swap(m_slots, other.m_slots);
+        }
+        return *this;
+    }
+
+    bool try_enqueue(T value) {
+        const std::size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        if(writeIndex - m_cachedReadIndex >= m_capacity) {
+            m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+            if(writeIndex - m_cachedReadIndex >= m_capacity) {
+                return false;
+            }
+        }
+        m_slots[writeIndex & m_mask] = value;
+        m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_dequeue(T& value) {
+        const std::size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        if(readIndex == m_cachedWriteIndex) {
+            m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+            if(readIndex == m_cachedWriteIndex) {
+                return false;
+            }
+        }
+        value = m_slots[readIndex & m_mask];
+        m_readIndex.store(readIndex + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes up to countMax values which are already there with single release of read index, returns count of taken
+    std::size_t try_dequeue_bulk(T* values, std::size_t countMax) {
+        const std::size_t readIndex = m_readIndex.load(std::memory_order_relaxed);
+        if(m_cachedWriteIndex - readIndex < countMax) {
+            m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+        }
+        const std::size_t countTaken = std::min(m_cachedWriteIndex - readIndex, countMax);
+        for(std::size_t i = 0; i < countTaken; ++i) {
+            values[i] = m_slots[(readIndex + i) & m_mask];
+        }
+        if(countTaken > 0) {
+            m_readIndex.store(readIndex + countTaken, std::memory_order_release);
+        }
+        return countTaken;
+    }
+
+    // Puts all values with single release of write index if there is room for all of them, otherwise nothing
+    bool try_enqueue_bulk(const T* values, std::size_t count) {
+        const std::size_t writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        if(writeIndex + count - m_cachedReadIndex > m_capacity) {
+            m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+            if(writeIndex + count - m_cachedReadIndex > m_capacity) {
+                return false;
+            }
+        }
+        for(std::size_t i = 0; i < count; ++i) {
+            m_slots[(writeIndex + i) & m_mask] = values[i];
+        }
+        m_writeIndex.store(writeIndex + count, std::memory_order_release);
+        return true;
+    }
+
+    std::size_t size_approx() const {
+        // Read index first: write index never falls behind it
+        const std::size_t readIndex = m_readIndex.load(std::memory_order_acquire);
+        return m_writeIndex.load(std::memory_order_acquire) - readIndex;
+    }
+
+    std::size_t max_capacity() const { return m_capacity; }
+};
+
+} // namespace Common
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+#include <linux/if_xdp.h>
+#include <poll.h>
+
+#include "Common.h"
+
+namespace Common {
+
+/* Receives UDP datagrams for a single port from an AF_XDP socket in generic (SKB, copy) mode,
+ * so it works on lo or veth without driver support. A tiny XDP program redirects only our port
+ * to the socket, everything else goes to the kernel stack as usual.
+ * UMEM frames are the buffer pool of this backend: payload is filtered in place inside of the frame
+ * and the frame goes straight back to the fill ring, no Buffer is involved
+ * */
+/* Ring shared with the kernel: indexes run freely and wrap by mask, descriptors are xdp_desc (rx) or frame addresses (fill) */
+struct XdpRing {
+    std::uint32_t* producer = nullptr;
+    std::uint32_t* consumer = nullptr;
+    void* descriptors = nullptr;
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    std::uint32_t mask = 0;
+};
+
+// Returns UDP payload of the frame or nullptr if headers don't fit into length, program already checked their contents
+const std::uint8_t* udpPayloadOf(const std::uint8_t* frame, std::uint32_t length, std::size_t& outPayloadSize);
+
+/* Calls onPayload for every descriptor of rx ring up to produced and gives their frames back through fill ring,
+ * frames of invalid datagrams too. Kernel might hand out address inside of a frame (headroom), fill ring takes its start.
+ * Returns count of delivered datagrams
+ * */
+template<typename Callback>
+std::size_t consumeRxRing(XdpRing& rxRing, XdpRing& fillRing, std::uint32_t produced, const std::uint8_t* umem, std::size_t frameSize, Callback&& onPayload) {
+    const std::uint32_t rxConsumer = *rxRing.consumer;
+    const xdp_desc* rxDescriptors = static_cast<const xdp_desc*>(rxRing.descriptors);
+    std::uint64_t* fillDescriptors = static_cast<std::uint64_t*>(fillRing.descriptors);
+    std::uint32_t fillProducer = *fillRing.producer;
+    std::size_t countDelivered = 0;
+    for(std::uint32_t index = rxConsumer; index != produced; ++index) {
+        const xdp_desc& descriptor = rxDescriptors[index & rxRing.mask];
+        std::size_t payloadSize = 0;
+        const std::uint8_t* payload = udpPayloadOf(umem + descriptor.addr, descriptor.len, payloadSize);
+        if(payload != nullptr) {
+            onPayload(payload, payloadSize);
+            ++countDelivered;
+        }
+        // Fill ring has room for every frame, so returning frame can't fail
+        fillDescriptors[fillProducer & fillRing.mask] = descriptor.addr - descriptor.addr % frameSize;
+        ++fillProducer;
+    }
+
+    std::atomic_ref<std::uint32_t>(*fillRing.producer).store(fillProducer, std::memory_order_release);
+    std::atomic_ref<std::uint32_t>(*rxRing.consumer).store(produced, std::memory_order_release);
+    return countDelivered;
+}
+
+class XdpReader {
+    int m_socketFileDescriptor = -1;
+    int m_mapFileDescriptor = -1;
+    int m_programFileDescriptor = -1;
+    int m_linkFileDescriptor = -1;
+    std::uint8_t* m_umem = nullptr;
+    std::size_t m_umemSize = 0;
+    std::size_t m_frameSize = 0;
+    XdpRing m_rxRing;
+    XdpRing m_fillRing;
+    std::uint16_t m_port = 0;
+
+    void close();
+    void createSocket(std::uint32_t countFrames);
+    void attachProgram(unsigned int interfaceIndex, std::uint32_t queueId);
+
+public:
+    // Throws if AF_XDP or bpf is not available, so caller is able to fall back to the socket backend
+    XdpReader(std::string_view interfaceName, std::uint16_t port, std::uint32_t queueId, std::uint32_t countFrames, std::size_t frameSize);
+    ~XdpReader();
+
+    XdpReader(const XdpReader&) = delete;
+    XdpReader& operator=(const XdpReader&) = delete;
+    XdpReader(XdpReader&& other) noexcept;
+    XdpReader& operator=(XdpReader&& other) noexcept;
+
+    /* Waits for received datagrams and calls onPayload(const std::uint8_t* data, std::size_t size) for each of them,
+     * then gives all frames back to the kernel. Returns count of delivered datagrams, 0 on timeout
+     * */
+    template<typename Callback>
+    std::size_t readBatch(Callback&& onPayload, int timeoutMilliseconds = -1);
+};
+
+template<typename Callback>
+std::size_t XdpReader::readBatch(Callback&& onPayload, int timeoutMilliseconds) {
+    std::atomic_ref<std::uint32_t> rxProducer(*m_rxRing.producer);
+    std::uint32_t produced = rxProducer.load(std::memory_order_acquire);
+    if(produced == *m_rxRing.consumer) {
+        pollfd pollDescriptor{m_socketFileDescriptor, POLLIN, 0};
+        const int resultPoll = ::poll(&pollDescriptor, 1, timeoutMilliseconds);
+        NET_CHECK(resultPoll, -1);
+        // Timeout, or poll was interrupted
+        if(resultPoll <= 0) {
+            return 0;
+        }
+        produced = rxProducer.load(std::memory_order_acquire);
+    }
+    return consumeRxRing(m_rxRing, m_fillRing, produced, m_umem, m_frameSize, onPayload);
+}
+
+} // namespace Common
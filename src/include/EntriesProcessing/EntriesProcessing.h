@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstring>
+#include <span>
 #include <vector>
 
 #include "Common.h"
@@ -11,6 +16,28 @@ namespace Processing {
  * */
 bool filterEntries(const Common::Buffer& entries, std::vector<std::uint8_t>& outPrices, std::uint8_t eofMarker);
 
+/* Same as above, but works on raw memory (eg. datagram payload inside of a receive ring) */
+bool filterEntries(const std::uint8_t* entries, std::size_t countBytes, std::vector<std::uint8_t>& outPrices, std::uint8_t eofMarker);
+
+/* Same as above, but writes prices to raw memory (eg. slot which is gifted to pipe afterwards),
+ * outPrices must have room for (countBytes + 1) / 2 prices
+ * */
+bool filterEntries(const std::uint8_t* entries, std::size_t countBytes, std::uint8_t* outPrices, std::size_t& outCountPrices, std::uint8_t eofMarker);
+
+/* In place mode: prices are compacted to the front of entries and countBytes becomes count of prices,
+ * so entries buffer is written to transport directly. On failure countBytes is 0
+ * */
+bool filterEntries(Common::Buffer& entries, std::uint8_t eofMarker);
+
+/* Multi record mode: datagram holds several records (price volume ... EOFMarker) one after another.
+ * Prices of all records are written one after another and outRecordEnds gets count of prices written after every record.
+ * Returns count of records, bytes after the last EOF marker are skipped. outPrices might be entries itself
+ * */
+std::size_t filterRecords(const std::uint8_t* entries, std::size_t countBytes, std::uint8_t* outPrices, std::size_t& outCountPrices, std::vector<std::size_t>& outRecordEnds, std::uint8_t eofMarker);
+
+/* Same as above in place, countBytes of entries becomes count of prices of all records */
+std::size_t filterRecords(Common::Buffer& entries, std::vector<std::size_t>& outRecordEnds, std::uint8_t eofMarker);
+
 /* Filters prices with custom predicate */
 template<typename Predicate>
 void filterPrices(const Common::Buffer& allPrices, std::vector<std::vector<std::uint8_t>>& goodPrices, std::size_t messageLength, Predicate&& goodPricePredicate) {
@@ -25,4 +52,173 @@ void filterPrices(const Common::Buffer& allPrices, std::vector<std::vector<std::
     }
 }
 
-}
\ No newline at end of file
+/* Message of a price is MessageLength copies of it, so there are only 256 messages and all of them are built at compile time */
+template<std::size_t MessageLength>
+constexpr std::array<std::array<std::uint8_t, MessageLength>, 256> makeMessageTable() {
+    std::array<std::array<std::uint8_t, MessageLength>, 256> messages{};
+    for(std::size_t price = 0; price < messages.size(); ++price) {
+        messages[price].fill(static_cast<std::uint8_t>(price));
+    }
+    return messages;
+}
+
+template<std::size_t MessageLength>
+inline constexpr std::array<std::array<std::uint8_t, MessageLength>, 256> MESSAGE_TABLE = makeMessageTable<MessageLength>();
+
+template<std::size_t MessageLength>
+std::span<const std::uint8_t, MessageLength> messageOf(std::uint8_t price) {
+    return MESSAGE_TABLE<MessageLength>[price];
+}
+
+/* Same as filterPrices, but messages are copied from the table one after another into outMessages,
+ * which must have room for MessageLength bytes per price. Returns count of messages
+ * */
+template<std::size_t MessageLength, typename Predicate>
+requires std::predicate<Predicate&, std::uint8_t>
+std::size_t filterPricesToMessages(const Common::Buffer& allPrices, std::uint8_t* outMessages, Predicate&& goodPricePredicate) {
+    std::size_t countMessages = 0;
+    for(std::size_t i = 0; i < allPrices.countBytes; ++i) {
+        const std::uint8_t price = allPrices.data[i];
+        if(goodPricePredicate(price)) {
+            std::memcpy(outMessages + countMessages * MessageLength, MESSAGE_TABLE<MessageLength>[price].data(), MessageLength);
+            ++countMessages;
+        }
+    }
+    return countMessages;
+}
+
+/* Predicate of a price evaluated once for every byte value, so any predicate (range, set, bands) costs one table lookup
+ * and 32 prices are looked up at once with pshufb. Kernel is picked by instructionSet() of CPU, not by build flags,
+ * on CPU without SSSE3 prices are looked up one by one
+ * */
+class PriceBitmap {
+    // Bit price % 8 of byte price / 8
+    std::array<std::uint8_t, 32> m_bits{};
+    // Indexed by low nibble of price, bit h is set if price with high nibble h (or h + 8 for the second table) is good
+    std::array<std::uint8_t, 16> m_rowsBelow128{};
+    std::array<std::uint8_t, 16> m_rowsFrom128{};
+
+public:
+    PriceBitmap() = default;
+
+    template<typename Predicate>
+    requires std::predicate<Predicate&, std::uint8_t>
+    explicit PriceBitmap(Predicate&& goodPricePredicate) {
+        for(std::size_t price = 0; price < 256; ++price) {
+            if(!goodPricePredicate(static_cast<std::uint8_t>(price))) {
+                continue;
+            }
+            m_bits[price >> 3] |= static_cast<std::uint8_t>(1U << (price & 7));
+            std::array<std::uint8_t, 16>& rows = price < 128 ? m_rowsBelow128 : m_rowsFrom128;
+            rows[price & 0x0f] |= static_cast<std::uint8_t>(1U << ((price >> 4) & 7));
+        }
+    }
+
+    bool contains(std::uint8_t price) const { return ((m_bits[price >> 3] >> (price & 7)) & 1U) != 0; }
+
+    const std::array<std::uint8_t, 16>& rowsBelow128() const { return m_rowsBelow128; }
+    const std::array<std::uint8_t, 16>& rowsFrom128() const { return m_rowsFrom128; }
+};
+
+/* Kernels built for instruction sets above the default SSE2 with target attributes, so they are used without NATIVE_ARCH */
+enum class InstructionSet : std::uint8_t { Scalar, Ssse3, Avx2 };
+
+/* The widest instruction set CPU supports, checked once */
+InstructionSet instructionSet();
+
+constexpr std::size_t PRICE_BLOCK_SIZE = 32;
+
+/* Bit i of outMasks[b] is set if price i of 32 byte block b is in bitmap, kernel must be supported by CPU */
+void goodPriceMasks(const std::uint8_t* prices, std::size_t countBlocks, const PriceBitmap& goodPrices, std::uint32_t* outMasks,
+                    InstructionSet kernel);
+
+/* Same as filterPricesToMessages with predicate, prices are looked up in bitmap a chunk of blocks at a time */
+template<std::size_t MessageLength>
+std::size_t filterPricesToMessages(const Common::Buffer& allPrices, std::uint8_t* outMessages, const PriceBitmap& goodPrices) {
+    const InstructionSet kernel = instructionSet();
+    if(kernel == InstructionSet::Scalar) {
+        // Without pshufb mask of block is built price by price, plain loop is faster
+        return filterPricesToMessages<MessageLength>(allPrices, outMessages, [&goodPrices](std::uint8_t price) {
+            return goodPrices.contains(price);
+        });
+    }
+    constexpr std::size_t CHUNK_BLOCKS = 64;
+    std::array<std::uint32_t, CHUNK_BLOCKS> masks;
+    const std::uint8_t* prices = allPrices.data.data();
+    std::size_t countMessages = 0;
+    std::size_t i = 0;
+    while(i + PRICE_BLOCK_SIZE <= allPrices.countBytes) {
+        const std::size_t countBlocks = std::min(CHUNK_BLOCKS, (allPrices.countBytes - i) / PRICE_BLOCK_SIZE);
+        goodPriceMasks(prices + i, countBlocks, goodPrices, masks.data(), kernel);
+        for(std::size_t block = 0; block < countBlocks; ++block, i += PRICE_BLOCK_SIZE) {
+            for(std::uint32_t mask = masks[block]; mask != 0; mask &= mask - 1) {
+                const std::uint8_t price = prices[i + static_cast<std::size_t>(__builtin_ctz(mask))];
+                std::memcpy(outMessages + countMessages * MessageLength, MESSAGE_TABLE<MessageLength>[price].data(), MessageLength);
+                ++countMessages;
+            }
+        }
+    }
+    for(; i < allPrices.countBytes; ++i) {
+        if(goodPrices.contains(prices[i])) {
+            std::memcpy(outMessages + countMessages * MessageLength, MESSAGE_TABLE<MessageLength>[prices[i]].data(), MessageLength);
+            ++countMessages;
+        }
+    }
+    return countMessages;
+}
+
+constexpr std::size_t ENTRY_BLOCK_SIZE = 32;
+
+struct EntryBlockMasks {
+    // Bit i is set if price of entry i is EOF marker
+    std::uint32_t eof = 0;
+    // Bit i is set if price of entry i is above threshold
+    std::uint32_t good = 0;
+};
+
+/* Masks of 32 entries (64 bytes) */
+EntryBlockMasks entryBlockMasks(const std::uint8_t* entries, std::uint8_t thresholdPrice, std::uint8_t eofMarker);
+
+/* Fused filterEntries and filterPricesToMessages with price > thresholdPrice: goes from datagram straight to messages
+ * in one pass, 32 entries at a time. outMessages must have room for MessageLength bytes per entry.
+ * On failure (no EOF marker) outCountMessages is 0
+ * */
+template<std::size_t MessageLength>
+bool filterEntriesToMessages(const std::uint8_t* entries, std::size_t countBytes, std::uint8_t* outMessages, std::size_t& outCountMessages, std::uint8_t thresholdPrice, std::uint8_t eofMarker) {
+    outCountMessages = 0;
+    if(countBytes < 3) {
+        return false;
+    }
+
+    std::size_t countMessages = 0;
+    const auto append = [outMessages, &countMessages](std::uint8_t price) {
+        std::memcpy(outMessages + countMessages * MessageLength, MESSAGE_TABLE<MessageLength>[price].data(), MessageLength);
+        ++countMessages;
+    };
+    std::size_t i = 0;
+    for(; i + 2 * ENTRY_BLOCK_SIZE <= countBytes; i += 2 * ENTRY_BLOCK_SIZE) {
+        const EntryBlockMasks masks = entryBlockMasks(entries + i, thresholdPrice, eofMarker);
+        // Only entries before the first EOF marker count
+        const std::uint32_t beforeEof = masks.eof == 0 ? ~0U : (masks.eof & -masks.eof) - 1;
+        for(std::uint32_t mask = masks.good & beforeEof; mask != 0; mask &= mask - 1) {
+            append(entries[i + 2 * static_cast<std::size_t>(__builtin_ctz(mask))]);
+        }
+        if(masks.eof != 0) {
+            outCountMessages = countMessages;
+            return true;
+        }
+    }
+    for(; i < countBytes; i += 2) {
+        const std::uint8_t price = entries[i];
+        if(price == eofMarker) {
+            outCountMessages = countMessages;
+            return true;
+        }
+        if(price > thresholdPrice) {
+            append(price);
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "Common.h"
+
+namespace Processing {
+
+/* Spreads filtering of multi record datagrams over worker threads without reordering them.
+ * Single thread submits received buffers and takes filtered ones: submit stamps sequence number and puts buffer
+ * into queue shared by workers, so a worker stuck on a fat datagram doesn't hold up the next ones.
+ * Workers filter records in place and publish buffers into reorder buffer,
+ * take returns them strictly in submit order. Buffer which failed validation comes back with countBytes 0
+ * */
+class FilterWorkers {
+    Common::LockFreeMPMCQueueT m_queue;
+    Common::ReorderBuffer m_reorderBuffer;
+    std::vector<std::thread> m_threads;
+    std::atomic_bool m_stopped = false;
+    std::uint64_t m_nextSequenceNumber = 0;
+    std::uint8_t m_eofMarker = 0;
+
+    void worker();
+
+public:
+    // Capacity is max count of buffers submitted but not taken yet
+    FilterWorkers(std::size_t countWorkers, std::size_t capacity, std::uint8_t eofMarker);
+    ~FilterWorkers();
+
+    FilterWorkers(const FilterWorkers&) = delete;
+    FilterWorkers& operator=(const FilterWorkers&) = delete;
+
+    void submit(Common::Buffer* entries);
+    // Returns the next buffer in submit order if it is filtered already, otherwise nullptr
+    Common::Buffer* tryTake() { return m_reorderBuffer.tryTake(); }
+
+    std::size_t countWorkers() const { return m_threads.size(); }
+};
+
+} // namespace Processing
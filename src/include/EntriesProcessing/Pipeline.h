@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <tuple>
+#include <utility>
+
+#include "EntriesProcessing.h"
+
+namespace Processing {
+
+/* Stages of a pipeline are composed at compile time, so the compiler inlines all of them into the loop of the source
+ * and prices travel from stage to stage in registers, there are no intermediate buffers and no pass per stage.
+ * Source calls emit(price) for every price of input and returns false if input is invalid.
+ * Stage calls next(price) for prices which go on (zero, one or several times), the last stage writes to output.
+ * Parameters known at compile time (eg. from Settings) are template parameters of stages
+ * */
+
+// Source: entries (price volume ... EOFMarker), same rules as filterEntries
+template<std::uint8_t EofMarker>
+struct Deinterleave {
+    template<typename Emit>
+    bool operator()(const std::uint8_t* entries, std::size_t countBytes, Emit&& emit) const {
+        if(countBytes < 3) {
+            return false;
+        }
+        for(std::size_t i = 0; i < countBytes; i += 2) {
+            if(entries[i] == EofMarker) {
+                return true;
+            }
+            emit(entries[i]);
+        }
+        return false;
+    }
+};
+
+// Source: prices which are already filtered out of entries
+struct PriceStream {
+    template<typename Emit>
+    bool operator()(const std::uint8_t* prices, std::size_t countBytes, Emit&& emit) const {
+        for(std::size_t i = 0; i < countBytes; ++i) {
+            emit(prices[i]);
+        }
+        return true;
+    }
+};
+
+// Passes prices above threshold
+template<auto ThresholdPrice>
+struct Threshold {
+    template<typename Price, typename Next>
+    void operator()(Price price, Next&& next) const {
+        if(price > ThresholdPrice) {
+            next(price);
+        }
+    }
+};
+
+// Passes prices for which predicate (eg. PriceBitmap lookup) returns true, for parameters known only at runtime
+template<typename Predicate>
+struct Select {
+    Predicate goodPricePredicate;
+
+    template<typename Price, typename Next>
+    void operator()(Price price, Next&& next) const {
+        if(goodPricePredicate(price)) {
+            next(price);
+        }
+    }
+};
+
+// Last stage: appends message of a price from the table to output
+template<std::size_t MessageLength>
+struct Expand {
+    template<typename Output>
+    void operator()(std::uint8_t price, Output& output) const {
+        output.append(messageOf<MessageLength>(price));
+    }
+};
+
+// Output which writes to raw memory, caller makes sure there is room for everything
+struct MessageStream {
+    std::uint8_t* data = nullptr;
+    std::size_t countBytes = 0;
+
+    template<std::size_t Extent>
+    void append(std::span<const std::uint8_t, Extent> bytes) {
+        std::memcpy(data + countBytes, bytes.data(), bytes.size());
+        countBytes += bytes.size();
+    }
+};
+
+template<typename Source, typename... Stages>
+class Pipeline {
+    static_assert(sizeof...(Stages) > 0, "Pipeline needs at least a stage which writes to output");
+
+    Source m_source;
+    std::tuple<Stages...> m_stages;
+
+    template<std::size_t Index, typename Price, typename Output>
+    void push(Price price, Output& output) const {
+        if constexpr(Index + 1 == sizeof...(Stages)) {
+            std::get<Index>(m_stages)(price, output);
+        } else {
+            std::get<Index>(m_stages)(price, [this, &output](auto nextPrice) {
+                push<Index + 1>(nextPrice, output);
+            });
+        }
+    }
+
+public:
+    constexpr Pipeline(Source source, Stages... stages)
+        : m_source(std::move(source)),
+        m_stages(std::move(stages)...) {}
+
+    /* Runs all stages over input in a single loop, returns false if source rejected input.
+     * Output keeps whatever was written before source found out, so caller throws it away
+     * */
+    template<typename Output>
+    bool run(const std::uint8_t* input, std::size_t countBytes, Output& output) const {
+        return m_source(input, countBytes, [this, &output](auto price) {
+            push<0>(price, output);
+        });
+    }
+
+    template<typename Output>
+    bool run(const Common::Buffer& input, Output& output) const {
+        return run(input.data.data(), input.countBytes, output);
+    }
+};
+
+template<typename Source, typename... Stages>
+constexpr Pipeline<Source, Stages...> pipeline(Source source, Stages... stages) {
+    return Pipeline<Source, Stages...>(std::move(source), std::move(stages)...);
+}
+
+template<std::uint8_t EofMarker>
+inline constexpr Deinterleave<EofMarker> deinterleave{};
+
+inline constexpr PriceStream priceStream{};
+
+template<auto ThresholdPrice>
+inline constexpr Threshold<ThresholdPrice> threshold{};
+
+template<std::size_t MessageLength>
+inline constexpr Expand<MessageLength> expand{};
+
+template<typename Predicate>
+constexpr Select<Predicate> selectPrices(Predicate goodPricePredicate) {
+    return Select<Predicate>{std::move(goodPricePredicate)};
+}
+
+} // namespace Processing
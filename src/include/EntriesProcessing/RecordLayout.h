@@ -0,0 +1,477 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "Common.h"
+#include "EntriesProcessing.h"
+
+namespace Processing {
+
+enum class FieldOrder {
+    PriceFirst,
+    VolumeFirst
+};
+
+enum class ByteOrder {
+    Little,
+    Big
+};
+
+// Instrument of layouts without instrument field
+struct NoInstrument {};
+
+/* Entry of a record is a price and a volume, both unsigned integers of 1, 2 or 4 bytes,
+ * optionally preceded by instrument id of 1, 2 or 4 bytes. All fields have the same byte order.
+ * Record ends with EOF marker in place of the price of the next entry, bytes of that entry before its price
+ * (instrument, volume of volume first layouts) and everything after the marker are skipped
+ * */
+template<std::unsigned_integral PriceT, std::unsigned_integral VolumeT, FieldOrder Order = FieldOrder::PriceFirst, ByteOrder Endianness = ByteOrder::Little, typename InstrumentT = NoInstrument>
+struct RecordLayout {
+    static_assert(sizeof(PriceT) == 1 || sizeof(PriceT) == 2 || sizeof(PriceT) == 4, "Price is 1, 2 or 4 bytes");
+    static_assert(sizeof(VolumeT) == 1 || sizeof(VolumeT) == 2 || sizeof(VolumeT) == 4, "Volume is 1, 2 or 4 bytes");
+    static_assert(std::is_same_v<InstrumentT, NoInstrument> || (std::unsigned_integral<InstrumentT> && (sizeof(InstrumentT) == 1 || sizeof(InstrumentT) == 2 || sizeof(InstrumentT) == 4)),
+                  "Instrument is 1, 2 or 4 bytes");
+
+    using Price = PriceT;
+    using Volume = VolumeT;
+    using Instrument = InstrumentT;
+
+    static constexpr bool HAS_INSTRUMENT = !std::is_same_v<Instrument, NoInstrument>;
+    static constexpr std::size_t INSTRUMENT_SIZE = HAS_INSTRUMENT ? sizeof(Instrument) : 0;
+    static constexpr std::size_t PRICE_SIZE = sizeof(Price);
+    static constexpr std::size_t VOLUME_SIZE = sizeof(Volume);
+    static constexpr std::size_t ENTRY_SIZE = INSTRUMENT_SIZE + PRICE_SIZE + VOLUME_SIZE;
+    static constexpr std::size_t INSTRUMENT_OFFSET = 0;
+    static constexpr std::size_t PRICE_OFFSET = INSTRUMENT_SIZE + (Order == FieldOrder::PriceFirst ? 0 : VOLUME_SIZE);
+    static constexpr ByteOrder ENDIANNESS = Endianness;
+    // At least one entry and EOF marker
+    static constexpr std::size_t MIN_RECORD_SIZE = ENTRY_SIZE + PRICE_OFFSET + PRICE_SIZE;
+
+    template<typename Field>
+    static Field fieldAt(const std::uint8_t* bytes) {
+        Field field = 0;
+        std::memcpy(&field, bytes, sizeof(Field));
+        if constexpr(Endianness == ByteOrder::Big && sizeof(Field) == 2) {
+            field = __builtin_bswap16(field);
+        } else if constexpr(Endianness == ByteOrder::Big && sizeof(Field) == 4) {
+            field = __builtin_bswap32(field);
+        }
+        return field;
+    }
+
+    static Price priceOf(const std::uint8_t* entry) { return fieldAt<Price>(entry + PRICE_OFFSET); }
+
+    static Instrument instrumentOf(const std::uint8_t* entry) requires HAS_INSTRUMENT { return fieldAt<Instrument>(entry + INSTRUMENT_OFFSET); }
+};
+
+// price volume ... EOFMarker of single bytes, the layout of filterEntries
+using DefaultLayout = RecordLayout<std::uint8_t, std::uint8_t>;
+
+namespace Detail {
+
+// Whole entries in 16 bytes, prices of a block are looked at together
+template<typename Layout>
+constexpr std::size_t ENTRIES_PER_BLOCK = 16 / Layout::ENTRY_SIZE;
+
+#if defined(__x86_64__) || defined(__i386__)
+/* pshufb indices which move prices of a block next to each other in host byte order,
+ * so a single shuffle de-interleaves (and byte swaps) whatever the widths are
+ * */
+template<typename Layout>
+constexpr std::array<std::uint8_t, 16> makePriceShuffle() {
+    std::array<std::uint8_t, 16> shuffle{};
+    shuffle.fill(0x80);
+    for(std::size_t lane = 0; lane < ENTRIES_PER_BLOCK<Layout> * Layout::PRICE_SIZE; ++lane) {
+        const std::size_t entry = lane / Layout::PRICE_SIZE;
+        const std::size_t byte = lane % Layout::PRICE_SIZE;
+        const std::size_t byteInPrice = Layout::ENDIANNESS == ByteOrder::Little ? byte : Layout::PRICE_SIZE - 1 - byte;
+        shuffle[lane] = static_cast<std::uint8_t>(entry * Layout::ENTRY_SIZE + Layout::PRICE_OFFSET + byteInPrice);
+    }
+    return shuffle;
+}
+
+template<typename Layout>
+inline constexpr std::array<std::uint8_t, 16> PRICE_SHUFFLE = makePriceShuffle<Layout>();
+
+/* Kernels are built with target attributes and picked by instructionSet(), so the default SSE2 build uses them too */
+template<typename Layout>
+__attribute__((target("ssse3"))) __m128i pricesOfBlock(const std::uint8_t* block) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    return _mm_shuffle_epi8(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i*>(PRICE_SHUFFLE<Layout>.data())));
+}
+
+// Two blocks, one in each 128 bit lane, pshufb of AVX2 shuffles every lane by its own half of indices
+template<typename Layout>
+__attribute__((target("avx2"))) __m256i pricesOfBlocks(const std::uint8_t* first, const std::uint8_t* second) {
+    const __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first))),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(second)), 1);
+    return _mm256_shuffle_epi8(bytes, _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(PRICE_SHUFFLE<Layout>.data()))));
+}
+
+template<typename Price>
+__attribute__((target("ssse3"))) __m128i broadcast(Price value) {
+    if constexpr(sizeof(Price) == 1) {
+        return _mm_set1_epi8(static_cast<char>(value));
+    } else if constexpr(sizeof(Price) == 2) {
+        return _mm_set1_epi16(static_cast<short>(value));
+    } else {
+        return _mm_set1_epi32(static_cast<int>(value));
+    }
+}
+
+template<typename Price>
+__attribute__((target("ssse3"))) __m128i equal(__m128i left, __m128i right) {
+    if constexpr(sizeof(Price) == 1) {
+        return _mm_cmpeq_epi8(left, right);
+    } else if constexpr(sizeof(Price) == 2) {
+        return _mm_cmpeq_epi16(left, right);
+    } else {
+        return _mm_cmpeq_epi32(left, right);
+    }
+}
+
+template<typename Price>
+__attribute__((target("avx2"))) __m256i equal(__m256i left, __m256i right) {
+    if constexpr(sizeof(Price) == 1) {
+        return _mm256_cmpeq_epi8(left, right);
+    } else if constexpr(sizeof(Price) == 2) {
+        return _mm256_cmpeq_epi16(left, right);
+    } else {
+        return _mm256_cmpeq_epi32(left, right);
+    }
+}
+
+// No unsigned compare, flipping top bit makes signed compare work for unsigned values
+template<typename Price>
+__attribute__((target("ssse3"))) __m128i greater(__m128i left, __m128i right) {
+    const __m128i topBit = broadcast<Price>(static_cast<Price>(Price{1} << (sizeof(Price) * 8 - 1)));
+    left = _mm_xor_si128(left, topBit);
+    right = _mm_xor_si128(right, topBit);
+    if constexpr(sizeof(Price) == 1) {
+        return _mm_cmpgt_epi8(left, right);
+    } else if constexpr(sizeof(Price) == 2) {
+        return _mm_cmpgt_epi16(left, right);
+    } else {
+        return _mm_cmpgt_epi32(left, right);
+    }
+}
+
+template<typename Price>
+__attribute__((target("avx2"))) __m256i greater(__m256i left, __m256i right) {
+    const __m256i topBit = _mm256_broadcastsi128_si256(broadcast<Price>(static_cast<Price>(Price{1} << (sizeof(Price) * 8 - 1))));
+    left = _mm256_xor_si256(left, topBit);
+    right = _mm256_xor_si256(right, topBit);
+    if constexpr(sizeof(Price) == 1) {
+        return _mm256_cmpgt_epi8(left, right);
+    } else if constexpr(sizeof(Price) == 2) {
+        return _mm256_cmpgt_epi16(left, right);
+    } else {
+        return _mm256_cmpgt_epi32(left, right);
+    }
+}
+
+// Bit i is set if lane i of compare result is set
+template<typename Price>
+__attribute__((target("ssse3"))) std::uint32_t laneMask(__m128i compared) {
+    if constexpr(sizeof(Price) == 2) {
+        compared = _mm_packs_epi16(compared, _mm_setzero_si128());
+    } else if constexpr(sizeof(Price) == 4) {
+        compared = _mm_packs_epi16(_mm_packs_epi32(compared, _mm_setzero_si128()), _mm_setzero_si128());
+    }
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(compared));
+}
+
+// Packs work inside of 128 bit lanes, so bit i is set for lane i of the first half and bit 16 + i for the second half
+template<typename Price>
+__attribute__((target("avx2"))) std::uint32_t laneMask(__m256i compared) {
+    if constexpr(sizeof(Price) == 2) {
+        compared = _mm256_packs_epi16(compared, _mm256_setzero_si256());
+    } else if constexpr(sizeof(Price) == 4) {
+        compared = _mm256_packs_epi16(_mm256_packs_epi32(compared, _mm256_setzero_si256()), _mm256_setzero_si256());
+    }
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(compared));
+}
+
+/* Scans blocks of entries from i on, returns true at EOF marker, otherwise i is left at the first entry not scanned.
+ * Kernels differ only in how many blocks are shuffled at once
+ * */
+template<typename Layout, bool WithThreshold>
+__attribute__((target("ssse3"))) bool scanBlocks(const std::uint8_t* entries, std::size_t countBytes, std::size_t& i, typename Layout::Price* outPrices,
+                                                 std::size_t& countPrices, typename Layout::Price thresholdPrice, typename Layout::Price eofMarker) {
+    using Price = typename Layout::Price;
+    constexpr std::size_t BLOCK_BYTES = ENTRIES_PER_BLOCK<Layout> * Layout::ENTRY_SIZE;
+    constexpr std::uint32_t BLOCK_MASK = (1U << ENTRIES_PER_BLOCK<Layout>) - 1;
+    const __m128i marker = broadcast<Price>(eofMarker);
+    const __m128i threshold = broadcast<Price>(thresholdPrice);
+    for(; i + 16 <= countBytes; i += BLOCK_BYTES) {
+        const __m128i prices = pricesOfBlock<Layout>(entries + i);
+        const std::uint32_t eofMask = laneMask<Price>(equal<Price>(prices, marker)) & BLOCK_MASK;
+        // Only entries before the first EOF marker count
+        const std::uint32_t beforeEof = eofMask == 0 ? BLOCK_MASK : (eofMask & -eofMask) - 1;
+        if constexpr(WithThreshold) {
+            std::array<Price, 16 / sizeof(Price)> lanes;
+            std::memcpy(lanes.data(), &prices, sizeof(lanes));
+            for(std::uint32_t mask = laneMask<Price>(greater<Price>(prices, threshold)) & beforeEof; mask != 0; mask &= mask - 1) {
+                outPrices[countPrices++] = lanes[static_cast<std::size_t>(__builtin_ctz(mask))];
+            }
+        } else {
+            // Whole block is stored, count tells how many prices of it are before EOF marker
+            std::memcpy(outPrices + countPrices, &prices, ENTRIES_PER_BLOCK<Layout> * sizeof(Price));
+            countPrices += static_cast<std::size_t>(__builtin_popcount(beforeEof));
+        }
+        if(eofMask != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename Layout, bool WithThreshold>
+__attribute__((target("avx2"))) bool scanBlockPairs(const std::uint8_t* entries, std::size_t countBytes, std::size_t& i, typename Layout::Price* outPrices,
+                                                    std::size_t& countPrices, typename Layout::Price thresholdPrice, typename Layout::Price eofMarker) {
+    using Price = typename Layout::Price;
+    constexpr std::size_t ENTRIES = ENTRIES_PER_BLOCK<Layout>;
+    constexpr std::size_t BLOCK_BYTES = ENTRIES * Layout::ENTRY_SIZE;
+    constexpr std::size_t PRICES_PER_LANE = 16 / sizeof(Price);
+    constexpr std::uint32_t BLOCK_MASK = (1U << ENTRIES) - 1;
+    constexpr std::uint32_t PAIR_MASK = (1U << (2 * ENTRIES)) - 1;
+    // Bits of the second block follow bits of the first one
+    const auto pairMask = [](std::uint32_t laneBits) {
+        return (laneBits & BLOCK_MASK) | (((laneBits >> 16) & BLOCK_MASK) << ENTRIES);
+    };
+    const __m256i marker = _mm256_broadcastsi128_si256(broadcast<Price>(eofMarker));
+    const __m256i threshold = _mm256_broadcastsi128_si256(broadcast<Price>(thresholdPrice));
+    for(; i + BLOCK_BYTES + 16 <= countBytes; i += 2 * BLOCK_BYTES) {
+        const __m256i prices = pricesOfBlocks<Layout>(entries + i, entries + i + BLOCK_BYTES);
+        const std::uint32_t eofMask = pairMask(laneMask<Price>(equal<Price>(prices, marker)));
+        // Only entries before the first EOF marker count
+        const std::uint32_t beforeEof = eofMask == 0 ? PAIR_MASK : (eofMask & -eofMask) - 1;
+        std::array<Price, 2 * PRICES_PER_LANE> lanes;
+        std::memcpy(lanes.data(), &prices, sizeof(lanes));
+        if constexpr(WithThreshold) {
+            for(std::uint32_t mask = pairMask(laneMask<Price>(greater<Price>(prices, threshold))) & beforeEof; mask != 0; mask &= mask - 1) {
+                const std::size_t entry = static_cast<std::size_t>(__builtin_ctz(mask));
+                outPrices[countPrices++] = lanes[entry < ENTRIES ? entry : PRICES_PER_LANE + entry - ENTRIES];
+            }
+        } else {
+            // Both blocks are stored, count tells how many prices of them are before EOF marker
+            std::memcpy(outPrices + countPrices, lanes.data(), ENTRIES * sizeof(Price));
+            std::memcpy(outPrices + countPrices + ENTRIES, lanes.data() + PRICES_PER_LANE, ENTRIES * sizeof(Price));
+            countPrices += static_cast<std::size_t>(__builtin_popcount(beforeEof));
+        }
+        if(eofMask != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Entries of a batch are looked at together, gather reads field of each of them into 32 bit lane
+constexpr std::size_t GATHER_BATCH_SIZE = 8;
+
+/* pshufb indices which turn 4 bytes read by gather at start of a field into its value in host byte order */
+template<typename Layout, typename Field>
+constexpr std::array<std::uint8_t, 32> makeFieldShuffle() {
+    std::array<std::uint8_t, 32> shuffle{};
+    shuffle.fill(0x80);
+    for(std::size_t lane = 0; lane < 8; ++lane) {
+        for(std::size_t byte = 0; byte < sizeof(Field); ++byte) {
+            const std::size_t byteInField = Layout::ENDIANNESS == ByteOrder::Little ? byte : sizeof(Field) - 1 - byte;
+            shuffle[lane * 4 + byte] = static_cast<std::uint8_t>((lane % 4) * 4 + byteInField);
+        }
+    }
+    return shuffle;
+}
+
+template<typename Layout, typename Field>
+inline constexpr std::array<std::uint8_t, 32> FIELD_SHUFFLE = makeFieldShuffle<Layout, Field>();
+
+// Field at fieldOffset of 8 entries, fields are read as 4 bytes, so 4 bytes after the field of the last entry must be readable
+template<typename Layout, typename Field>
+__attribute__((target("avx2"))) __m256i gatherFields(const std::uint8_t* batch, std::size_t fieldOffset) {
+    const __m256i entryOffsets = _mm256_setr_epi32(0, Layout::ENTRY_SIZE, 2 * Layout::ENTRY_SIZE, 3 * Layout::ENTRY_SIZE,
+                                                   4 * Layout::ENTRY_SIZE, 5 * Layout::ENTRY_SIZE, 6 * Layout::ENTRY_SIZE, 7 * Layout::ENTRY_SIZE);
+    const __m256i fields = _mm256_i32gather_epi32(reinterpret_cast<const int*>(batch + fieldOffset), entryOffsets, 1);
+    return _mm256_shuffle_epi8(fields, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(FIELD_SHUFFLE<Layout, Field>.data())));
+}
+
+/* Batches of entries from i on against thresholds of countInstruments instruments (and the slot of unknown ones after them),
+ * returns true at EOF marker, otherwise i is left at the first entry not looked at
+ * */
+template<typename Layout>
+__attribute__((target("avx2"))) bool gatherEntriesAbove(const std::uint8_t* entries, std::size_t countBytes, std::size_t& i, typename Layout::Price* outPrices,
+                                                        typename Layout::Instrument* outInstruments, std::size_t& countPrices, const std::uint32_t* thresholds,
+                                                        std::size_t countInstruments, typename Layout::Price eofMarker) {
+    using Price = typename Layout::Price;
+    using Instrument = typename Layout::Instrument;
+    constexpr std::size_t BATCH_BYTES = GATHER_BATCH_SIZE * Layout::ENTRY_SIZE;
+    const __m256i marker = _mm256_set1_epi32(static_cast<int>(eofMarker));
+    const __m256i lastInstrument = _mm256_set1_epi32(static_cast<int>(countInstruments));
+    // No unsigned compare, flipping top bit makes signed compare work for unsigned values
+    const __m256i topBit = _mm256_set1_epi32(static_cast<int>(0x80000000U));
+    for(; i + BATCH_BYTES + sizeof(std::uint32_t) <= countBytes; i += BATCH_BYTES) {
+        const __m256i instruments = gatherFields<Layout, Instrument>(entries + i, Layout::INSTRUMENT_OFFSET);
+        const __m256i prices = gatherFields<Layout, Price>(entries + i, Layout::PRICE_OFFSET);
+        const std::uint32_t eofMask = static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(prices, marker))));
+        // Only entries before the first EOF marker count
+        const std::uint32_t beforeEof = eofMask == 0 ? 0xffU : (eofMask & -eofMask) - 1;
+
+        const __m256i slots = _mm256_min_epu32(instruments, lastInstrument);
+        const __m256i thresholdPrices = _mm256_i32gather_epi32(reinterpret_cast<const int*>(thresholds), slots, sizeof(std::uint32_t));
+        const __m256i isGood = _mm256_cmpgt_epi32(_mm256_xor_si256(prices, topBit), _mm256_xor_si256(thresholdPrices, topBit));
+        std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(isGood))) & beforeEof;
+        if(mask != 0) {
+            std::array<std::uint32_t, GATHER_BATCH_SIZE> instrumentLanes;
+            std::array<std::uint32_t, GATHER_BATCH_SIZE> priceLanes;
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(instrumentLanes.data()), instruments);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(priceLanes.data()), prices);
+            for(; mask != 0; mask &= mask - 1) {
+                const std::size_t lane = static_cast<std::size_t>(__builtin_ctz(mask));
+                outInstruments[countPrices] = static_cast<Instrument>(instrumentLanes[lane]);
+                outPrices[countPrices++] = static_cast<Price>(priceLanes[lane]);
+            }
+        }
+        if(eofMask != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+/* Writes prices before EOF marker (only those above thresholdPrice if WithThreshold) to outPrices,
+ * returns false if there is no EOF marker. Blocks are scanned by kernel, entries after the last block one by one
+ * */
+template<typename Layout, bool WithThreshold>
+bool scanEntries(const std::uint8_t* entries, std::size_t countBytes, typename Layout::Price* outPrices, std::size_t& outCountPrices,
+                 typename Layout::Price thresholdPrice, typename Layout::Price eofMarker, InstructionSet kernel) {
+    using Price = typename Layout::Price;
+    std::size_t countPrices = 0;
+    std::size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if((kernel == InstructionSet::Avx2 && scanBlockPairs<Layout, WithThreshold>(entries, countBytes, i, outPrices, countPrices, thresholdPrice, eofMarker))
+       || (kernel != InstructionSet::Scalar && scanBlocks<Layout, WithThreshold>(entries, countBytes, i, outPrices, countPrices, thresholdPrice, eofMarker))) {
+        outCountPrices = countPrices;
+        return true;
+    }
+#else
+    (void)kernel;
+#endif
+    for(; i + Layout::PRICE_OFFSET + Layout::PRICE_SIZE <= countBytes; i += Layout::ENTRY_SIZE) {
+        const Price price = Layout::priceOf(entries + i);
+        if(price == eofMarker) {
+            outCountPrices = countPrices;
+            return true;
+        }
+        if(!WithThreshold || price > thresholdPrice) {
+            outPrices[countPrices++] = price;
+        }
+    }
+    return false;
+}
+
+} // namespace Detail
+
+/* filterEntries for any layout: prices are written in host byte order to outPrices,
+ * which must have room for countBytes / ENTRY_SIZE + 1 prices. On failure outCountPrices is 0.
+ * DefaultLayout is handled by filterEntries itself
+ * */
+template<typename Layout>
+bool filterEntries(const std::uint8_t* entries, std::size_t countBytes, typename Layout::Price* outPrices, std::size_t& outCountPrices, typename Layout::Price eofMarker) {
+    if constexpr(std::is_same_v<Layout, DefaultLayout>) {
+        return filterEntries(entries, countBytes, outPrices, outCountPrices, eofMarker);
+    } else {
+        outCountPrices = 0;
+        return countBytes >= Layout::MIN_RECORD_SIZE && Detail::scanEntries<Layout, false>(entries, countBytes, outPrices, outCountPrices, 0, eofMarker, instructionSet());
+    }
+}
+
+/* Same as above, but only prices above thresholdPrice are written */
+template<typename Layout>
+bool filterEntriesAbove(const std::uint8_t* entries, std::size_t countBytes, typename Layout::Price* outPrices, std::size_t& outCountPrices, typename Layout::Price thresholdPrice, typename Layout::Price eofMarker) {
+    outCountPrices = 0;
+    return countBytes >= Layout::MIN_RECORD_SIZE && Detail::scanEntries<Layout, true>(entries, countBytes, outPrices, outCountPrices, thresholdPrice, eofMarker, instructionSet());
+}
+
+/* Threshold price of every instrument in a flat array indexed by instrument id, so lookup is a single load
+ * (or a gather of 8 of them) without hashing. Ids are expected to be dense, ids outside of table share the last slot,
+ * whose threshold no price passes, so lookup needs no branch
+ * */
+class InstrumentThresholds {
+    std::vector<std::uint32_t> m_thresholds;
+
+public:
+    InstrumentThresholds(std::size_t countInstruments, std::uint32_t thresholdPrice)
+        : m_thresholds(countInstruments + 1, thresholdPrice) {
+        m_thresholds.back() = std::numeric_limits<std::uint32_t>::max();
+    }
+
+    // Throws std::out_of_range for ids outside of table, the last slot must keep threshold of unknown instruments
+    void set(std::size_t instrument, std::uint32_t thresholdPrice) {
+        if(instrument >= countInstruments()) {
+            throw std::out_of_range("Unknown instrument: " + std::to_string(instrument));
+        }
+        m_thresholds[instrument] = thresholdPrice;
+    }
+
+    std::uint32_t thresholdOf(std::uint64_t instrument) const {
+        return m_thresholds[std::min<std::uint64_t>(instrument, countInstruments())];
+    }
+
+    std::size_t countInstruments() const { return m_thresholds.size() - 1; }
+    const std::uint32_t* data() const { return m_thresholds.data(); }
+};
+
+/* Same as filterEntriesAbove, but every price is compared with threshold of its instrument.
+ * Instrument of every written price goes to outInstruments. On CPU with AVX2 8 entries are looked at together:
+ * instruments, prices and their thresholds are gathered
+ * */
+template<typename Layout>
+bool filterEntriesAbove(const std::uint8_t* entries, std::size_t countBytes, typename Layout::Price* outPrices, typename Layout::Instrument* outInstruments,
+                        std::size_t& outCountPrices, const InstrumentThresholds& thresholds, typename Layout::Price eofMarker) {
+    static_assert(Layout::HAS_INSTRUMENT, "Layout has no instrument field");
+    using Price = typename Layout::Price;
+    using Instrument = typename Layout::Instrument;
+    outCountPrices = 0;
+    if(countBytes < Layout::MIN_RECORD_SIZE) {
+        return false;
+    }
+
+    std::size_t countPrices = 0;
+    std::size_t i = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if(instructionSet() == InstructionSet::Avx2
+       && Detail::gatherEntriesAbove<Layout>(entries, countBytes, i, outPrices, outInstruments, countPrices, thresholds.data(), thresholds.countInstruments(), eofMarker)) {
+        outCountPrices = countPrices;
+        return true;
+    }
+#endif
+    for(; i + Layout::PRICE_OFFSET + Layout::PRICE_SIZE <= countBytes; i += Layout::ENTRY_SIZE) {
+        const Price price = Layout::priceOf(entries + i);
+        if(price == eofMarker) {
+            outCountPrices = countPrices;
+            return true;
+        }
+        const Instrument instrument = Layout::instrumentOf(entries + i);
+        if(price > thresholds.thresholdOf(instrument)) {
+            outInstruments[countPrices] = instrument;
+            outPrices[countPrices++] = price;
+        }
+    }
+    return false;
+}
+
+} // namespace Processing
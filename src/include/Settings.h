@@ -7,8 +7,52 @@ static constexpr std::uint8_t THRESHOLD_PRICE = 80;
 static constexpr std::size_t MESSAGE_TO_EXTERNAL_SERVER_SIZE = 5;
 static constexpr std::size_t THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS = 32;
 static constexpr std::size_t RECONNECT_RETRY_INTERVAL_MILLISECONDS = 1000;
+// Messages to external server are written together once they fill payload of a full ethernet segment
+static constexpr std::size_t EGRESS_FLUSH_BYTES = 1448;
+// 0 flushes after every batch, bigger delay lets messages of the next batches join the same write
+static constexpr std::int64_t EGRESS_FLUSH_DELAY_MICROSECONDS = 0;
+// Latency profile of socket to external server: few segments of unsent data, the rest waits in flush window
+static constexpr int TCP_LATENCY_SEND_BUFFER_SIZE = 32768;
+static constexpr int TCP_LATENCY_NOT_SENT_LOW_WATERMARK = 4096;
+// Expired messages wait for writable socket in slices, so buffers which come meanwhile are still noticed
+static constexpr int EGRESS_WRITABLE_POLL_MILLISECONDS = 1;
 static constexpr std::int32_t MAX_UDP_BUF = 65507;
+// Prices of the biggest datagram, one byte of every price volume pair
+static constexpr std::size_t MAX_PRICES_MESSAGE_SIZE = MAX_UDP_BUF / 2;
+static constexpr std::size_t RECORDS_PER_DATAGRAM_HINT = 1024;
+// Size classes of ComponentA buffer pool: most datagrams are small, the biggest class fits any datagram
+static constexpr std::size_t INGEST_SMALL_BUFFER_SIZE = 2048;
+static constexpr std::size_t INGEST_SMALL_COUNT_BUFFERS = 32;
+static constexpr std::size_t INGEST_MEDIUM_BUFFER_SIZE = 4096;
+static constexpr std::size_t INGEST_MEDIUM_COUNT_BUFFERS = 16;
+static constexpr std::size_t INGEST_LARGE_BUFFER_SIZE = 65536;
+static constexpr std::size_t INGEST_LARGE_COUNT_BUFFERS = 8;
 static constexpr char LOCAL_HOST[] = "localhost";
 static constexpr char PIPE_PATH[] = "./fifoAB";
+static constexpr char SOCKET_PATH[] = "./socketAB";
+static constexpr char SHARED_MEMORY_NAME[] = "/IPC_Test_AB";
+static constexpr std::size_t SHARED_MEMORY_CAPACITY = 1 << 20;
+static constexpr std::uint16_t LOOPBACK_TCP_PORT = 47300;
+static constexpr std::size_t SPLICE_PIPE_CAPACITY = 1 << 20;
+// Slot holds prices of the biggest datagram
+static constexpr std::size_t SPLICE_SLOT_SIZE = 32768;
+static constexpr std::size_t SPLICE_COUNT_SLOTS = 64;
+static constexpr std::size_t TRANSPORT_MAX_BATCH = 16;
+// Upper bound of adaptive batches of ComponentA writer, it takes buffers of any size class
+static constexpr std::size_t ADAPTIVE_MAX_BATCH_SIZE = 32;
+// Burst of reader takes only buffers of the biggest size class, so it never holds more of them than there are
+static constexpr std::size_t ADAPTIVE_MAX_READ_BATCH_SIZE = INGEST_LARGE_COUNT_BUFFERS;
+static constexpr std::int32_t MAX_FILTER_WORKERS = 64;
+static constexpr char CREDITS_SHARED_MEMORY_NAME[] = "/IPC_Test_credits";
+// Bytes in flight between A and B, big enough for the biggest message while keeping queueing delay small
+static constexpr std::size_t CREDIT_WINDOW_BYTES = THREAD_SAFE_QUEUE_BUFFER_COUNT_BUFFERS * 4096;
+static constexpr std::size_t CREDIT_BACKLOG_SIZE = 64;
+static constexpr char DEFAULT_INTERFACE[] = "lo";
+static constexpr std::size_t PACKET_MMAP_BLOCK_SIZE = 1 << 20;
+static constexpr std::size_t PACKET_MMAP_COUNT_BLOCKS = 64;
+static constexpr std::uint32_t PACKET_MMAP_BLOCK_TIMEOUT_MILLISECONDS = 1;
+static constexpr std::uint32_t XDP_QUEUE_ID = 0;
+static constexpr std::uint32_t XDP_COUNT_FRAMES = 4096;
+static constexpr std::size_t XDP_FRAME_SIZE = 4096;
 
 }
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Settings.h"
+#include "Common.h"
+
+namespace Transport {
+
+/* Creates transport of A -> B link selected at startup and passes it to run,
+ * so component loops are instantiated for every transport type and the hot path has no virtual dispatch
+ * */
+template<typename Run>
+void withTransport(Common::TransportType transportType, Common::SocketRole role, Run&& run) {
+    using namespace Common;
+    switch(transportType) {
+        case TransportType::Fifo: {
+            NamedPipe namedPipe(Settings::PIPE_PATH);
+            run(namedPipe);
+            break;
+        }
+        case TransportType::FifoSplice: {
+            SplicePipe splicePipe(Settings::PIPE_PATH, Settings::SPLICE_PIPE_CAPACITY, Settings::SPLICE_SLOT_SIZE, Settings::SPLICE_COUNT_SLOTS);
+            run(splicePipe);
+            break;
+        }
+        case TransportType::UnixSocket: {
+            UnixSeqPacketSocket unixSocket(Settings::SOCKET_PATH, role);
+            run(unixSocket);
+            break;
+        }
+        case TransportType::SharedMemory: {
+            SharedMemoryQueue sharedMemoryQueue(Settings::SHARED_MEMORY_NAME, Settings::SHARED_MEMORY_CAPACITY, role);
+            run(sharedMemoryQueue);
+            break;
+        }
+        case TransportType::LoopbackTcp: {
+            LoopbackTcpSocket tcpSocket(Settings::LOOPBACK_TCP_PORT, role);
+            run(tcpSocket);
+            break;
+        }
+    }
+}
+
+}
@@ -1,7 +1,22 @@
 #include <gtest/gtest.h>
 
+#include <array>
+#include <functional>
+#include <limits>
+#include <random>
+
+#include <netinet/udp.h>
+#include <sys/mman.h>
+
 #include "Common.h"
+#include "Backpressure.h"
+#include "Batching.h"
 #include "EntriesProcessing.h"
+#include "FilterWorkers.h"
+#include "FlushWindow.h"
+#include "Pipeline.h"
+#include "RecordLayout.h"
+#include "XdpReader.h"
 
 using namespace Common;
 using namespace Processing;
@@ -112,6 +127,319 @@ TEST(ProcessingTests, FilterEntries_10) {
     ASSERT_EQ(result[4], 1);
 }
 
+TEST(ProcessingTests, FilterEntries_11) {
+    const std::vector<std::uint8_t> entries = {1, 2, 3, 4, '\n', 5};
+    std::vector<std::uint8_t> result;
+    bool isGood = filterEntries(entries.data(), entries.size(), result, '\n');
+    ASSERT_TRUE(isGood);
+    ASSERT_EQ(result.size(), 2);
+    ASSERT_EQ(result[0], 1);
+    ASSERT_EQ(result[1], 3);
+    isGood = filterEntries(entries.data(), 2, result, '\n');
+    ASSERT_FALSE(isGood);
+}
+
+TEST(ProcessingTests, FilterEntries_12) {
+    const std::vector<std::uint8_t> entries = {1, 2, 3, 4, '\n', 5};
+    std::vector<std::uint8_t> result(3, 0);
+    std::size_t countPrices = 0;
+    bool isGood = filterEntries(entries.data(), entries.size(), result.data(), countPrices, '\n');
+    ASSERT_TRUE(isGood);
+    ASSERT_EQ(countPrices, 2);
+    ASSERT_EQ(result[0], 1);
+    ASSERT_EQ(result[1], 3);
+    isGood = filterEntries(entries.data(), 4, result.data(), countPrices, '\n');
+    ASSERT_FALSE(isGood);
+    ASSERT_EQ(countPrices, 0);
+}
+
+TEST(ProcessingTests, FilterEntries_13) {
+    Buffer entries{{1, 2, 3, 4, 5, 6, '\n', 0, 7, 8}};
+    entries.countBytes = entries.data.size();
+    ASSERT_TRUE(filterEntries(entries, '\n'));
+    // Prices are compacted to the front of the same buffer
+    ASSERT_EQ(entries.countBytes, 3);
+    ASSERT_EQ(entries.data[0], 1);
+    ASSERT_EQ(entries.data[1], 3);
+    ASSERT_EQ(entries.data[2], 5);
+
+    Buffer broken{{1, 2, 3, 4}};
+    broken.countBytes = broken.data.size();
+    ASSERT_FALSE(filterEntries(broken, '\n'));
+    ASSERT_EQ(broken.countBytes, 0);
+}
+
+// RecordLayout
+
+namespace {
+
+template<typename Layout, typename Value>
+void appendField(std::vector<std::uint8_t>& entries, Value value, std::size_t size) {
+    for(std::size_t byte = 0; byte < size; ++byte) {
+        const std::size_t shift = 8 * (Layout::ENDIANNESS == ByteOrder::Little ? byte : size - 1 - byte);
+        entries.push_back(static_cast<std::uint8_t>(static_cast<std::uint64_t>(value) >> shift));
+    }
+}
+
+// Records of every length with random prices and volumes, checks both filters against prices the record was built from
+template<typename Layout>
+void checkLayout(std::mt19937& generator) {
+    using Price = typename Layout::Price;
+    constexpr Price eofMarker = '\n';
+    constexpr Price thresholdPrice = static_cast<Price>(std::numeric_limits<Price>::max() / 3);
+    std::uniform_int_distribution<std::uint64_t> distribution(0, std::numeric_limits<std::uint64_t>::max());
+    for(std::size_t countEntries = 0; countEntries < 40; ++countEntries) {
+        for(const bool withEof : {true, false}) {
+            std::vector<std::uint8_t> entries;
+            std::vector<Price> expected;
+            std::vector<Price> expectedAbove;
+            const auto appendEntry = [&entries, &generator, &distribution](Price price) {
+                const std::uint64_t volume = distribution(generator) % 2 == 0 ? eofMarker : distribution(generator);
+                if constexpr(Layout::HAS_INSTRUMENT) {
+                    // Instrument equal to EOF marker is not the end either
+                    appendField<Layout>(entries, distribution(generator) % 2 == 0 ? eofMarker : distribution(generator), Layout::INSTRUMENT_SIZE);
+                }
+                if(Layout::PRICE_OFFSET == Layout::INSTRUMENT_SIZE) {
+                    appendField<Layout>(entries, price, Layout::PRICE_SIZE);
+                    appendField<Layout>(entries, volume, Layout::VOLUME_SIZE);
+                } else {
+                    appendField<Layout>(entries, volume, Layout::VOLUME_SIZE);
+                    appendField<Layout>(entries, price, Layout::PRICE_SIZE);
+                }
+            };
+            for(std::size_t i = 0; i < countEntries; ++i) {
+                Price price = static_cast<Price>(distribution(generator));
+                price = price == eofMarker ? 0 : price;
+                appendEntry(price);
+                expected.push_back(price);
+                if(price > thresholdPrice) {
+                    expectedAbove.push_back(price);
+                }
+            }
+            if(withEof) {
+                appendEntry(eofMarker);
+            }
+            // Garbage after EOF marker is skipped, even if it holds another marker. Without marker record must stay invalid,
+            // so every price in garbage (last entry might be cut after its price) is changed when it happens to be the marker
+            const std::size_t garbageBegin = entries.size();
+            for(std::size_t i = 0; i < countEntries % 21; ++i) {
+                entries.push_back(static_cast<std::uint8_t>(distribution(generator)));
+            }
+            for(std::size_t entry = garbageBegin; !withEof && entry + Layout::PRICE_OFFSET + Layout::PRICE_SIZE <= entries.size(); entry += Layout::ENTRY_SIZE) {
+                if(Layout::priceOf(entries.data() + entry) == eofMarker) {
+                    entries[entry + Layout::PRICE_OFFSET] ^= 1;
+                }
+            }
+
+            const bool isGood = withEof && entries.size() >= Layout::MIN_RECORD_SIZE;
+            std::vector<Price> prices(entries.size() / Layout::ENTRY_SIZE + 1);
+            std::size_t countPrices = 1;
+            ASSERT_EQ(filterEntries<Layout>(entries.data(), entries.size(), prices.data(), countPrices, eofMarker), isGood);
+            ASSERT_EQ(std::vector<Price>(prices.begin(), prices.begin() + countPrices), isGood ? expected : std::vector<Price>{});
+
+            ASSERT_EQ(filterEntriesAbove<Layout>(entries.data(), entries.size(), prices.data(), countPrices, thresholdPrice, eofMarker), isGood);
+            ASSERT_EQ(std::vector<Price>(prices.begin(), prices.begin() + countPrices), isGood ? expectedAbove : std::vector<Price>{});
+
+            // Every kernel CPU supports, not only the one picked for it
+            for(const InstructionSet kernel : {InstructionSet::Scalar, InstructionSet::Ssse3, InstructionSet::Avx2}) {
+                if(kernel > instructionSet() || entries.size() < Layout::MIN_RECORD_SIZE) {
+                    continue;
+                }
+                countPrices = 0;
+                ASSERT_EQ((Detail::scanEntries<Layout, false>(entries.data(), entries.size(), prices.data(), countPrices, 0, eofMarker, kernel)), isGood);
+                ASSERT_EQ(std::vector<Price>(prices.begin(), prices.begin() + countPrices), isGood ? expected : std::vector<Price>{});
+                countPrices = 0;
+                ASSERT_EQ((Detail::scanEntries<Layout, true>(entries.data(), entries.size(), prices.data(), countPrices, thresholdPrice, eofMarker, kernel)), isGood);
+                ASSERT_EQ(std::vector<Price>(prices.begin(), prices.begin() + countPrices), isGood ? expectedAbove : std::vector<Price>{});
+            }
+        }
+    }
+}
+
+// Per instrument thresholds of instruments 0..countInstruments - 1, records hold unknown instruments too
+template<typename Layout>
+void checkInstrumentThresholds(std::mt19937& generator, std::size_t countInstruments) {
+    using Price = typename Layout::Price;
+    using Instrument = typename Layout::Instrument;
+    constexpr Price eofMarker = '\n';
+    std::uniform_int_distribution<std::uint64_t> distribution(0, std::numeric_limits<std::uint64_t>::max());
+    InstrumentThresholds thresholds(countInstruments, std::numeric_limits<Price>::max() / 2);
+    for(std::size_t instrument = 0; instrument < countInstruments; instrument += 2) {
+        thresholds.set(instrument, static_cast<Price>(distribution(generator)));
+    }
+    for(std::size_t countEntries = 0; countEntries < 60; ++countEntries) {
+        std::vector<std::uint8_t> entries;
+        std::vector<Price> expectedPrices;
+        std::vector<Instrument> expectedInstruments;
+        for(std::size_t i = 0; i <= countEntries; ++i) {
+            const Instrument instrument = static_cast<Instrument>(distribution(generator) % (countInstruments + 3));
+            Price price = static_cast<Price>(distribution(generator));
+            price = price == eofMarker ? 0 : price;
+            if(i == countEntries) {
+                price = eofMarker;
+            } else if(instrument < countInstruments && price > thresholds.thresholdOf(instrument)) {
+                expectedPrices.push_back(price);
+                expectedInstruments.push_back(instrument);
+            }
+            appendField<Layout>(entries, instrument, Layout::INSTRUMENT_SIZE);
+            appendField<Layout>(entries, price, Layout::PRICE_SIZE);
+            appendField<Layout>(entries, distribution(generator), Layout::VOLUME_SIZE);
+        }
+
+        std::vector<Price> prices(countEntries + 1);
+        std::vector<Instrument> instruments(countEntries + 1);
+        std::size_t countPrices = 0;
+        ASSERT_EQ(filterEntriesAbove<Layout>(entries.data(), entries.size(), prices.data(), instruments.data(), countPrices, thresholds, eofMarker),
+                  entries.size() >= Layout::MIN_RECORD_SIZE);
+        ASSERT_EQ(std::vector<Price>(prices.begin(), prices.begin() + countPrices), expectedPrices);
+        ASSERT_EQ(std::vector<Instrument>(instruments.begin(), instruments.begin() + countPrices), expectedInstruments);
+    }
+}
+
+}
+
+TEST(ProcessingTests, RecordLayout_1) {
+    // Default layout is filterEntries itself
+    const std::vector<std::uint8_t> entries = {1, 2, 3, '\n', '\n', 0, 7, 8};
+    std::vector<std::uint8_t> prices(entries.size());
+    std::size_t countPrices = 0;
+    ASSERT_TRUE(filterEntries<DefaultLayout>(entries.data(), entries.size(), prices.data(), countPrices, '\n'));
+    ASSERT_EQ(countPrices, 2);
+    ASSERT_EQ(prices[0], 1);
+    ASSERT_EQ(prices[1], 3);
+
+    using BigEndianLayout = RecordLayout<std::uint16_t, std::uint32_t, FieldOrder::VolumeFirst, ByteOrder::Big>;
+    static_assert(BigEndianLayout::ENTRY_SIZE == 6 && BigEndianLayout::PRICE_OFFSET == 4);
+    const std::array<std::uint8_t, 6> entry = {0, 0, 0, 9, 0x12, 0x34};
+    ASSERT_EQ(BigEndianLayout::priceOf(entry.data()), 0x1234);
+}
+
+TEST(ProcessingTests, RecordLayout_2) {
+    std::mt19937 generator(19);
+    checkLayout<DefaultLayout>(generator);
+    checkLayout<RecordLayout<std::uint8_t, std::uint8_t, FieldOrder::VolumeFirst>>(generator);
+    checkLayout<RecordLayout<std::uint16_t, std::uint16_t>>(generator);
+    checkLayout<RecordLayout<std::uint16_t, std::uint16_t, FieldOrder::PriceFirst, ByteOrder::Big>>(generator);
+    checkLayout<RecordLayout<std::uint32_t, std::uint32_t>>(generator);
+    checkLayout<RecordLayout<std::uint32_t, std::uint32_t, FieldOrder::VolumeFirst, ByteOrder::Big>>(generator);
+    checkLayout<RecordLayout<std::uint16_t, std::uint32_t, FieldOrder::VolumeFirst>>(generator);
+    checkLayout<RecordLayout<std::uint32_t, std::uint8_t>>(generator);
+    checkLayout<RecordLayout<std::uint8_t, std::uint16_t, FieldOrder::PriceFirst, ByteOrder::Big>>(generator);
+    checkLayout<RecordLayout<std::uint16_t, std::uint16_t, FieldOrder::VolumeFirst, ByteOrder::Little, std::uint32_t>>(generator);
+    checkLayout<RecordLayout<std::uint8_t, std::uint8_t, FieldOrder::PriceFirst, ByteOrder::Big, std::uint16_t>>(generator);
+}
+
+TEST(ProcessingTests, InstrumentThresholds_1) {
+    InstrumentThresholds thresholds(3, 80);
+    thresholds.set(1, 100);
+    ASSERT_EQ(thresholds.countInstruments(), 3);
+    ASSERT_EQ(thresholds.thresholdOf(0), 80);
+    ASSERT_EQ(thresholds.thresholdOf(1), 100);
+    // Unknown instruments pass nothing
+    ASSERT_EQ(thresholds.thresholdOf(3), std::numeric_limits<std::uint32_t>::max());
+    ASSERT_EQ(thresholds.thresholdOf(1'000'000), std::numeric_limits<std::uint32_t>::max());
+    // Slot of unknown instruments can't be overwritten
+    ASSERT_THROW(thresholds.set(3, 0), std::out_of_range);
+    ASSERT_EQ(thresholds.thresholdOf(3), std::numeric_limits<std::uint32_t>::max());
+}
+
+TEST(ProcessingTests, InstrumentThresholds_2) {
+    std::mt19937 generator(23);
+    checkInstrumentThresholds<RecordLayout<std::uint8_t, std::uint8_t, FieldOrder::PriceFirst, ByteOrder::Little, std::uint8_t>>(generator, 10);
+    checkInstrumentThresholds<RecordLayout<std::uint16_t, std::uint16_t, FieldOrder::PriceFirst, ByteOrder::Little, std::uint32_t>>(generator, 1000);
+    checkInstrumentThresholds<RecordLayout<std::uint32_t, std::uint32_t, FieldOrder::PriceFirst, ByteOrder::Big, std::uint32_t>>(generator, 100'000);
+    checkInstrumentThresholds<RecordLayout<std::uint16_t, std::uint8_t, FieldOrder::PriceFirst, ByteOrder::Big, std::uint16_t>>(generator, 300);
+}
+
+// filterRecords
+
+TEST(ProcessingTests, FilterRecords_1) {
+    // Volume equal to EOF marker doesn't end record, garbage after the last record is skipped
+    Buffer entries{{1, '\n', 3, 4, '\n', 5, 6, '\n', '\n', 9}};
+    entries.countBytes = entries.data.size();
+    std::vector<std::size_t> recordEnds;
+    ASSERT_EQ(filterRecords(entries, recordEnds, '\n'), 3);
+    ASSERT_EQ(entries.countBytes, 3);
+    ASSERT_EQ(entries.data[0], 1);
+    ASSERT_EQ(entries.data[1], 3);
+    ASSERT_EQ(entries.data[2], 5);
+    ASSERT_EQ(recordEnds, (std::vector<std::size_t>{2, 3, 3}));
+}
+
+TEST(ProcessingTests, FilterRecords_2) {
+    // Records cross 32 byte blocks of marker search at every offset and parity
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    std::vector<std::uint8_t> datagram;
+    std::vector<std::uint8_t> expectedPrices;
+    std::vector<std::size_t> expectedRecordEnds;
+    for(std::size_t record = 0; record < 200; ++record) {
+        for(std::size_t i = 0; i < record % 37; ++i) {
+            std::uint8_t price = static_cast<std::uint8_t>(distribution(generator));
+            price = price == '\n' ? 0 : price;
+            datagram.push_back(price);
+            datagram.push_back(static_cast<std::uint8_t>(distribution(generator) % 2 == 0 ? '\n' : 1));
+            expectedPrices.push_back(price);
+        }
+        datagram.push_back('\n');
+        expectedRecordEnds.push_back(expectedPrices.size());
+    }
+    datagram.push_back(5);
+
+    std::vector<std::uint8_t> prices(datagram.size());
+    std::size_t countPrices = 0;
+    std::vector<std::size_t> recordEnds;
+    ASSERT_EQ(filterRecords(datagram.data(), datagram.size(), prices.data(), countPrices, recordEnds, '\n'), 200);
+    prices.resize(countPrices);
+    ASSERT_EQ(prices, expectedPrices);
+    ASSERT_EQ(recordEnds, expectedRecordEnds);
+}
+
+// FilterWorkers
+
+TEST(ProcessingTests, FilterWorkers_1) {
+    // Datagrams of very different sizes finish out of order on workers, but come back in submit order
+    constexpr std::size_t countDatagrams = 1000;
+    constexpr std::size_t capacity = 16;
+    std::vector<Buffer> buffers(capacity, Buffer{std::vector<std::uint8_t>(4096)});
+    FilterWorkers filterWorkers(4, capacity, '\n');
+
+    const auto submit = [&buffers, &filterWorkers](std::size_t index) {
+        Buffer& entries = buffers[index % capacity];
+        const std::size_t countEntries = (index * 131) % 2000;
+        for(std::size_t i = 0; i < countEntries; ++i) {
+            entries.data[i * 2] = static_cast<std::uint8_t>(100 + index % 100);
+            entries.data[i * 2 + 1] = 1;
+        }
+        // Every tenth datagram has no EOF marker and is invalid
+        entries.data[countEntries * 2] = index % 10 == 0 ? 1 : '\n';
+        entries.countBytes = countEntries * 2 + 1;
+        filterWorkers.submit(&entries);
+    };
+
+    std::size_t countSubmitted = 0;
+    for(; countSubmitted < capacity; ++countSubmitted) {
+        submit(countSubmitted);
+    }
+    for(std::size_t countTaken = 0; countTaken < countDatagrams; ++countTaken) {
+        Buffer* entries = nullptr;
+        while((entries = filterWorkers.tryTake()) == nullptr) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQ(entries, &buffers[countTaken % capacity]);
+        ASSERT_EQ(entries->sequenceNumber, countTaken);
+        const std::size_t expectedCountPrices = countTaken % 10 == 0 ? 0 : (countTaken * 131) % 2000;
+        ASSERT_EQ(entries->countBytes, expectedCountPrices);
+        for(std::size_t i = 0; i < entries->countBytes; ++i) {
+            ASSERT_EQ(entries->data[i], static_cast<std::uint8_t>(100 + countTaken % 100));
+        }
+        if(countSubmitted < countDatagrams) {
+            submit(countSubmitted++);
+        }
+    }
+    ASSERT_EQ(filterWorkers.tryTake(), nullptr);
+}
+
 // filterPrices
 
 TEST(ProcessingTests, FilterPrices_1) {
@@ -191,6 +519,205 @@ TEST(ProcessingTests, FilterPrices_5) {
     ASSERT_EQ(result[2][4], 100);
 }
 
+TEST(ProcessingTests, MessageTable_1) {
+    static_assert(MESSAGE_TABLE<5>[88][4] == 88);
+    for(std::size_t price = 0; price < 256; ++price) {
+        const std::span<const std::uint8_t, 5> message = messageOf<5>(static_cast<std::uint8_t>(price));
+        ASSERT_TRUE(std::all_of(message.begin(), message.end(), [price](std::uint8_t byte) { return byte == price; }));
+    }
+}
+
+TEST(ProcessingTests, FilterPricesToMessages_1) {
+    Buffer allPrices;
+    allPrices.data = {80, 90, 30, 91, 100, 255, 0};
+    allPrices.countBytes = allPrices.data.size();
+    const auto isGoodPrice = [](std::uint8_t price) {
+        return price > 80;
+    };
+    std::vector<std::vector<std::uint8_t>> expected;
+    filterPrices(allPrices, expected, 5, isGoodPrice);
+
+    std::vector<std::uint8_t> messages(allPrices.countBytes * 5);
+    ASSERT_EQ(filterPricesToMessages<5>(allPrices, messages.data(), isGoodPrice), expected.size());
+    for(std::size_t index = 0; index < expected.size(); ++index) {
+        ASSERT_TRUE(std::equal(expected[index].begin(), expected[index].end(), messages.begin() + index * 5));
+    }
+}
+
+TEST(ProcessingTests, PriceBitmap_1) {
+    const PriceBitmap goodPrices([](std::uint8_t price) { return price % 3 == 0 || price == 255; });
+    for(std::size_t price = 0; price < 256; ++price) {
+        ASSERT_EQ(goodPrices.contains(static_cast<std::uint8_t>(price)), price % 3 == 0 || price == 255);
+    }
+
+    // Every kernel CPU supports, the default build gets pshufb ones by target attributes too
+    for(const InstructionSet kernel : {InstructionSet::Scalar, InstructionSet::Ssse3, InstructionSet::Avx2}) {
+        if(kernel > instructionSet()) {
+            continue;
+        }
+        std::array<std::uint8_t, 256> consecutive{};
+        std::array<std::uint32_t, 256 / PRICE_BLOCK_SIZE> masks{};
+        for(std::size_t price = 0; price < 256; ++price) {
+            consecutive[price] = static_cast<std::uint8_t>(price);
+        }
+        goodPriceMasks(consecutive.data(), masks.size(), goodPrices, masks.data(), kernel);
+        for(std::size_t block = 0; block < masks.size(); ++block) {
+            std::uint32_t expectedMask = 0;
+            for(std::size_t i = 0; i < PRICE_BLOCK_SIZE; ++i) {
+                expectedMask |= static_cast<std::uint32_t>(goodPrices.contains(consecutive[block * PRICE_BLOCK_SIZE + i])) << i;
+            }
+            ASSERT_EQ(masks[block], expectedMask);
+        }
+
+        // Pshufb kernels pick table by top bit, so blocks mix prices below and from 128 with the same low nibble
+        std::mt19937 generator(5);
+        std::uniform_int_distribution<int> distribution(0, 255);
+        std::array<std::uint8_t, PRICE_BLOCK_SIZE> block{};
+        for(std::size_t count = 0; count < 1000; ++count) {
+            std::uint32_t expectedMask = 0;
+            for(std::size_t i = 0; i < PRICE_BLOCK_SIZE; ++i) {
+                block[i] = static_cast<std::uint8_t>(distribution(generator));
+                expectedMask |= static_cast<std::uint32_t>(goodPrices.contains(block[i])) << i;
+            }
+            std::uint32_t mask = 0;
+            goodPriceMasks(block.data(), 1, goodPrices, &mask, kernel);
+            ASSERT_EQ(mask, expectedMask);
+        }
+    }
+}
+
+TEST(ProcessingTests, FilterPricesToMessages_2) {
+    // Bitmap gives the same messages as predicate it was built from, for blocks and tails of any length
+    const std::vector<std::function<bool(std::uint8_t)>> predicates = {
+        [](std::uint8_t price) { return price > 80; },
+        [](std::uint8_t price) { return price >= 100 && price < 140; },
+        [](std::uint8_t price) { return price == 7 || price == 128 || price == 200 || price == 255; },
+        [](std::uint8_t price) { return (price / 16) % 2 == 1; },
+        [](std::uint8_t) { return false; },
+        [](std::uint8_t) { return true; },
+    };
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for(const auto& isGoodPrice : predicates) {
+        const PriceBitmap goodPrices(isGoodPrice);
+        for(std::size_t countPrices = 0; countPrices < 100; ++countPrices) {
+            Buffer allPrices{std::vector<std::uint8_t>(countPrices)};
+            for(std::uint8_t& price : allPrices.data) {
+                price = static_cast<std::uint8_t>(distribution(generator));
+            }
+            allPrices.countBytes = countPrices;
+
+            std::vector<std::uint8_t> expected(countPrices * 5);
+            std::vector<std::uint8_t> messages(countPrices * 5);
+            const std::size_t countExpected = filterPricesToMessages<5>(allPrices, expected.data(), isGoodPrice);
+            ASSERT_EQ(filterPricesToMessages<5>(allPrices, messages.data(), goodPrices), countExpected);
+            ASSERT_TRUE(std::equal(expected.begin(), expected.begin() + countExpected * 5, messages.begin()));
+        }
+    }
+}
+
+TEST(ProcessingTests, FilterEntriesToMessages_1) {
+    const std::vector<std::uint8_t> entries = {90, 1, 80, '\n', 100, 2, '\n', 7, 200};
+    std::vector<std::uint8_t> messages(entries.size() * 5);
+    std::size_t countMessages = 0;
+    ASSERT_TRUE(filterEntriesToMessages<5>(entries.data(), entries.size(), messages.data(), countMessages, 80, '\n'));
+    ASSERT_EQ(countMessages, 2);
+    ASSERT_TRUE(std::all_of(messages.begin(), messages.begin() + 5, [](std::uint8_t byte) { return byte == 90; }));
+    ASSERT_TRUE(std::all_of(messages.begin() + 5, messages.begin() + 10, [](std::uint8_t byte) { return byte == 100; }));
+
+    ASSERT_FALSE(filterEntriesToMessages<5>(entries.data(), 6, messages.data(), countMessages, 80, '\n'));
+    ASSERT_EQ(countMessages, 0);
+    ASSERT_FALSE(filterEntriesToMessages<5>(entries.data(), 2, messages.data(), countMessages, 80, '\n'));
+    ASSERT_EQ(countMessages, 0);
+}
+
+TEST(ProcessingTests, FilterEntriesToMessages_2) {
+    // Same messages as filterEntries followed by filterPricesToMessages, EOF marker at every position of 32 entry blocks
+    std::mt19937 generator(13);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for(std::size_t countEntries = 0; countEntries < 140; ++countEntries) {
+        for(const bool withEof : {true, false}) {
+            std::vector<std::uint8_t> entries;
+            for(std::size_t i = 0; i < countEntries; ++i) {
+                std::uint8_t price = static_cast<std::uint8_t>(distribution(generator));
+                price = price == '\n' ? 0 : price;
+                entries.push_back(price);
+                // Volume equal to EOF marker is not the end
+                entries.push_back(static_cast<std::uint8_t>(distribution(generator) % 2 == 0 ? '\n' : 1));
+            }
+            if(withEof) {
+                entries.push_back('\n');
+            }
+            // Garbage after EOF marker is skipped
+            for(std::size_t i = 0; i < countEntries % 70; ++i) {
+                entries.push_back(static_cast<std::uint8_t>(distribution(generator)));
+            }
+
+            Buffer prices{std::vector<std::uint8_t>(entries.size())};
+            const bool expectedFoundEof = filterEntries(entries.data(), entries.size(), prices.data.data(), prices.countBytes, '\n');
+            std::vector<std::uint8_t> expected(entries.size() * 5);
+            const std::size_t countExpected = filterPricesToMessages<5>(prices, expected.data(), [](std::uint8_t price) { return price > 80; });
+
+            std::vector<std::uint8_t> messages(entries.size() * 5);
+            std::size_t countMessages = 0;
+            ASSERT_EQ(filterEntriesToMessages<5>(entries.data(), entries.size(), messages.data(), countMessages, 80, '\n'), expectedFoundEof);
+            ASSERT_EQ(countMessages, countExpected);
+            ASSERT_TRUE(std::equal(expected.begin(), expected.begin() + countExpected * 5, messages.begin()));
+        }
+    }
+}
+
+TEST(ProcessingTests, Pipeline_1) {
+    constexpr auto entriesToMessages = pipeline(deinterleave<'\n'>, threshold<80>, expand<5>);
+    std::mt19937 generator(17);
+    std::uniform_int_distribution<int> distribution(0, 255);
+    for(std::size_t countEntries = 0; countEntries < 70; ++countEntries) {
+        std::vector<std::uint8_t> entries;
+        for(std::size_t i = 0; i < countEntries; ++i) {
+            std::uint8_t price = static_cast<std::uint8_t>(distribution(generator));
+            entries.push_back(price == '\n' ? 0 : price);
+            entries.push_back('\n');
+        }
+        entries.push_back('\n');
+
+        std::vector<std::uint8_t> expected(entries.size() * 5);
+        std::size_t countExpected = 0;
+        ASSERT_EQ(filterEntriesToMessages<5>(entries.data(), entries.size(), expected.data(), countExpected, 80, '\n'), entries.size() >= 3);
+
+        std::vector<std::uint8_t> messages(entries.size() * 5);
+        MessageStream output{messages.data()};
+        ASSERT_EQ(entriesToMessages.run(entries.data(), entries.size(), output), entries.size() >= 3);
+        ASSERT_EQ(output.countBytes, countExpected * 5);
+        ASSERT_TRUE(std::equal(expected.begin(), expected.begin() + countExpected * 5, messages.begin()));
+    }
+
+    const std::vector<std::uint8_t> noEof = {90, 1, 100, 2};
+    std::vector<std::uint8_t> messages(noEof.size() * 5);
+    MessageStream output{messages.data()};
+    ASSERT_FALSE(entriesToMessages.run(noEof.data(), noEof.size(), output));
+}
+
+TEST(ProcessingTests, Pipeline_2) {
+    // Stages run in order, a stage might drop price or pass it on several times
+    const PriceBitmap oddPrices([](std::uint8_t price) { return price % 2 == 1; });
+    const auto pricesToMessages = pipeline(priceStream,
+                                           threshold<80>,
+                                           selectPrices([&oddPrices](std::uint8_t price) { return oddPrices.contains(price); }),
+                                           [](std::uint8_t price, auto&& next) {
+                                               next(price);
+                                               next(static_cast<std::uint8_t>(price + 1));
+                                           },
+                                           expand<2>);
+    Buffer prices;
+    prices.data = {80, 81, 90, 91, 255, 3};
+    prices.countBytes = prices.data.size();
+    std::vector<std::uint8_t> messages(prices.countBytes * 4);
+    MessageStream output{messages.data()};
+    ASSERT_TRUE(pricesToMessages.run(prices, output));
+    ASSERT_EQ(output.countBytes, 12);
+    ASSERT_EQ(messages, (std::vector<std::uint8_t>{81, 81, 82, 82, 91, 91, 92, 92, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}));
+}
+
 // ThreadSafeQueueBuffer
 
 TEST(CommonTests, ThreadSafeQueueBuffer_1) {
@@ -268,6 +795,774 @@ TEST(CommonTests, ThreadSafeQueueBuffer_4) {
     ASSERT_EQ(tsBuffer.capacityInProcess(), 3);
 }
 
+TEST(CommonTests, ThreadSafeQueueBuffer_5) {
+    ThreadSafeQueueBuffer tsBuffer(1, 2, OverflowPolicy::DropNewest);
+    for(std::uint8_t i = 0; i < 5; ++i) {
+        Buffer &bufferToFill = tsBuffer.dequeueReadyToUse();
+        bufferToFill.data[0] = i;
+        tsBuffer.enqueueInProcess(&bufferToFill);
+    }
+    // The first two are kept, the rest was read into scratch buffer
+    ASSERT_EQ(tsBuffer.countInProcess(), 2);
+    ASSERT_EQ(tsBuffer.counters().countDroppedNewest, 3);
+    ASSERT_EQ(tsBuffer.dequeueInProcess().data[0], 0);
+    ASSERT_EQ(tsBuffer.dequeueInProcess().data[0], 1);
+}
+
+TEST(CommonTests, ThreadSafeQueueBuffer_6) {
+    ThreadSafeQueueBuffer tsBuffer(1, 2, OverflowPolicy::DropOldest);
+    for(std::uint8_t i = 0; i < 5; ++i) {
+        Buffer &bufferToFill = tsBuffer.dequeueReadyToUse();
+        bufferToFill.data[0] = i;
+        tsBuffer.enqueueInProcess(&bufferToFill);
+    }
+    // Oldest waiting buffers were reclaimed for the newest data
+    ASSERT_EQ(tsBuffer.countInProcess(), 2);
+    ASSERT_EQ(tsBuffer.counters().countDroppedOldest, 3);
+    ASSERT_EQ(tsBuffer.dequeueInProcess().data[0], 3);
+    ASSERT_EQ(tsBuffer.dequeueInProcess().data[0], 4);
+}
+
+TEST(CommonTests, ThreadSafeQueueBuffer_7) {
+    ThreadSafeQueueBuffer tsBuffer(std::vector<SizeClass>{{16, 2}, {64, 1}});
+    ASSERT_EQ(tsBuffer.countToUse(), 3);
+    ASSERT_EQ(tsBuffer.maxBufferSize(), 64);
+
+    // The smallest class which fits, then the bigger one when it runs out
+    Buffer &first = tsBuffer.dequeueReadyToUse(10);
+    Buffer &second = tsBuffer.dequeueReadyToUse(10);
+    Buffer &third = tsBuffer.dequeueReadyToUse(10);
+    ASSERT_EQ(first.data.size(), 16);
+    ASSERT_EQ(second.data.size(), 16);
+    ASSERT_EQ(third.data.size(), 64);
+
+    // Buffer goes back to its own class even if its data was resized
+    tsBuffer.enqueueUsed(&first);
+    third.data.resize(1);
+    tsBuffer.enqueueUsed(&third);
+    ASSERT_EQ(&tsBuffer.dequeueReadyToUse(20), &third);
+    ASSERT_EQ(&tsBuffer.dequeueReadyToUse(), &first);
+}
+
+TEST(CommonTests, ThreadSafeQueueBuffer_8) {
+    ThreadSafeQueueBuffer tsBuffer(std::vector<SizeClass>{{16, 2}, {64, 1}}, OverflowPolicy::DropOldest);
+    Buffer &large = tsBuffer.dequeueReadyToUse(64);
+    tsBuffer.enqueueInProcess(&tsBuffer.dequeueReadyToUse(16));
+    tsBuffer.enqueueInProcess(&tsBuffer.dequeueReadyToUse(16));
+    tsBuffer.enqueueInProcess(&large);
+
+    // Small buffers are reclaimed until the large one is found, they are reused afterwards
+    ASSERT_EQ(&tsBuffer.dequeueReadyToUse(64), &large);
+    ASSERT_EQ(tsBuffer.counters().countDroppedOldest, 3);
+    ASSERT_EQ(tsBuffer.dequeueReadyToUse(16).data.size(), 16);
+    ASSERT_EQ(tsBuffer.dequeueReadyToUse(16).data.size(), 16);
+    ASSERT_EQ(tsBuffer.counters().countDroppedOldest, 3);
+}
+
+TEST(CommonTests, ThreadSafeQueueBuffer_9) {
+    ThreadSafeQueueBuffer tsBuffer(std::vector<SizeClass>{{16, 2}, {64, 2}});
+    std::vector<Buffer*> buffers{&tsBuffer.dequeueReadyToUse(16), &tsBuffer.dequeueReadyToUse(64), &tsBuffer.dequeueReadyToUse(16)};
+    tsBuffer.enqueueInProcess(std::span<Buffer* const>(buffers));
+
+    // Burst takes only what is there, in order
+    std::vector<Buffer*> burst(4);
+    ASSERT_EQ(tsBuffer.dequeueInProcess(burst), 3);
+    ASSERT_EQ(std::vector<Buffer*>(burst.begin(), burst.begin() + 3), buffers);
+    ASSERT_EQ(tsBuffer.countInProcess(), 0);
+
+    // Bulk return routes every buffer to its size class
+    tsBuffer.enqueueUsed(std::span<Buffer* const>(burst).first(3));
+    ASSERT_EQ(tsBuffer.countToUse(), 4);
+    ASSERT_EQ(tsBuffer.dequeueReadyToUse(64).data.size(), 64);
+    ASSERT_EQ(tsBuffer.dequeueReadyToUse(64).data.size(), 64);
+}
+
+// SpscRing
+
+TEST(CommonTests, SpscRing_1) {
+    // Capacity is not power of two: ring is full at 3 values although storage has 4 slots
+    SpscRing<int> ring(3);
+    ASSERT_EQ(ring.max_capacity(), 3);
+    int value = 0;
+    ASSERT_FALSE(ring.try_dequeue(value));
+    for(int lap = 0; lap < 5; ++lap) {
+        ASSERT_TRUE(ring.try_enqueue(lap * 10));
+        ASSERT_TRUE(ring.try_enqueue(lap * 10 + 1));
+        ASSERT_TRUE(ring.try_enqueue(lap * 10 + 2));
+        ASSERT_FALSE(ring.try_enqueue(-1));
+        ASSERT_EQ(ring.size_approx(), 3);
+        ASSERT_TRUE(ring.try_dequeue(value));
+        ASSERT_EQ(value, lap * 10);
+        ASSERT_TRUE(ring.try_dequeue(value));
+        ASSERT_EQ(value, lap * 10 + 1);
+        ASSERT_TRUE(ring.try_dequeue(value));
+        ASSERT_EQ(value, lap * 10 + 2);
+        ASSERT_FALSE(ring.try_dequeue(value));
+    }
+
+    const std::array<int, 3> values{7, 8, 9};
+    ASSERT_TRUE(ring.try_enqueue_bulk(values.data(), 2));
+    ASSERT_FALSE(ring.try_enqueue_bulk(values.data(), 2));
+    ASSERT_TRUE(ring.try_enqueue_bulk(values.data() + 2, 1));
+    std::array<int, 4> taken{};
+    ASSERT_EQ(ring.try_dequeue_bulk(taken.data(), taken.size()), 3);
+    ASSERT_EQ(taken[0], 7);
+    ASSERT_EQ(taken[1], 8);
+    ASSERT_EQ(taken[2], 9);
+    ASSERT_EQ(ring.try_dequeue_bulk(taken.data(), taken.size()), 0);
+}
+
+TEST(CommonTests, SpscRing_2) {
+    // Values arrive in order across threads, whatever mix of single and bulk operations is used
+    constexpr std::uint32_t countValues = 200000;
+    SpscRing<std::uint32_t> ring(8);
+    std::thread producer([&ring]() {
+        for(std::uint32_t value = 0; value < countValues;) {
+            if(value % 3 == 0 && value + 2 <= countValues) {
+                const std::array<std::uint32_t, 2> values{value, value + 1};
+                if(ring.try_enqueue_bulk(values.data(), values.size())) {
+                    value += 2;
+                } else {
+                    std::this_thread::yield();
+                }
+            } else if(ring.try_enqueue(value)) {
+                ++value;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::array<std::uint32_t, 5> taken{};
+    for(std::uint32_t expected = 0; expected < countValues;) {
+        const std::size_t countTaken = ring.try_dequeue_bulk(taken.data(), taken.size());
+        if(countTaken == 0) {
+            std::this_thread::yield();
+        }
+        for(std::size_t i = 0; i < countTaken; ++i) {
+            ASSERT_EQ(taken[i], expected++);
+        }
+    }
+    producer.join();
+    ASSERT_EQ(ring.size_approx(), 0);
+}
+
+// MpmcRing
+
+TEST(CommonTests, MpmcRing_1) {
+    MpmcRing<int> ring(4);
+    ASSERT_EQ(ring.max_capacity(), 4);
+    int value = 0;
+    ASSERT_FALSE(ring.try_dequeue(value));
+    for(int lap = 0; lap < 5; ++lap) {
+        for(int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(ring.try_enqueue(lap * 10 + i));
+        }
+        ASSERT_FALSE(ring.try_enqueue(-1));
+        ASSERT_EQ(ring.size_approx(), 4);
+        for(int i = 0; i < 4; ++i) {
+            ASSERT_TRUE(ring.try_dequeue(value));
+            ASSERT_EQ(value, lap * 10 + i);
+        }
+        ASSERT_FALSE(ring.try_dequeue(value));
+    }
+}
+
+TEST(CommonTests, MpmcRing_2) {
+    // Every value is taken exactly once and values of one producer stay in order for every consumer
+    constexpr std::uint32_t countProducers = 4;
+    constexpr std::uint32_t countConsumers = 4;
+    constexpr std::uint32_t countValuesPerProducer = 20000;
+    MpmcRing<std::uint32_t> ring(16);
+    std::vector<std::atomic_uint32_t> countTaken(countProducers * countValuesPerProducer);
+    std::atomic_uint32_t countTakenTotal = 0;
+    std::atomic_bool isOrdered = true;
+
+    std::vector<std::thread> threads;
+    for(std::uint32_t producer = 0; producer < countProducers; ++producer) {
+        threads.emplace_back([&ring, producer]() {
+            for(std::uint32_t i = 0; i < countValuesPerProducer;) {
+                if(ring.try_enqueue(producer * countValuesPerProducer + i)) {
+                    ++i;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(std::uint32_t consumer = 0; consumer < countConsumers; ++consumer) {
+        threads.emplace_back([&]() {
+            std::vector<std::int64_t> lastOfProducer(countProducers, -1);
+            while(countTakenTotal.load() < countProducers * countValuesPerProducer) {
+                std::uint32_t value = 0;
+                if(!ring.try_dequeue(value)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                countTaken[value].fetch_add(1);
+                countTakenTotal.fetch_add(1);
+                std::int64_t& last = lastOfProducer[value / countValuesPerProducer];
+                if(static_cast<std::int64_t>(value) <= last) {
+                    isOrdered = false;
+                }
+                last = value;
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_TRUE(isOrdered);
+    for(const std::atomic_uint32_t& count : countTaken) {
+        ASSERT_EQ(count.load(), 1);
+    }
+    ASSERT_EQ(ring.size_approx(), 0);
+}
+
+TEST(CommonTests, SharedThreadSafeQueueBuffer_1) {
+    ASSERT_THROW(SharedThreadSafeQueueBuffer(16, 4, OverflowPolicy::DropOldest), std::invalid_argument);
+    ASSERT_THROW(SharedThreadSafeQueueBuffer(16, 4, OverflowPolicy::DropNewest), std::invalid_argument);
+
+    // Two ingest and two processing threads share one pool, no buffer is lost or duplicated
+    SharedThreadSafeQueueBuffer tsBuffer(std::vector<SizeClass>{{16, 4}, {64, 4}});
+    constexpr std::uint32_t countPerProducer = 5000;
+    std::atomic_uint32_t countConsumed = 0;
+    std::vector<std::thread> threads;
+    for(std::uint32_t producer = 0; producer < 2; ++producer) {
+        threads.emplace_back([&tsBuffer, producer]() {
+            for(std::uint32_t i = 0; i < countPerProducer; ++i) {
+                Buffer& buffer = tsBuffer.dequeueReadyToUse(i % 2 == 0 ? 16 : 64);
+                buffer.countBytes = producer;
+                tsBuffer.enqueueInProcess(&buffer);
+            }
+        });
+    }
+    for(std::uint32_t consumer = 0; consumer < 2; ++consumer) {
+        threads.emplace_back([&tsBuffer, &countConsumed]() {
+            while(countConsumed.load() < 2 * countPerProducer) {
+                if(Buffer* buffer = tsBuffer.tryDequeueInProcess()) {
+                    countConsumed.fetch_add(1);
+                    tsBuffer.enqueueUsed(buffer);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(countConsumed.load(), 2 * countPerProducer);
+    ASSERT_EQ(tsBuffer.countInProcess(), 0);
+    ASSERT_EQ(tsBuffer.countToUse(), 8);
+}
+
+// ReorderBuffer
+
+TEST(CommonTests, Backoff_1) {
+    Backoff backoff(2, std::chrono::microseconds(4));
+    backoff.wait();
+    backoff.wait();
+    ASSERT_EQ(backoff.sleepInterval().count(), 0);
+    // After yields sleep doubles up to maximum
+    const std::array<std::int64_t, 4> expected = {1, 2, 4, 4};
+    for(const std::int64_t interval : expected) {
+        backoff.wait();
+        ASSERT_EQ(backoff.sleepInterval().count(), interval);
+    }
+    backoff.reset();
+    backoff.wait();
+    ASSERT_EQ(backoff.sleepInterval().count(), 0);
+}
+
+TEST(CommonTests, ReorderBuffer_1) {
+    ReorderBuffer reorderBuffer(4);
+    std::vector<Buffer> buffers(6);
+    for(std::size_t i = 0; i < buffers.size(); ++i) {
+        buffers[i].sequenceNumber = i;
+    }
+
+    reorderBuffer.publish(&buffers[2]);
+    reorderBuffer.publish(&buffers[1]);
+    ASSERT_EQ(reorderBuffer.tryTake(), nullptr);
+    reorderBuffer.publish(&buffers[0]);
+    reorderBuffer.publish(&buffers[3]);
+    ASSERT_EQ(reorderBuffer.tryTake(), &buffers[0]);
+    ASSERT_EQ(reorderBuffer.tryTake(), &buffers[1]);
+
+    // Slots of taken buffers are reused by sequence numbers past capacity
+    reorderBuffer.publish(&buffers[5]);
+    ASSERT_EQ(reorderBuffer.tryTake(), &buffers[2]);
+    ASSERT_EQ(reorderBuffer.tryTake(), &buffers[3]);
+    ASSERT_EQ(reorderBuffer.tryTake(), nullptr);
+    reorderBuffer.publish(&buffers[4]);
+    ASSERT_EQ(reorderBuffer.tryTake(), &buffers[4]);
+    ASSERT_EQ(reorderBuffer.tryTake(), &buffers[5]);
+    ASSERT_EQ(reorderBuffer.tryTake(), nullptr);
+}
+
+// UnixSeqPacketSocket
+
+TEST(CommonTests, BatchController_1) {
+    BatchController batchController(1, 8);
+    // Empty queue keeps every datagram on its own
+    ASSERT_EQ(batchController.next(0), 1);
+    ASSERT_EQ(batchController.next(1), 1);
+    // Backlog doubles batch up to maximum
+    ASSERT_EQ(batchController.next(5), 2);
+    ASSERT_EQ(batchController.next(5), 4);
+    ASSERT_EQ(batchController.next(5), 8);
+    ASSERT_EQ(batchController.next(100), 8);
+    ASSERT_EQ(batchController.batchSize(), 8);
+    // Drained queue halves it back
+    ASSERT_EQ(batchController.next(3), 4);
+    ASSERT_EQ(batchController.next(0), 2);
+    ASSERT_EQ(batchController.next(0), 1);
+    ASSERT_EQ(batchController.next(0), 1);
+}
+
+TEST(CommonTests, BatchedUdpReader_1) {
+    constexpr std::uint16_t port = 47311;
+    ThreadSafeQueueBuffer threadSafeQueueBuffer(std::vector<SizeClass>{{16, 4}, {64, 4}});
+    BatchedUdpReader batchedUdpReader(port, 4);
+
+    const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_NE(socketDescriptor, -1);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = ::htons(port);
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    const auto send = [socketDescriptor, &address](std::size_t countBytes) {
+        const std::vector<std::uint8_t> datagram(countBytes, 1);
+        ::sendto(socketDescriptor, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    };
+
+    // Single read takes buffer of size class picked by datagram size
+    send(40);
+    ASSERT_EQ(batchedUdpReader.read(threadSafeQueueBuffer, 1), 1);
+    Buffer& single = threadSafeQueueBuffer.dequeueInProcess();
+    ASSERT_EQ(single.countBytes, 40);
+    ASSERT_EQ(single.data.size(), 64);
+    threadSafeQueueBuffer.enqueueUsed(&single);
+
+    // Burst buffers are of the biggest size class, so every datagram of burst fits
+    send(8);
+    send(40);
+    send(8);
+    ASSERT_EQ(batchedUdpReader.read(threadSafeQueueBuffer, 4), 3);
+    ASSERT_EQ(batchedUdpReader.countTruncated(), 0);
+    std::array<Buffer*, 4> burst{};
+    ASSERT_EQ(threadSafeQueueBuffer.dequeueInProcess(burst), 3);
+    ASSERT_EQ(burst[0]->countBytes, 8);
+    ASSERT_EQ(burst[1]->countBytes, 40);
+    ASSERT_EQ(burst[2]->countBytes, 8);
+    for(std::size_t index = 0; index < 3; ++index) {
+        ASSERT_EQ(burst[index]->data.size(), 64);
+    }
+    threadSafeQueueBuffer.enqueueUsed(std::span<Buffer* const>(burst.data(), 3));
+
+    // Datagram bigger than the biggest size class is dropped and counted, empty buffers never go in process
+    send(100);
+    send(8);
+    ASSERT_EQ(batchedUdpReader.read(threadSafeQueueBuffer, 4), 1);
+    ASSERT_EQ(batchedUdpReader.countTruncated(), 1);
+    ASSERT_EQ(threadSafeQueueBuffer.dequeueInProcess(burst), 1);
+    ASSERT_EQ(burst[0]->countBytes, 8);
+    ::close(socketDescriptor);
+}
+
+TEST(CommonTests, BatchedUdpReader_2) {
+    constexpr std::uint16_t port = 47312;
+    // Only 2 buffers of the biggest class for bursts of 4
+    ThreadSafeQueueBuffer threadSafeQueueBuffer(std::vector<SizeClass>{{16, 4}, {64, 2}});
+    BatchedUdpReader batchedUdpReader(port, 4);
+
+    const int socketDescriptor = ::socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_NE(socketDescriptor, -1);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = ::htons(port);
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    const std::vector<std::uint8_t> datagram(8, 1);
+    for(std::size_t index = 0; index < 5; ++index) {
+        ::sendto(socketDescriptor, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    }
+
+    // Burst is cut to free buffers of the biggest class
+    ASSERT_EQ(batchedUdpReader.read(threadSafeQueueBuffer, 4), 2);
+    std::array<Buffer*, 4> burst{};
+    ASSERT_EQ(threadSafeQueueBuffer.dequeueInProcess(burst), 2);
+    ASSERT_EQ(burst[0]->data.size(), 64);
+    ASSERT_EQ(burst[1]->data.size(), 64);
+
+    // While they are in process, datagrams are read one by one into the smaller class instead of waiting for them
+    for(std::size_t index = 0; index < 2; ++index) {
+        ASSERT_EQ(batchedUdpReader.read(threadSafeQueueBuffer, 4), 1);
+        Buffer& single = threadSafeQueueBuffer.dequeueInProcess();
+        ASSERT_EQ(single.countBytes, 8);
+        ASSERT_EQ(single.data.size(), 16);
+        threadSafeQueueBuffer.enqueueUsed(&single);
+    }
+
+    threadSafeQueueBuffer.enqueueUsed(std::span<Buffer* const>(burst.data(), 2));
+    ASSERT_EQ(batchedUdpReader.read(threadSafeQueueBuffer, 4), 1);
+    ASSERT_EQ(threadSafeQueueBuffer.dequeueInProcess().countBytes, 8);
+    ASSERT_EQ(threadSafeQueueBuffer.counters().countBlocked, 0);
+    ::close(socketDescriptor);
+}
+
+TEST(CommonTests, FlushWindow_1) {
+    FlushCounters counters;
+    FlushWindow flushWindow(8, std::chrono::microseconds(100), counters);
+    ASSERT_TRUE(flushWindow.isEmpty());
+    ASSERT_FALSE(flushWindow.isExpired(FlushWindow::Clock::now() + std::chrono::seconds(1)));
+
+    // Deadline is set by the first message and is not moved by the next ones
+    const std::vector<std::uint8_t> message = {88, 88, 88, 88, 88};
+    flushWindow.append(message);
+    const FlushWindow::Clock::time_point deadline = flushWindow.deadline();
+    ASSERT_FALSE(flushWindow.isFull());
+    ASSERT_FALSE(flushWindow.isExpired(deadline - std::chrono::microseconds(1)));
+    ASSERT_TRUE(flushWindow.isExpired(deadline));
+    flushWindow.append(message);
+    ASSERT_EQ(flushWindow.deadline(), deadline);
+    ASSERT_TRUE(flushWindow.isFull());
+    ASSERT_EQ(flushWindow.pending().size(), 10);
+
+    flushWindow.flushed(FlushReason::Size);
+    ASSERT_TRUE(flushWindow.isEmpty());
+    flushWindow.append(message);
+    flushWindow.flushed(FlushReason::Deadline);
+    ASSERT_EQ(counters.countFlushedBySize, 1);
+    ASSERT_EQ(counters.countFlushedByDeadline, 1);
+}
+
+TEST(CommonTests, TcpTuning_1) {
+    ASSERT_EQ(tcpProfileFromString("kernel"), TcpProfile::Kernel);
+    ASSERT_EQ(tcpProfileFromString("nodelay"), TcpProfile::NoDelay);
+    ASSERT_EQ(tcpProfileFromString("latency"), TcpProfile::Latency);
+    ASSERT_EQ(tcpProfileFromString("throughput"), TcpProfile::Throughput);
+    ASSERT_THROW(tcpProfileFromString("fast"), std::invalid_argument);
+}
+
+TEST(CommonTests, TcpTuning_2) {
+    constexpr std::uint16_t port = 47321;
+    // Connection is established by kernel from backlog, accept is not needed
+    const int listenDescriptor = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(listenDescriptor, -1);
+    const int reuse = 1;
+    ::setsockopt(listenDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = ::htons(port);
+    address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(::bind(listenDescriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    ASSERT_EQ(::listen(listenDescriptor, 8), 0);
+
+    const auto optionOf = [](const NetworkReaderWriter<ProtocolType::TCP>& readerWriter, int level, int name) {
+        int value = 0;
+        socklen_t length = sizeof(value);
+        ::getsockopt(readerWriter.fileDescriptor(), level, name, &value, &length);
+        return value;
+    };
+
+    NetworkReaderWriter<ProtocolType::TCP> kernel(port, "127.0.0.1");
+    ASSERT_EQ(kernel.setTcpTuning(TcpTuning{TcpProfile::Kernel}), 0);
+    ASSERT_EQ(optionOf(kernel, IPPROTO_TCP, TCP_NODELAY), 0);
+    ASSERT_EQ(optionOf(kernel, IPPROTO_TCP, TCP_CORK), 0);
+
+    NetworkReaderWriter<ProtocolType::TCP> noDelay(port, "127.0.0.1");
+    ASSERT_EQ(noDelay.setTcpTuning(TcpTuning{TcpProfile::NoDelay}), 0);
+    ASSERT_NE(optionOf(noDelay, IPPROTO_TCP, TCP_NODELAY), 0);
+
+    NetworkReaderWriter<ProtocolType::TCP> latency(port, "127.0.0.1");
+    ASSERT_EQ(latency.setTcpTuning(TcpTuning{TcpProfile::Latency, 32768, 4096}), 0);
+    ASSERT_NE(optionOf(latency, IPPROTO_TCP, TCP_NODELAY), 0);
+    // Kernel doubles send buffer for its bookkeeping
+    ASSERT_GE(optionOf(latency, SOL_SOCKET, SO_SNDBUF), 32768);
+    ASSERT_EQ(optionOf(latency, IPPROTO_TCP, TCP_NOTSENT_LOWAT), 4096);
+
+    NetworkReaderWriter<ProtocolType::TCP> throughput(port, "127.0.0.1");
+    ASSERT_EQ(throughput.setTcpTuning(TcpTuning{TcpProfile::Throughput}), 0);
+    ASSERT_NE(optionOf(throughput, IPPROTO_TCP, TCP_CORK), 0);
+    // Push sends held back segments and corks socket again
+    ASSERT_EQ(throughput.push(), 0);
+    ASSERT_NE(optionOf(throughput, IPPROTO_TCP, TCP_CORK), 0);
+
+    // Options survive reconnect
+    ASSERT_EQ(latency.reConnect(port, "127.0.0.1"), 0);
+    ASSERT_EQ(optionOf(latency, IPPROTO_TCP, TCP_NOTSENT_LOWAT), 4096);
+    ::close(listenDescriptor);
+}
+
+TEST(CommonTests, UnixSeqPacketSocket_1) {
+    UnixSeqPacketSocket reader("./testSocket", SocketRole::Listen);
+    std::thread writerThread([](){
+        UnixSeqPacketSocket writer("./testSocket", SocketRole::Connect);
+        const std::vector<std::vector<std::uint8_t>> messages = {{1, 2, 3}, {4}, {5, 6}};
+        writer.write(messages);
+        writer.write(std::vector<std::uint8_t>{7, 8});
+    });
+
+    std::vector<Buffer> buffers(4, Buffer{std::vector<std::uint8_t>(16)});
+    std::vector<Buffer*> bufferPtrs = {&buffers[0], &buffers[1], &buffers[2], &buffers[3]};
+    std::size_t countMessages = 0;
+    while(countMessages < 4) {
+        countMessages += reader.read(std::span<Buffer*>(bufferPtrs.data() + countMessages, bufferPtrs.size() - countMessages));
+    }
+    writerThread.join();
+
+    // Message boundaries are preserved
+    ASSERT_EQ(buffers[0].countBytes, 3);
+    ASSERT_EQ(buffers[0].data[2], 3);
+    ASSERT_EQ(buffers[1].countBytes, 1);
+    ASSERT_EQ(buffers[1].data[0], 4);
+    ASSERT_EQ(buffers[2].countBytes, 2);
+    ASSERT_EQ(buffers[2].data[1], 6);
+    ASSERT_EQ(buffers[3].countBytes, 2);
+    ASSERT_EQ(buffers[3].data[0], 7);
+}
+
+TEST(CommonTests, UnixSeqPacketSocket_2) {
+    UnixSeqPacketSocket reader("./testSocket", SocketRole::Listen);
+    int pipeDescriptors[2];
+    ASSERT_EQ(::pipe(pipeDescriptors), 0);
+    std::thread writerThread([&pipeDescriptors](){
+        UnixSeqPacketSocket writer("./testSocket", SocketRole::Connect);
+        writer.sendDescriptor(pipeDescriptors[1]);
+    });
+
+    const int receivedDescriptor = reader.receiveDescriptor();
+    writerThread.join();
+    ASSERT_NE(receivedDescriptor, pipeDescriptors[1]);
+    const std::uint8_t byte = 42;
+    ASSERT_EQ(::write(receivedDescriptor, &byte, 1), 1);
+    std::uint8_t result = 0;
+    ASSERT_EQ(::read(pipeDescriptors[0], &result, 1), 1);
+    ASSERT_EQ(result, 42);
+    ::close(receivedDescriptor);
+    ::close(pipeDescriptors[0]);
+    ::close(pipeDescriptors[1]);
+}
+
+// SplicePipe
+
+TEST(CommonTests, SplicePipe_1) {
+    constexpr std::size_t countMessages = 100;
+    std::thread writerThread([](){
+        SplicePipe writer("./testFifo", 1 << 16, 4096, 2);
+        for(std::size_t i = 0; i < countMessages; ++i) {
+            // Only 2 slots, so slots are reused as soon as reader consumed them
+            std::span<std::uint8_t> slot = writer.acquire();
+            std::fill(slot.begin(), slot.begin() + 10, static_cast<std::uint8_t>(i));
+            writer.gift(10);
+        }
+    });
+
+    SplicePipe reader("./testFifo", 1 << 16, 4096, 1);
+    Buffer buffer{std::vector<std::uint8_t>(4096)};
+    std::vector<std::uint8_t> result;
+    while(result.size() < countMessages * 10) {
+        reader.read(buffer);
+        result.insert(result.end(), buffer.data.begin(), buffer.data.begin() + buffer.countBytes);
+    }
+    writerThread.join();
+
+    for(std::size_t i = 0; i < result.size(); ++i) {
+        ASSERT_EQ(result[i], i / 10);
+    }
+}
+
+// SharedMemoryQueue
+
+TEST(CommonTests, SharedMemoryQueue_1) {
+    // Small ring, so records wrap around many times
+    SharedMemoryQueue reader("/IPC_Test_tests", 256, SocketRole::Listen);
+    SharedMemoryQueue writer("/IPC_Test_tests", 256, SocketRole::Connect);
+    std::thread writerThread([&writer](){
+        for(std::uint8_t i = 1; i <= 200; ++i) {
+            const std::vector<std::vector<std::uint8_t>> messages = {std::vector<std::uint8_t>(i % 50 + 1, i), {i}};
+            writer.write(messages);
+        }
+    });
+
+    std::vector<Buffer> buffers(3, Buffer{std::vector<std::uint8_t>(64)});
+    std::vector<Buffer*> bufferPtrs = {&buffers[0], &buffers[1], &buffers[2]};
+    std::vector<std::vector<std::uint8_t>> result;
+    while(result.size() < 400) {
+        const std::size_t countRead = reader.read(std::span<Buffer*>(bufferPtrs));
+        ASSERT_GE(countRead, 1);
+        for(std::size_t i = 0; i < countRead; ++i) {
+            result.emplace_back(buffers[i].data.begin(), buffers[i].data.begin() + buffers[i].countBytes);
+        }
+    }
+    writerThread.join();
+
+    // Message boundaries are preserved
+    for(std::uint8_t i = 1; i <= 200; ++i) {
+        ASSERT_EQ(result[(i - 1) * 2], std::vector<std::uint8_t>(i % 50 + 1, i));
+        ASSERT_EQ(result[(i - 1) * 2 + 1], std::vector<std::uint8_t>(1, i));
+    }
+}
+
+// CreditedWriter
+
+namespace {
+
+struct RecordingWriter {
+    std::vector<std::vector<std::uint8_t>> messages;
+
+    void write(const std::vector<std::uint8_t>& bufferToWrite) {
+        messages.push_back(bufferToWrite);
+    }
+
+    void write(std::span<const std::vector<std::uint8_t>> buffersToWrite) {
+        messages.insert(messages.end(), buffersToWrite.begin(), buffersToWrite.end());
+    }
+
+    void write(std::span<Buffer* const> buffersToWrite) {
+        for(const Buffer* bufferToWrite : buffersToWrite) {
+            messages.emplace_back(bufferToWrite->data.begin(), bufferToWrite->data.begin() + bufferToWrite->countBytes);
+        }
+    }
+};
+
+}
+
+namespace {
+
+// Ethernet, ipv4 without options and udp headers in front of payload
+constexpr std::size_t XDP_HEADERS_SIZE = 14 + 20 + sizeof(udphdr);
+
+xdp_desc writeDatagram(std::vector<std::uint8_t>& umem, std::uint64_t address, const std::vector<std::uint8_t>& payload) {
+    udphdr udpHeader{};
+    udpHeader.len = ::htons(static_cast<std::uint16_t>(sizeof(udphdr) + payload.size()));
+    std::memcpy(umem.data() + address + XDP_HEADERS_SIZE - sizeof(udphdr), &udpHeader, sizeof(udpHeader));
+    std::memcpy(umem.data() + address + XDP_HEADERS_SIZE, payload.data(), payload.size());
+    return xdp_desc{address, static_cast<std::uint32_t>(XDP_HEADERS_SIZE + payload.size()), 0};
+}
+
+}
+
+TEST(CommonTests, XdpRing_1) {
+    std::vector<std::uint8_t> umem(64, 0);
+    std::size_t payloadSize = 0;
+    const xdp_desc descriptor = writeDatagram(umem, 0, {1, 2, 3});
+    ASSERT_EQ(udpPayloadOf(umem.data(), descriptor.len, payloadSize), umem.data() + XDP_HEADERS_SIZE);
+    ASSERT_EQ(payloadSize, 3);
+    // Frame shorter than headers or than udp length says
+    ASSERT_EQ(udpPayloadOf(umem.data(), XDP_HEADERS_SIZE - 1, payloadSize), nullptr);
+    ASSERT_EQ(udpPayloadOf(umem.data(), descriptor.len - 1, payloadSize), nullptr);
+    // Udp length shorter than its own header
+    umem[XDP_HEADERS_SIZE - sizeof(udphdr) + offsetof(udphdr, len) + 1] = 4;
+    ASSERT_EQ(udpPayloadOf(umem.data(), descriptor.len, payloadSize), nullptr);
+}
+
+TEST(CommonTests, XdpRing_2) {
+    constexpr std::size_t frameSize = 128;
+    std::vector<std::uint8_t> umem(4 * frameSize, 0);
+    std::array<xdp_desc, 4> rxDescriptors{};
+    std::array<std::uint64_t, 4> fillDescriptors{};
+    // Indexes run freely, so ring of 4 wraps in the middle of the batch
+    std::uint32_t rxProducer = 9;
+    std::uint32_t rxConsumer = 6;
+    std::uint32_t fillProducer = 5;
+    std::uint32_t fillConsumer = 5;
+    XdpRing rxRing{&rxProducer, &rxConsumer, rxDescriptors.data(), nullptr, 0, 3};
+    XdpRing fillRing{&fillProducer, &fillConsumer, fillDescriptors.data(), nullptr, 0, 3};
+
+    // Addresses inside of frames leave headroom like kernel does, frame 2 is too short for headers
+    rxDescriptors[2] = writeDatagram(umem, frameSize + 16, {1, 2, 3});
+    rxDescriptors[3] = xdp_desc{2 * frameSize, 10, 0};
+    rxDescriptors[0] = writeDatagram(umem, 3 * frameSize + 16, {4, 5});
+
+    std::vector<std::vector<std::uint8_t>> payloads;
+    const std::size_t countDelivered = consumeRxRing(rxRing, fillRing, rxProducer, umem.data(), frameSize, [&payloads](const std::uint8_t* data, std::size_t size) {
+        payloads.emplace_back(data, data + size);
+    });
+    ASSERT_EQ(countDelivered, 2);
+    const std::vector<std::vector<std::uint8_t>> expected = {{1, 2, 3}, {4, 5}};
+    ASSERT_EQ(payloads, expected);
+
+    // Every frame goes back to fill ring at its start, invalid one too
+    ASSERT_EQ(rxConsumer, 9);
+    ASSERT_EQ(fillProducer, 8);
+    ASSERT_EQ(fillDescriptors[1], frameSize);
+    ASSERT_EQ(fillDescriptors[2], 2 * frameSize);
+    ASSERT_EQ(fillDescriptors[3], 3 * frameSize);
+
+    // Nothing new in rx ring leaves both rings as they are
+    ASSERT_EQ(consumeRxRing(rxRing, fillRing, rxProducer, umem.data(), frameSize, [](const std::uint8_t*, std::size_t) {}), 0);
+    ASSERT_EQ(rxConsumer, 9);
+    ASSERT_EQ(fillProducer, 8);
+}
+
+TEST(CommonTests, CreditWindow_1) {
+    // ComponentA without credit policy sent 10 bytes, ComponentB granted them anyway
+    CreditWindow granter("/IPC_Test_tests_credits", 3, SocketRole::Listen);
+    granter.grant(10);
+    CreditWindow consumer("/IPC_Test_tests_credits", 3, SocketRole::Connect);
+    ASSERT_TRUE(consumer.tryConsume(3));
+    ASSERT_FALSE(consumer.tryConsume(1));
+
+    // Grants of bytes sent without credits while consumer runs don't open window beyond its size either
+    granter.grant(3 + 10);
+    ASSERT_TRUE(consumer.tryConsume(2));
+    ASSERT_TRUE(consumer.tryConsume(1));
+    ASSERT_FALSE(consumer.tryConsume(1));
+    granter.grant(1);
+    ASSERT_TRUE(consumer.tryConsume(1));
+    ASSERT_FALSE(consumer.tryConsume(1));
+    ::shm_unlink("/IPC_Test_tests_credits");
+}
+
+TEST(CommonTests, CreditedWriter_1) {
+    // Window of 3 bytes, ComponentB side grants them back
+    CreditWindow granter("/IPC_Test_tests_credits", 3, SocketRole::Listen);
+    CreditWindow consumer("/IPC_Test_tests_credits", 3, SocketRole::Connect);
+    RecordingWriter recordingWriter;
+    CreditCounters counters;
+    CreditedWriter creditedWriter(recordingWriter, consumer, CreditPolicy::DropOldest, 2, 1, counters);
+
+    const std::vector<std::vector<std::uint8_t>> messages = {{1}, {2}, {3}, {4}, {5}, {6}};
+    creditedWriter.write(messages);
+    // 1, 2, 3 are sent, 4 is dropped from backlog of 2 by 6
+    ASSERT_EQ(recordingWriter.messages.size(), 3);
+    ASSERT_EQ(counters.countDroppedOldest, 1);
+    ASSERT_TRUE(creditedWriter.flush());
+
+    granter.grant(3);
+    ASSERT_FALSE(creditedWriter.flush());
+    const std::vector<std::vector<std::uint8_t>> expected = {{1}, {2}, {3}, {5}, {6}};
+    ASSERT_EQ(recordingWriter.messages, expected);
+    ASSERT_EQ(counters.countSent, 5);
+    ::shm_unlink("/IPC_Test_tests_credits");
+}
+
+TEST(CommonTests, CreditedWriter_2) {
+    CreditWindow granter("/IPC_Test_tests_credits", 2, SocketRole::Listen);
+    CreditWindow consumer("/IPC_Test_tests_credits", 2, SocketRole::Connect);
+    RecordingWriter recordingWriter;
+    CreditCounters counters;
+    CreditedWriter dropNewestWriter(recordingWriter, consumer, CreditPolicy::DropNewest, 2, 1, counters);
+    CreditedWriter conflatingWriter(recordingWriter, consumer, CreditPolicy::Conflate, 2, 1, counters);
+
+    dropNewestWriter.write(std::vector<std::vector<std::uint8_t>>{{1}, {2}, {3}});
+    ASSERT_EQ(counters.countDroppedNewest, 1);
+    ASSERT_FALSE(dropNewestWriter.flush());
+
+    // Only the latest message waits for credits
+    conflatingWriter.write(std::vector<std::vector<std::uint8_t>>{{4}, {5}, {6}});
+    ASSERT_EQ(counters.countConflated, 2);
+    granter.grant(2);
+    ASSERT_FALSE(conflatingWriter.flush());
+    const std::vector<std::vector<std::uint8_t>> expected = {{1}, {2}, {6}};
+    ASSERT_EQ(recordingWriter.messages, expected);
+    ::shm_unlink("/IPC_Test_tests_credits");
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();